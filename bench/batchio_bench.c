@@ -0,0 +1,123 @@
+/**
+ * @file batchio_bench.c
+ * @brief Measures loopback packets per second per core with one syscall per datagram
+ * (sendto/recvfrom) and with batched I/O (sendmmsg/recvmmsg, see batchio.h).
+ * @author Connor Johst - cjohst & Aaditya Suri - AadityaSuri
+ * @bug No known bugs
+ *
+ * Both ends run on one thread, so the process CPU time covers the send and the receive side of
+ * every packet. Usage: bench_batchio [packets]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "packet.h"
+#include "batchio.h"
+
+#define DEFAULT_PACKETS 2000000
+#define SOCKET_BUFFER (4 * 1024 * 1024)
+
+static double cpu_seconds(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int open_socket(struct sockaddr_in* addr){
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    int size = SOCKET_BUFFER;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(*addr);
+    if (bind(fd, (struct sockaddr*) addr, len) < 0 || getsockname(fd, (struct sockaddr*) addr, &len) < 0){
+        perror("bind");
+        exit(EXIT_FAILURE);
+    }
+    return fd;
+}
+
+// sends and receives packets BATCH_MAX at a time, one syscall per datagram
+static unsigned long bench_single(int tx_fd, int rx_fd, const struct sockaddr_in* rx_addr, unsigned long packets){
+    packet_t* packet = (packet_t*) calloc(1, PACKET_SIZE(DEFAULT_PAYLOAD_SZ));
+    if (packet == NULL){
+        fprintf(stderr, "Cannot allocate packet\n");
+        exit(EXIT_FAILURE);
+    }
+    packet->header = create_header(1, 0, 0, DEFAULT_PAYLOAD_SZ, 0);
+    unsigned long received = 0;
+
+    for (unsigned long sent = 0; sent < packets; sent += BATCH_MAX){
+        for (int i = 0; i < BATCH_MAX; i++){
+            packet->header.seq_num = sent + i;
+            sendto(tx_fd, packet, PACKET_SIZE(DEFAULT_PAYLOAD_SZ), 0, (const struct sockaddr*) rx_addr, sizeof(*rx_addr));
+        }
+        for (int i = 0; i < BATCH_MAX; i++){
+            if (recvfrom(rx_fd, packet, PACKET_SIZE(DEFAULT_PAYLOAD_SZ), MSG_DONTWAIT, NULL, NULL) <= 0){
+                break;
+            }
+            received++;
+        }
+    }
+    free(packet);
+    return received;
+}
+
+// sends and receives packets BATCH_MAX at a time with one sendmmsg() and one recvmmsg()
+static unsigned long bench_batched(int tx_fd, int rx_fd, const struct sockaddr_in* rx_addr, unsigned long packets){
+    batch_io_t tx, rx;
+    if (batch_init(&tx, PACKET_SIZE(DEFAULT_PAYLOAD_SZ)) < 0 || batch_init(&rx, PACKET_SIZE(DEFAULT_PAYLOAD_SZ)) < 0){
+        fprintf(stderr, "Cannot allocate packet batches\n");
+        exit(EXIT_FAILURE);
+    }
+    unsigned long received = 0;
+
+    for (unsigned long sent = 0; sent < packets; sent += BATCH_MAX){
+        for (int i = 0; i < BATCH_MAX; i++){
+            packet_t* packet = (packet_t*) batch_buffer(&tx);
+            packet->header = create_header(1, sent + i, 0, DEFAULT_PAYLOAD_SZ, 0);
+            batch_commit(&tx, PACKET_SIZE(DEFAULT_PAYLOAD_SZ), rx_addr);
+        }
+        batch_flush(&tx, tx_fd);
+        int n = batch_recv(&rx, rx_fd);
+        received += n > 0 ? n : 0;
+    }
+
+    batch_free(&tx);
+    batch_free(&rx);
+    return received;
+}
+
+static void report(const char* name, unsigned long received, double seconds){
+    printf("%-28s %10lu packets %8.3f cpu-s %12.0f packets/s/core\n", name, received, seconds, received / seconds);
+}
+
+int main(int argc, char** argv){
+    unsigned long packets = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_PACKETS;
+    struct sockaddr_in tx_addr, rx_addr;
+    int tx_fd = open_socket(&tx_addr);
+    int rx_fd = open_socket(&rx_addr);
+
+    double start = cpu_seconds();
+    unsigned long received = bench_single(tx_fd, rx_fd, &rx_addr, packets);
+    report("sendto/recvfrom", received, cpu_seconds() - start);
+
+    start = cpu_seconds();
+    received = bench_batched(tx_fd, rx_fd, &rx_addr, packets);
+    report("sendmmsg/recvmmsg (batched)", received, cpu_seconds() - start);
+
+    close(tx_fd);
+    close(rx_fd);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,142 @@
+/**
+ * @file compress_bench.c
+ * @brief Measures the compression stage of the sender (see compress.h): how much each file
+ * shrinks and how fast its blocks are packed and unpacked, so its cost can be weighed against the
+ * bandwidth it saves.
+ * @author Connor Johst - cjohst & Aaditya Suri - AadityaSuri
+ * @bug No known bugs
+ *
+ * Every file is read whole and packed block by block as a connection would, then unpacked and
+ * checked. Usage: bench_compress [megabytes] [files...]; by default the test files in test_res/.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "compress.h"
+
+#define DEFAULT_MEGABYTES 256
+
+static double wall_seconds(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// reads a whole file into memory
+static unsigned char* read_file(const char* path, size_t* len){
+    FILE* file = fopen(path, "rb");
+    if (file == NULL){
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    *len = ftell(file);
+    rewind(file);
+    unsigned char* data = malloc(*len + 1);
+    if (data != NULL && fread(data, 1, *len, file) != *len){
+        free(data);
+        data = NULL;
+    }
+    fclose(file);
+    return data;
+}
+
+// packs and unpacks a file until bytes have gone through and reports the ratio and the rates
+static int bench(const char* path, uint64_t bytes){
+    size_t len;
+    unsigned char* data = read_file(path, &len);
+    if (data == NULL || len == 0){
+        fprintf(stderr, "Cannot read %s\n", path);
+        free(data);
+        return -1;
+    }
+
+    compressor_t compressor;
+    decompressor_t decompressor;
+    size_t stream_capacity = len + (len / COMPRESS_BLOCK_SZ + 2) * sizeof(compress_header_t);
+    unsigned char* stream = malloc(stream_capacity);
+    unsigned char* back = malloc(len);
+    if (stream == NULL || back == NULL || compressor_init(&compressor) < 0
+        || decompressor_init(&decompressor, COMPRESS_BLOCK_SZ) < 0){
+        fprintf(stderr, "Cannot allocate buffers\n");
+        return -1;
+    }
+
+    uint64_t rounds = bytes / len > 0 ? bytes / len : 1;
+    size_t stream_len = 0;
+    double start = wall_seconds();
+    for (uint64_t r = 0; r < rounds; r++){
+        stream_len = 0;
+        for (size_t pos = 0; pos <= len; pos += COMPRESS_BLOCK_SZ){
+            uint32_t raw_len = len - pos < COMPRESS_BLOCK_SZ ? len - pos : COMPRESS_BLOCK_SZ;
+            stream_len += compressor_pack(&compressor, data + pos, raw_len, stream + stream_len);
+            if (raw_len == 0){
+                break;
+            }
+        }
+        if (len % COMPRESS_BLOCK_SZ != 0){
+            stream_len += compressor_pack(&compressor, NULL, 0, stream + stream_len);
+        }
+    }
+    double pack_seconds = wall_seconds() - start;
+
+    start = wall_seconds();
+    size_t back_len = 0;
+    for (uint64_t r = 0; r < rounds; r++){
+        decompressor.ended = false;
+        decompressor.have = 0;
+        back_len = 0;
+        for (size_t pos = 0; pos < stream_len; ){
+            const unsigned char* raw;
+            size_t raw_len;
+            long taken = decompressor_push(&decompressor, stream + pos, stream_len - pos, &raw, &raw_len);
+            if (taken < 0 || back_len + raw_len > len){
+                fprintf(stderr, "%s: invalid stream\n", path);
+                return -1;
+            }
+            if (raw != NULL){
+                memcpy(back + back_len, raw, raw_len);
+                back_len += raw_len;
+            }
+            pos += taken;
+        }
+    }
+    double unpack_seconds = wall_seconds() - start;
+
+    double total = (double) rounds * len;
+    printf("%-28s %10zu B -> %10zu B (%5.2fx) pack %8.1f MB/s unpack %8.1f MB/s%s\n", path, len, stream_len,
+           (double) len / stream_len, total / pack_seconds / 1e6, total / unpack_seconds / 1e6,
+           back_len == len && memcmp(back, data, len) == 0 ? "" : " MISMATCH");
+
+    compressor_free(&compressor);
+    decompressor_free(&decompressor);
+    free(stream);
+    free(back);
+    free(data);
+    return 0;
+}
+
+int main(int argc, char** argv){
+    uint64_t bytes = (argc > 1 ? strtoull(argv[1], NULL, 10) : DEFAULT_MEGABYTES) << 20;
+    static const char* defaults[] = {"test_res/testfile.txt", "test_res/download.jpeg"};
+
+    int status = EXIT_SUCCESS;
+    if (argc > 2){
+        for (int i = 2; i < argc; i++){
+            if (bench(argv[i], bytes) < 0){
+                status = EXIT_FAILURE;
+            }
+        }
+    }
+    else {
+        for (size_t i = 0; i < sizeof(defaults) / sizeof(defaults[0]); i++){
+            if (bench(defaults[i], bytes) < 0){
+                status = EXIT_FAILURE;
+            }
+        }
+    }
+    return status;
+}
@@ -0,0 +1,90 @@
+/**
+ * @file crc32c_bench.c
+ * @brief Measures the throughput of each CRC32C implementation (see crc32c.h) in bytes per cycle,
+ * for buffers the size of a small packet, an Ethernet packet and the largest packet.
+ * @author Connor Johst - cjohst & Aaditya Suri - AadityaSuri
+ * @bug No known bugs
+ *
+ * Cycles are read from the time stamp counter, which ticks at the nominal clock rate, so turbo
+ * and frequency scaling shift the numbers somewhat. Usage: bench_crc32c [megabytes]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+#include "crc32c.h"
+
+#define DEFAULT_MEGABYTES 1024
+#define BUFFER_SZ 65536
+
+typedef uint32_t (*crc32c_fn)(uint32_t crc, const void* data, size_t len);
+
+static double wall_seconds(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t cycles(void){
+#if defined(__x86_64__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+// checksums bytes in buffers of size bytes and reports the rate
+static void bench(const char* name, crc32c_fn fn, const unsigned char* buffer, size_t size, uint64_t bytes){
+    uint64_t rounds = bytes / size;
+    uint32_t crc = 0;
+
+    double start = wall_seconds();
+    uint64_t start_cycles = cycles();
+    for (uint64_t i = 0; i < rounds; i++){
+        crc = fn(crc, buffer, size);
+    }
+    uint64_t elapsed_cycles = cycles() - start_cycles;
+    double seconds = wall_seconds() - start;
+
+    double total = (double) rounds * size;
+    printf("%-10s %6zu B buffers %8.2f GB/s", name, size, total / seconds / 1e9);
+    if (elapsed_cycles > 0){
+        printf(" %6.2f bytes/cycle", total / elapsed_cycles);
+    }
+    printf(" %8.0f ns/buffer (crc %08x)\n", seconds * 1e9 / rounds, crc);
+}
+
+int main(int argc, char** argv){
+    uint64_t bytes = (argc > 1 ? strtoull(argv[1], NULL, 10) : DEFAULT_MEGABYTES) << 20;
+    static const size_t sizes[] = {64, 1472, BUFFER_SZ};
+
+    unsigned char* buffer = malloc(BUFFER_SZ);
+    if (buffer == NULL){
+        fprintf(stderr, "Cannot allocate buffer\n");
+        return EXIT_FAILURE;
+    }
+    srand(1);
+    for (size_t i = 0; i < BUFFER_SZ; i++){
+        buffer[i] = rand();
+    }
+
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++){
+        bench("table", crc32c_sw, buffer, sizes[i], bytes / 8);
+        if (crc32c_hw_available()){
+            bench("sse4.2", crc32c_hw, buffer, sizes[i], bytes);
+        }
+    }
+    if (!crc32c_hw_available()){
+        printf("sse4.2 not available on this CPU\n");
+    }
+
+    free(buffer);
+    return EXIT_SUCCESS;
+}
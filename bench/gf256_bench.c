@@ -0,0 +1,89 @@
+/**
+ * @file gf256_bench.c
+ * @brief Measures how fast buffers are multiplied by a constant and added to another in GF(2^8)
+ * (see gf256.h), the inner loop of forward error correction, in bytes per cycle.
+ * @author Connor Johst - cjohst & Aaditya Suri - AadityaSuri
+ * @bug No known bugs
+ *
+ * Cycles are read from the time stamp counter, which ticks at the nominal clock rate, so turbo
+ * and frequency scaling shift the numbers somewhat. Usage: bench_gf256 [megabytes]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+#include "gf256.h"
+
+#define DEFAULT_MEGABYTES 1024
+#define BUFFER_SZ 65536
+#define FACTOR 0x53 // any factor but 0 and 1, which skip the multiplication
+
+typedef void (*mul_add_fn)(uint8_t* dst, const uint8_t* src, uint8_t c, size_t len);
+
+static double wall_seconds(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t cycles(void){
+#if defined(__x86_64__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+// multiplies and adds bytes in buffers of size bytes and reports the rate
+static void bench(const char* name, mul_add_fn fn, uint8_t* dst, const uint8_t* src, size_t size, uint64_t bytes){
+    uint64_t rounds = bytes / size;
+
+    double start = wall_seconds();
+    uint64_t start_cycles = cycles();
+    for (uint64_t i = 0; i < rounds; i++){
+        fn(dst, src, FACTOR, size);
+    }
+    uint64_t elapsed_cycles = cycles() - start_cycles;
+    double seconds = wall_seconds() - start;
+
+    double total = (double) rounds * size;
+    printf("%-10s %6zu B buffers %8.2f GB/s", name, size, total / seconds / 1e9);
+    if (elapsed_cycles > 0){
+        printf(" %6.2f bytes/cycle", total / elapsed_cycles);
+    }
+    printf(" %8.0f ns/buffer (byte %02x)\n", seconds * 1e9 / rounds, dst[size - 1]);
+}
+
+int main(int argc, char** argv){
+    uint64_t bytes = (argc > 1 ? strtoull(argv[1], NULL, 10) : DEFAULT_MEGABYTES) << 20;
+    static const size_t sizes[] = {1472, BUFFER_SZ};
+
+    uint8_t* src = malloc(BUFFER_SZ);
+    uint8_t* dst = calloc(1, BUFFER_SZ);
+    if (src == NULL || dst == NULL){
+        fprintf(stderr, "Cannot allocate buffers\n");
+        return EXIT_FAILURE;
+    }
+    srand(1);
+    for (size_t i = 0; i < BUFFER_SZ; i++){
+        src[i] = rand();
+    }
+
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++){
+        bench("table", gf256_mul_add_sw, dst, src, sizes[i], bytes / 8);
+        if (strcmp(gf256_impl(), "table") != 0){
+            bench(gf256_impl(), gf256_mul_add, dst, src, sizes[i], bytes);
+        }
+    }
+
+    free(src);
+    free(dst);
+    return EXIT_SUCCESS;
+}
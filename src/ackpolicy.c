@@ -0,0 +1,81 @@
+/**
+ * @file ackpolicy.c
+ * @brief Receiver ACK policy: delayed, coalesced ACKs with immediate ACKs on reordering.
+ * @author Connor Johst - cjohst & Aaditya Suri - AadityaSuri
+ * @bug No known bugs
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ackpolicy.h"
+
+/**
+ * @brief Initializes an ACK policy.
+ *
+ * @param policy The policy to initialize.
+ * @param ack_every Number of in-order packets acknowledged by one ACK (1 acknowledges every packet).
+ * @param max_delay Longest an ACK may be held back, in microseconds.
+ */
+
+void ack_policy_init(ack_policy_t* policy, unsigned int ack_every, uint64_t max_delay){
+    policy->ack_every = ack_every ? ack_every : 1;
+    policy->max_delay = max_delay;
+    policy->pending = 0;
+    policy->deadline = ACK_POLICY_NO_DEADLINE;
+    policy->last_seq = 0;
+    policy->last_time = 0;
+}
+
+/**
+ * @brief Records a received data packet and decides whether to acknowledge it right away.
+ *
+ * @param policy The policy.
+ * @param seq The sequence number of the packet.
+ * @param immediate Whether the packet was out of order, filled a gap or was a duplicate.
+ * @param now The current time in microseconds.
+ * @return true if an ACK should be sent now.
+ */
+
+bool ack_policy_on_packet(ack_policy_t* policy, uint32_t seq, bool immediate, uint64_t now){
+    policy->last_seq = seq;
+    policy->last_time = now;
+    if (policy->pending++ == 0){
+        policy->deadline = now + policy->max_delay;
+    }
+    return immediate || policy->pending >= policy->ack_every || now >= policy->deadline;
+}
+
+/**
+ * @brief Checks whether the delay timer of a pending ACK has expired.
+ *
+ * @param policy The policy.
+ * @param now The current time in microseconds.
+ * @return true if an ACK should be sent now.
+ */
+
+bool ack_policy_due(const ack_policy_t* policy, uint64_t now){
+    return policy->pending > 0 && now >= policy->deadline;
+}
+
+/**
+ * @brief Returns when the pending ACK must be sent.
+ *
+ * @param policy The policy.
+ * @return The deadline in microseconds, or ACK_POLICY_NO_DEADLINE if no ACK is pending.
+ */
+
+uint64_t ack_policy_deadline(const ack_policy_t* policy){
+    return policy->pending > 0 ? policy->deadline : ACK_POLICY_NO_DEADLINE;
+}
+
+/**
+ * @brief Records that an ACK covering every packet received so far has been sent.
+ *
+ * @param policy The policy.
+ */
+
+void ack_policy_sent(ack_policy_t* policy){
+    policy->pending = 0;
+    policy->deadline = ACK_POLICY_NO_DEADLINE;
+}
@@ -0,0 +1,581 @@
+/**
+ * @file batchio.c
+ * @brief Batched datagram I/O: fills and drains up to BATCH_MAX datagrams per syscall with
+ * sendmmsg() and recvmmsg().
+ * @author Connor Johst - cjohst & Aaditya Suri - AadityaSuri
+ * @bug No known bugs
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <linux/errqueue.h>
+
+#include "batchio.h"
+
+/**
+ * @brief Allocates the buffers of a batch.
+ *
+ * @param batch The batch to initialize.
+ * @param buf_size Size of each slot's buffer, the largest datagram it can receive or build.
+ * @return 0 on success, -1 if the buffers could not be allocated.
+ */
+
+int batch_init(batch_io_t* batch, size_t buf_size){
+    memset(batch, 0, sizeof(batch_io_t));
+    batch->buffers = (unsigned char*) malloc(BATCH_MAX * buf_size);
+    if (batch->buffers == NULL){
+        return -1;
+    }
+    batch->buf_size = buf_size;
+    return 0;
+}
+
+/**
+ * @brief Frees the buffers of a batch.
+ *
+ * @param batch The batch.
+ */
+
+void batch_free(batch_io_t* batch){
+    free(batch->buffers);
+    batch->buffers = NULL;
+    batch->count = 0;
+}
+
+/**
+ * @brief Turns on UDP generic segmentation offload for sends through this batch.
+ *
+ * @param batch The batch.
+ * @param sock_fd The socket the batch sends on.
+ * @param segment_size Size of a full datagram; shorter datagrams end a coalesced run.
+ * @return 0 if GSO is enabled, -1 if the kernel does not support it (the batch is unchanged).
+ */
+
+int batch_enable_gso(batch_io_t* batch, int sock_fd, size_t segment_size){
+    // probe support; the segment size is passed per send as ancillary data
+    int probe = segment_size;
+    if (setsockopt(sock_fd, SOL_UDP, UDP_SEGMENT, &probe, sizeof(probe)) < 0){
+        return -1;
+    }
+    probe = 0;
+    setsockopt(sock_fd, SOL_UDP, UDP_SEGMENT, &probe, sizeof(probe));
+    batch->gso_size = segment_size;
+    return 0;
+}
+
+/**
+ * @brief Turns on MSG_ZEROCOPY for sends of at least BATCH_ZEROCOPY_MIN bytes through this batch.
+ *
+ * @param batch The batch.
+ * @param sock_fd The socket the batch sends on.
+ * @return 0 if zerocopy is enabled, -1 if the kernel does not support it (the batch is unchanged).
+ */
+
+int batch_enable_zerocopy(batch_io_t* batch, int sock_fd){
+    int on = 1;
+    if (setsockopt(sock_fd, SOL_SOCKET, SO_ZEROCOPY, &on, sizeof(on)) < 0){
+        return -1;
+    }
+    batch->zerocopy = true;
+    batch->zc_limit = SIZE_MAX;
+    return 0;
+}
+
+/**
+ * @brief Records that the kernel is done with the MSG_ZEROCOPY sends lo to hi.
+ *
+ * @param batch The batch.
+ * @param lo First send ID of the range.
+ * @param hi Last send ID of the range.
+ */
+
+static void batch_zerocopy_complete(batch_io_t* batch, uint32_t lo, uint32_t hi){
+    batch->zc_completed += hi - lo + 1;
+    if (lo == batch->zc_done){
+        batch->zc_done = hi + 1;
+    }
+    // ranges reported out of order only count once everything issued has completed
+    if (batch->zc_completed == batch->zc_issued){
+        batch->zc_done = batch->zc_issued;
+    }
+}
+
+/**
+ * @brief Reads the completions of MSG_ZEROCOPY sends off the socket's error queue, without blocking.
+ *
+ * @param batch The batch.
+ * @param sock_fd The socket the batch sends on.
+ * @return The number of completion reports read, or -1 on error.
+ */
+
+int batch_reap_zerocopy(batch_io_t* batch, int sock_fd){
+    int reaped = 0;
+    while (batch->zerocopy && batch->zc_completed != batch->zc_issued){
+        char control[CMSG_SPACE(sizeof(struct sock_extended_err) + sizeof(struct sockaddr_in))];
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        if (recvmsg(sock_fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0){
+            return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? reaped : -1;
+        }
+        for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)){
+            const struct sock_extended_err* err = (const struct sock_extended_err*) CMSG_DATA(cmsg);
+            if (cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR && err->ee_origin == SO_EE_ORIGIN_ZEROCOPY){
+                // ee_info and ee_data are the first and last ID of a range of completed sends
+                batch_zerocopy_complete(batch, err->ee_info, err->ee_data);
+                reaped++;
+            }
+        }
+    }
+    return reaped;
+}
+
+/**
+ * @brief Returns a mark covering every send a datagram queued now can go out with.
+ *
+ * @param batch The batch.
+ * @return The mark, to be passed to batch_zerocopy_released().
+ */
+
+uint32_t batch_zerocopy_mark(const batch_io_t* batch){
+    // the datagram leaves with the next flush, which issues at most BATCH_MAX sends
+    return batch->zc_issued + BATCH_MAX;
+}
+
+/**
+ * @brief Checks whether the kernel is done with every send covered by a mark, so the memory the
+ * datagrams queued before the mark was taken were gathered from may change.
+ *
+ * @param batch The batch.
+ * @param mark A mark returned by batch_zerocopy_mark().
+ * @return true if the memory may change; always true when zerocopy is off.
+ */
+
+bool batch_zerocopy_released(const batch_io_t* batch, uint32_t mark){
+    if (!batch->zerocopy){
+        return true;
+    }
+    // sends covered by the mark that have not been issued yet never will be for those datagrams
+    uint32_t needed = (int32_t) (mark - batch->zc_issued) < 0 ? mark : batch->zc_issued;
+    return (int32_t) (batch->zc_done - needed) >= 0;
+}
+
+/**
+ * @brief Turns on UDP generic receive offload for receives through this batch, growing its
+ * buffers to BATCH_GRO_BUFFER_SZ.
+ *
+ * @param batch The batch.
+ * @param sock_fd The socket the batch receives from.
+ * @return 0 if GRO is enabled, -1 if the kernel does not support it or the buffers could not be
+ * grown (the batch is unchanged).
+ */
+
+int batch_enable_gro(batch_io_t* batch, int sock_fd){
+    unsigned char* buffers = batch->buffers;
+    if (batch->buf_size < BATCH_GRO_BUFFER_SZ){
+        buffers = (unsigned char*) malloc(BATCH_MAX * BATCH_GRO_BUFFER_SZ);
+        if (buffers == NULL){
+            return -1;
+        }
+    }
+
+    int on = 1;
+    if (setsockopt(sock_fd, SOL_UDP, UDP_GRO, &on, sizeof(on)) < 0){
+        if (buffers != batch->buffers){
+            free(buffers);
+        }
+        return -1;
+    }
+
+    if (buffers != batch->buffers){
+        free(batch->buffers);
+        batch->buffers = buffers;
+        batch->buf_size = BATCH_GRO_BUFFER_SZ;
+    }
+    batch->gro = true;
+    return 0;
+}
+
+/**
+ * @brief Fills in the message header of the next slot and makes it part of the batch.
+ *
+ * @param batch The batch.
+ * @param iovcnt Number of iovecs already set up in the slot.
+ * @param addr Destination address, or NULL to leave it unset.
+ */
+
+static void batch_push(batch_io_t* batch, int iovcnt, const struct sockaddr_in* addr){
+    unsigned int i = batch->count++;
+    struct msghdr* hdr = &batch->msgs[i].msg_hdr;
+    memset(hdr, 0, sizeof(struct msghdr));
+    if (addr != NULL){
+        batch->addrs[i] = *addr;
+        hdr->msg_name = &batch->addrs[i];
+        hdr->msg_namelen = sizeof(struct sockaddr_in);
+    }
+    hdr->msg_iov = batch->iovs[i];
+    hdr->msg_iovlen = iovcnt;
+}
+
+/**
+ * @brief Returns the buffer of the next free slot, to build a datagram in place.
+ *
+ * @param batch The batch. Must not be full.
+ * @return The slot's buffer of buf_size bytes.
+ */
+
+void* batch_buffer(batch_io_t* batch){
+    return batch->buffers + batch->count * batch->buf_size;
+}
+
+/**
+ * @brief Queues the datagram built in the buffer returned by batch_buffer().
+ *
+ * @param batch The batch.
+ * @param len Length of the datagram.
+ * @param addr Destination address.
+ */
+
+void batch_commit(batch_io_t* batch, size_t len, const struct sockaddr_in* addr){
+    batch->iovs[batch->count][0].iov_base = batch_buffer(batch);
+    batch->iovs[batch->count][0].iov_len = len;
+    batch_push(batch, 1, addr);
+}
+
+/**
+ * @brief Queues a datagram gathered from caller memory, without copying it.
+ *
+ * @param batch The batch. Must not be full.
+ * @param iov The pieces of the datagram, which must stay valid until the batch is flushed.
+ * @param iovcnt Number of pieces, at most BATCH_MAX_IOV.
+ * @param addr Destination address.
+ */
+
+void batch_queue_iov(batch_io_t* batch, const struct iovec* iov, int iovcnt, const struct sockaddr_in* addr){
+    memcpy(batch->iovs[batch->count], iov, iovcnt * sizeof(struct iovec));
+    batch_push(batch, iovcnt, addr);
+}
+
+/**
+ * @brief Queues a contiguous datagram from caller memory, without copying it.
+ *
+ * @param batch The batch. Must not be full.
+ * @param data The datagram, which must stay valid until the batch is flushed.
+ * @param len Length of the datagram.
+ * @param addr Destination address.
+ */
+
+void batch_queue(batch_io_t* batch, const void* data, size_t len, const struct sockaddr_in* addr){
+    struct iovec iov;
+    iov.iov_base = (void*) data;
+    iov.iov_len = len;
+    batch_queue_iov(batch, &iov, 1, addr);
+}
+
+/**
+ * @brief Checks whether every slot of the batch is in use.
+ *
+ * @param batch The batch.
+ * @return Non-zero if no more datagrams can be queued before a flush.
+ */
+
+int batch_full(const batch_io_t* batch){
+    return batch->count == BATCH_MAX;
+}
+
+/**
+ * @brief Returns the total length of a queued datagram.
+ *
+ * @param msg The datagram's message header.
+ * @return The sum of its iovec lengths.
+ */
+
+static size_t batch_msg_len(const struct msghdr* msg){
+    size_t len = 0;
+    for (size_t k = 0; k < msg->msg_iovlen; k++){
+        len += msg->msg_iov[k].iov_len;
+    }
+    return len;
+}
+
+/**
+ * @brief Checks whether a message goes out with MSG_ZEROCOPY.
+ *
+ * @param batch The batch the message belongs to.
+ * @param msg The message.
+ * @return true if zerocopy is on and the message is large enough, but not too large.
+ */
+
+static bool batch_zerocopy_eligible(const batch_io_t* batch, const struct msghdr* msg){
+    if (!batch->zerocopy){
+        return false;
+    }
+    size_t len = batch_msg_len(msg);
+    return len >= BATCH_ZEROCOPY_MIN && len < batch->zc_limit;
+}
+
+/**
+ * @brief Waits until a socket whose send buffer was full can take more datagrams. ENOBUFS comes
+ * from a full device queue while the socket itself still polls writable, so the wait is bounded by
+ * BATCH_FULL_WAIT_MS.
+ *
+ * @param sock_fd The socket to send on.
+ * @return 0 once the send may be retried, -1 with errno set if poll() failed.
+ */
+
+static int batch_wait_writable(int sock_fd){
+    struct pollfd pfd = { .fd = sock_fd, .events = POLLOUT, .revents = 0 };
+    if (poll(&pfd, 1, BATCH_FULL_WAIT_MS) < 0 && errno != EINTR){
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Sends an array of messages with as few sendmmsg() calls as possible. With zerocopy on,
+ * runs of messages of at least BATCH_ZEROCOPY_MIN bytes go out with MSG_ZEROCOPY, each taking the
+ * next send ID.
+ *
+ * @param batch The batch the messages belong to.
+ * @param msgs The messages.
+ * @param count Number of messages.
+ * @param sock_fd The socket to send on.
+ * @param sent Set to the number of messages sent, all of them unless there was an error.
+ * @return 0 on success, or -1 with errno set on a send error. A full socket buffer is waited out
+ * rather than reported.
+ */
+
+static int batch_sendmmsg(batch_io_t* batch, struct mmsghdr* msgs, unsigned int count, int sock_fd,
+                          unsigned int* sent){
+    *sent = 0;
+    while (*sent < count){
+        // sendmmsg() takes one set of flags, so large and small messages go in separate calls
+        bool zerocopy = batch_zerocopy_eligible(batch, &msgs[*sent].msg_hdr);
+        unsigned int run = 1;
+        while (*sent + run < count && batch->zerocopy
+                && batch_zerocopy_eligible(batch, &msgs[*sent + run].msg_hdr) == zerocopy){
+            run++;
+        }
+        int n = sendmmsg(sock_fd, &msgs[*sent], run, zerocopy ? MSG_ZEROCOPY : 0);
+        if (n < 0){
+            if (errno == EINTR){
+                continue;
+            }
+            if (errno == EMSGSIZE && zerocopy){
+                // the send spans more pages than one packet can pin; copy sends this large from now on
+                batch->zc_limit = batch_msg_len(&msgs[*sent].msg_hdr);
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS){
+                // the socket buffer or device queue is full; keep the rest and retry once it drains
+                if (batch_wait_writable(sock_fd) < 0){
+                    return -1;
+                }
+                continue;
+            }
+            return -1;
+        }
+        if (zerocopy){
+            batch->zc_issued += n;
+        }
+        *sent += n;
+    }
+    return 0;
+}
+
+/**
+ * @brief Coalesces runs of queued datagrams into UDP GSO sends and sends them.
+ *
+ * @param batch The batch, with gso_size set.
+ * @param sock_fd The socket to send on.
+ * @param sent Set to the number of datagrams sent, the first ones of the batch, even on an error.
+ * @return 0 on success, or -1 with errno set on a send error.
+ */
+
+static int batch_flush_gso(batch_io_t* batch, int sock_fd, unsigned int* sent){
+    unsigned int messages = 0;
+    unsigned int iovs = 0;
+    unsigned int datagrams_in[BATCH_MAX];
+    unsigned int i = 0;
+
+    while (i < batch->count){
+        const struct msghdr* first = &batch->msgs[i].msg_hdr;
+        struct msghdr* hdr = &batch->gso_msgs[messages].msg_hdr;
+        memset(hdr, 0, sizeof(struct msghdr));
+        hdr->msg_name = first->msg_name;
+        hdr->msg_namelen = first->msg_namelen;
+        hdr->msg_iov = &batch->gso_iovs[iovs];
+
+        // extend the run while datagrams are full-size and go to the same address
+        unsigned int run = 0;
+        size_t bytes = 0;
+        while (i < batch->count && run < BATCH_GSO_MAX_SEGS){
+            const struct msghdr* msg = &batch->msgs[i].msg_hdr;
+            size_t len = batch_msg_len(msg);
+            if (run > 0 && (bytes + len > BATCH_GSO_MAX_BYTES || msg->msg_namelen != first->msg_namelen
+                    || memcmp(msg->msg_name, first->msg_name, msg->msg_namelen) != 0)){
+                break;
+            }
+            memcpy(&batch->gso_iovs[iovs], msg->msg_iov, msg->msg_iovlen * sizeof(struct iovec));
+            iovs += msg->msg_iovlen;
+            hdr->msg_iovlen += msg->msg_iovlen;
+            bytes += len;
+            run++;
+            i++;
+            // only the last segment of a run may be shorter than gso_size
+            if (len != batch->gso_size){
+                break;
+            }
+        }
+
+        if (run > 1){
+            hdr->msg_control = batch->control[messages];
+            hdr->msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+            struct cmsghdr* cmsg = CMSG_FIRSTHDR(hdr);
+            cmsg->cmsg_level = SOL_UDP;
+            cmsg->cmsg_type = UDP_SEGMENT;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+            *(uint16_t*) CMSG_DATA(cmsg) = (uint16_t) batch->gso_size;
+        }
+        datagrams_in[messages++] = run;
+    }
+
+    unsigned int sent_messages;
+    int result = batch_sendmmsg(batch, batch->gso_msgs, messages, sock_fd, &sent_messages);
+    *sent = 0;
+    for (unsigned int m = 0; m < sent_messages; m++){
+        *sent += datagrams_in[m];
+    }
+    return result;
+}
+
+/**
+ * @brief Sends every queued datagram with as few sendmmsg() calls as possible and empties the batch.
+ *
+ * @param batch The batch.
+ * @param sock_fd The socket to send on.
+ * @return The number of datagrams sent, or -1 on a send error other than a full socket buffer,
+ * which is waited out.
+ */
+
+int batch_flush(batch_io_t* batch, int sock_fd){
+    unsigned int sent = 0;
+    int result = 0;
+
+    if (batch->gso_size > 0){
+        result = batch_flush_gso(batch, sock_fd, &sent);
+        if (result < 0 && (errno == EIO || errno == EINVAL || errno == EOPNOTSUPP)){
+            // the device cannot segment (e.g. no checksum offload), fall back to plain sends for good
+            batch->gso_size = 0;
+        }
+    }
+    if (batch->gso_size == 0){
+        // datagrams the GSO sends got out before failing are not sent again
+        unsigned int unsegmented;
+        result = batch_sendmmsg(batch, batch->msgs + sent, batch->count - sent, sock_fd, &unsegmented);
+        sent += unsegmented;
+    }
+
+    batch->count = 0;
+    return result < 0 ? -1 : (int) sent;
+}
+
+/**
+ * @brief Receives as many waiting datagrams as fit in the batch with one recvmmsg() call,
+ * without blocking.
+ *
+ * @param batch The batch. Previously received datagrams are discarded.
+ * @param sock_fd The socket to receive from.
+ * @return The number of datagrams received (0 if none were waiting), or -1 on error.
+ */
+
+int batch_recv(batch_io_t* batch, int sock_fd){
+    batch->count = 0;
+    for (unsigned int i = 0; i < BATCH_MAX; i++){
+        batch->iovs[i][0].iov_base = batch->buffers + i * batch->buf_size;
+        batch->iovs[i][0].iov_len = batch->buf_size;
+        batch_push(batch, 1, &batch->addrs[i]);
+        if (batch->gro){
+            batch->msgs[i].msg_hdr.msg_control = batch->control[i];
+            batch->msgs[i].msg_hdr.msg_controllen = sizeof(batch->control[i]);
+        }
+    }
+
+    int n = recvmmsg(sock_fd, batch->msgs, BATCH_MAX, MSG_DONTWAIT, NULL);
+    if (n < 0){
+        batch->count = 0;
+        return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+    }
+    batch->count = n;
+    return n;
+}
+
+/**
+ * @brief Returns the data of a received datagram.
+ *
+ * @param batch The batch.
+ * @param i Index of the datagram, below the count returned by batch_recv().
+ * @return The datagram's data.
+ */
+
+void* batch_data(batch_io_t* batch, unsigned int i){
+    return batch->iovs[i][0].iov_base;
+}
+
+/**
+ * @brief Returns the length of a received datagram.
+ *
+ * @param batch The batch.
+ * @param i Index of the datagram, below the count returned by batch_recv().
+ * @return The datagram's length in bytes.
+ */
+
+size_t batch_len(const batch_io_t* batch, unsigned int i){
+    return batch->msgs[i].msg_len;
+}
+
+/**
+ * @brief Returns the source address of a received datagram.
+ *
+ * @param batch The batch.
+ * @param i Index of the datagram, below the count returned by batch_recv().
+ * @return The address the datagram came from.
+ */
+
+const struct sockaddr_in* batch_addr(const batch_io_t* batch, unsigned int i){
+    return &batch->addrs[i];
+}
+
+/**
+ * @brief Returns the size of the datagrams coalesced into a received buffer.
+ *
+ * @param batch The batch.
+ * @param i Index of the buffer, below the count returned by batch_recv().
+ * @return The segment size in bytes.
+ */
+
+size_t batch_segment_size(const batch_io_t* batch, unsigned int i){
+    if (batch->gro){
+        const struct msghdr* hdr = &batch->msgs[i].msg_hdr;
+        for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(hdr); cmsg != NULL; cmsg = CMSG_NXTHDR((struct msghdr*) hdr, cmsg)){
+            if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO){
+                int segment_size = *(const int*) CMSG_DATA(cmsg);
+                if (segment_size > 0){
+                    return segment_size;
+                }
+            }
+        }
+    }
+    return batch->msgs[i].msg_len;
+}
@@ -0,0 +1,226 @@
+/**
+ * @file cc_bbr.c
+ * @brief BBR-style congestion control driven by bottleneck bandwidth and min RTT estimates.
+ * @author Connor Johst - cjohst & Aaditya Suri - AadityaSuri
+ * @bug No known bugs
+ *
+ * Instead of reacting to loss, the controller models the path as a pipe. The bottleneck bandwidth
+ * is the windowed max of the measured delivery rate over the last BBR_BW_ROUNDS rounds, and the
+ * propagation delay is the windowed min RTT over BBR_MIN_RTT_WINDOW. The pacing rate is a gain
+ * times the bandwidth and the window is a gain times the bandwidth-delay product. The controller
+ * goes through STARTUP, DRAIN, PROBE_BW (gain cycling) and periodic PROBE_RTT like BBRv1.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "congestion.h"
+
+#define BBR_HIGH_GAIN 2.885      // 2/ln(2), doubles the sending rate every round in STARTUP
+#define BBR_CWND_GAIN 2.0        // window gain in PROBE_BW
+#define BBR_BW_ROUNDS 10         // length of the bandwidth max filter in rounds
+#define BBR_MIN_RTT_WINDOW 10000000 // length of the min RTT filter in microseconds
+#define BBR_PROBE_RTT_TIME 200000   // time spent in PROBE_RTT in microseconds
+#define BBR_PROBE_RTT_CWND 4     // window used while probing for the min RTT
+#define BBR_MIN_CWND 4           // smallest window BBR ever uses
+#define BBR_FULL_BW_GROWTH 1.25  // growth per round that means the pipe is not full yet
+#define BBR_FULL_BW_ROUNDS 3     // rounds without growth before leaving STARTUP
+#define BBR_CYCLE_LEN 8          // number of phases in the PROBE_BW gain cycle
+
+static const double bbr_pacing_gain_cycle[BBR_CYCLE_LEN] = {1.25, 0.75, 1, 1, 1, 1, 1, 1};
+
+enum bbr_mode {
+    BBR_STARTUP,
+    BBR_DRAIN,
+    BBR_PROBE_BW,
+    BBR_PROBE_RTT,
+};
+
+/**
+ * Private state of a BBR controller.
+ */
+struct bbr_state {
+    enum bbr_mode mode;
+    double cwnd;
+    double pacing_gain;
+    double cwnd_gain;
+
+    double bw_rounds[BBR_BW_ROUNDS]; // max delivery rate (packets/sec) seen in each recent round
+    uint64_t round_count;
+    uint64_t round_start;
+
+    uint64_t min_rtt;
+    uint64_t min_rtt_stamp;
+    uint64_t probe_rtt_done;
+
+    double full_bw;
+    unsigned int full_bw_count;
+
+    unsigned int cycle_index;
+    uint64_t cycle_stamp;
+};
+
+static double bbr_max_bw(const struct bbr_state* bbr){
+    double max_bw = 0;
+    for (int i = 0; i < BBR_BW_ROUNDS; i++){
+        if (bbr->bw_rounds[i] > max_bw){
+            max_bw = bbr->bw_rounds[i];
+        }
+    }
+    return max_bw;
+}
+
+// bandwidth-delay product in packets, 0 until both estimates exist
+static double bbr_bdp(const struct bbr_state* bbr){
+    return bbr_max_bw(bbr) * (double) bbr->min_rtt / 1e6;
+}
+
+static double bbr_target_cwnd(const struct bbr_state* bbr, double gain){
+    double bdp = bbr_bdp(bbr);
+    if (bdp == 0){
+        return CC_INITIAL_CWND;
+    }
+    double target = gain * bdp;
+    return target < BBR_MIN_CWND ? BBR_MIN_CWND : target;
+}
+
+static int bbr_init(congestion_t* cc){
+    struct bbr_state* bbr = (struct bbr_state*) calloc(1, sizeof(struct bbr_state));
+    if (bbr == NULL){
+        return -1;
+    }
+    bbr->mode = BBR_STARTUP;
+    bbr->cwnd = CC_INITIAL_CWND;
+    bbr->pacing_gain = BBR_HIGH_GAIN;
+    bbr->cwnd_gain = BBR_HIGH_GAIN;
+    cc->state = bbr;
+    return 0;
+}
+
+static void bbr_release(congestion_t* cc){
+    free(cc->state);
+}
+
+static void bbr_enter_probe_bw(struct bbr_state* bbr, uint64_t now){
+    bbr->mode = BBR_PROBE_BW;
+    bbr->cwnd_gain = BBR_CWND_GAIN;
+    // start anywhere in the cycle except the draining phase
+    bbr->cycle_index = (unsigned int) (now % (BBR_CYCLE_LEN - 1));
+    if (bbr->cycle_index >= 1){
+        bbr->cycle_index++;
+    }
+    bbr->pacing_gain = bbr_pacing_gain_cycle[bbr->cycle_index];
+    bbr->cycle_stamp = now;
+}
+
+static void bbr_on_ack(congestion_t* cc, const cc_ack_sample_t* sample){
+    struct bbr_state* bbr = (struct bbr_state*) cc->state;
+    uint64_t now = sample->now;
+
+    // a round trip has passed once one min RTT has elapsed since the round started
+    uint64_t round_length = bbr->min_rtt ? bbr->min_rtt : sample->srtt_us;
+    bool new_round = round_length == 0 || now - bbr->round_start >= round_length;
+    if (new_round){
+        bbr->round_count++;
+        bbr->round_start = now;
+        bbr->bw_rounds[bbr->round_count % BBR_BW_ROUNDS] = 0;
+    }
+
+    double* round_bw = &bbr->bw_rounds[bbr->round_count % BBR_BW_ROUNDS];
+    if (sample->delivery_rate > *round_bw){
+        *round_bw = sample->delivery_rate;
+    }
+
+    if (sample->rtt_us && (bbr->min_rtt == 0 || sample->rtt_us <= bbr->min_rtt)){
+        bbr->min_rtt = sample->rtt_us;
+        bbr->min_rtt_stamp = now;
+    }
+
+    switch (bbr->mode){
+    case BBR_STARTUP:
+        // leave STARTUP once the bandwidth stopped growing for a few rounds
+        if (new_round){
+            double bw = bbr_max_bw(bbr);
+            if (bw >= bbr->full_bw * BBR_FULL_BW_GROWTH){
+                bbr->full_bw = bw;
+                bbr->full_bw_count = 0;
+            } else if (++bbr->full_bw_count >= BBR_FULL_BW_ROUNDS){
+                bbr->mode = BBR_DRAIN;
+                bbr->pacing_gain = 1.0 / BBR_HIGH_GAIN;
+                bbr->cwnd_gain = BBR_HIGH_GAIN;
+            }
+        }
+        break;
+    case BBR_DRAIN:
+        if (sample->in_flight <= bbr_bdp(bbr)){
+            bbr_enter_probe_bw(bbr, now);
+        }
+        break;
+    case BBR_PROBE_BW:
+        if (bbr->min_rtt && now - bbr->cycle_stamp >= bbr->min_rtt){
+            bbr->cycle_index = (bbr->cycle_index + 1) % BBR_CYCLE_LEN;
+            bbr->pacing_gain = bbr_pacing_gain_cycle[bbr->cycle_index];
+            bbr->cycle_stamp = now;
+        }
+        break;
+    case BBR_PROBE_RTT:
+        if (now >= bbr->probe_rtt_done){
+            bbr->min_rtt_stamp = now;
+            bbr_enter_probe_bw(bbr, now);
+        }
+        break;
+    }
+
+    // the min RTT estimate is stale, drain the queue for a moment to measure it again
+    if (bbr->mode != BBR_PROBE_RTT && bbr->min_rtt_stamp && now - bbr->min_rtt_stamp > BBR_MIN_RTT_WINDOW){
+        bbr->mode = BBR_PROBE_RTT;
+        bbr->pacing_gain = 1.0;
+        bbr->probe_rtt_done = now + BBR_PROBE_RTT_TIME;
+        bbr->min_rtt = 0;
+    }
+
+    // grow towards the target window as packets are delivered, never overshooting it
+    double target = bbr->mode == BBR_PROBE_RTT ? BBR_PROBE_RTT_CWND : bbr_target_cwnd(bbr, bbr->cwnd_gain);
+    if (bbr->cwnd < target){
+        bbr->cwnd += sample->acked;
+        if (bbr->cwnd > target){
+            bbr->cwnd = target;
+        }
+    } else {
+        bbr->cwnd = target;
+    }
+}
+
+static void bbr_on_loss(congestion_t* cc, uint64_t now){
+    // the model, not loss, drives the window
+    (void) cc;
+    (void) now;
+}
+
+static void bbr_on_timeout(congestion_t* cc, uint64_t now){
+    (void) now;
+    struct bbr_state* bbr = (struct bbr_state*) cc->state;
+    // packet conservation: restart from a small window and regrow on the following ACKs
+    bbr->cwnd = CC_MIN_CWND;
+}
+
+static double bbr_cwnd(const congestion_t* cc){
+    return ((const struct bbr_state*) cc->state)->cwnd;
+}
+
+static double bbr_pacing_rate(const congestion_t* cc){
+    const struct bbr_state* bbr = (const struct bbr_state*) cc->state;
+    return bbr->pacing_gain * bbr_max_bw(bbr) * (double) cc->mss;
+}
+
+const congestion_ops_t cc_bbr_ops = {
+    .name = "bbr",
+    .init = bbr_init,
+    .release = bbr_release,
+    .on_ack = bbr_on_ack,
+    .on_loss = bbr_on_loss,
+    .on_timeout = bbr_on_timeout,
+    .cwnd = bbr_cwnd,
+    .pacing_rate = bbr_pacing_rate,
+};
@@ -0,0 +1,141 @@
+/**
+ * @file cc_cubic.c
+ * @brief CUBIC congestion control (RFC 8312).
+ * @author Connor Johst - cjohst & Aaditya Suri - AadityaSuri
+ * @bug No known bugs
+ *
+ * After a loss the window follows W(t) = C * (t - K)^3 + W_max, growing quickly back towards the
+ * window at which the last loss happened, flattening out around it and then probing beyond it.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "congestion.h"
+
+#define CUBIC_C 0.4    // scaling constant of the cubic function
+#define CUBIC_BETA 0.7 // window reduction factor on loss
+
+/**
+ * Private state of a CUBIC controller.
+ */
+struct cubic_state {
+    double cwnd;
+    double ssthresh;
+    double w_max;       // window just before the last reduction
+    double w_last_max;  // previous w_max, used for fast convergence
+    double origin;      // plateau of the cubic function
+    double k;           // time in seconds the cubic function takes to reach origin
+    double w_est;       // window standard AIMD would have, for the TCP-friendly region
+    uint64_t epoch_start; // start of the current congestion avoidance epoch, 0 if none
+    uint64_t min_rtt;
+    uint64_t srtt;
+};
+
+static int cubic_init(congestion_t* cc){
+    struct cubic_state* cubic = (struct cubic_state*) calloc(1, sizeof(struct cubic_state));
+    if (cubic == NULL){
+        return -1;
+    }
+    cubic->cwnd = CC_INITIAL_CWND;
+    cubic->ssthresh = 1e9;
+    cc->state = cubic;
+    return 0;
+}
+
+static void cubic_release(congestion_t* cc){
+    free(cc->state);
+}
+
+static void cubic_on_ack(congestion_t* cc, const cc_ack_sample_t* sample){
+    struct cubic_state* cubic = (struct cubic_state*) cc->state;
+    cubic->srtt = sample->srtt_us;
+    if (sample->rtt_us && (cubic->min_rtt == 0 || sample->rtt_us < cubic->min_rtt)){
+        cubic->min_rtt = sample->rtt_us;
+    }
+
+    if (cubic->cwnd < cubic->ssthresh){
+        cubic->cwnd += sample->acked;
+        return;
+    }
+
+    if (cubic->epoch_start == 0){
+        cubic->epoch_start = sample->now;
+        if (cubic->cwnd < cubic->w_max){
+            cubic->k = cbrt((cubic->w_max - cubic->cwnd) / CUBIC_C);
+            cubic->origin = cubic->w_max;
+        } else {
+            cubic->k = 0;
+            cubic->origin = cubic->cwnd;
+        }
+        cubic->w_est = cubic->cwnd;
+    }
+
+    // evaluate the cubic function one RTT ahead, as the window will only take effect then
+    double t = (double) (sample->now - cubic->epoch_start + cubic->min_rtt) / 1e6;
+    double target = cubic->origin + CUBIC_C * (t - cubic->k) * (t - cubic->k) * (t - cubic->k);
+    if (target > 1.5 * cubic->cwnd){
+        target = 1.5 * cubic->cwnd;
+    }
+
+    if (target > cubic->cwnd){
+        cubic->cwnd += (target - cubic->cwnd) / cubic->cwnd * sample->acked;
+    } else {
+        cubic->cwnd += 0.01 * sample->acked / cubic->cwnd;
+    }
+
+    // never grow slower than standard AIMD would
+    cubic->w_est += 3.0 * (1.0 - CUBIC_BETA) / (1.0 + CUBIC_BETA) * sample->acked / cubic->cwnd;
+    if (cubic->w_est > cubic->cwnd){
+        cubic->cwnd = cubic->w_est;
+    }
+}
+
+static void cubic_on_loss(congestion_t* cc, uint64_t now){
+    (void) now;
+    struct cubic_state* cubic = (struct cubic_state*) cc->state;
+    cubic->epoch_start = 0;
+
+    // fast convergence: release bandwidth sooner if the last loss happened at a larger window
+    if (cubic->cwnd < cubic->w_last_max){
+        cubic->w_last_max = cubic->cwnd;
+        cubic->w_max = cubic->cwnd * (1.0 + CUBIC_BETA) / 2.0;
+    } else {
+        cubic->w_last_max = cubic->cwnd;
+        cubic->w_max = cubic->cwnd;
+    }
+
+    cubic->cwnd *= CUBIC_BETA;
+    if (cubic->cwnd < CC_MIN_CWND){
+        cubic->cwnd = CC_MIN_CWND;
+    }
+    cubic->ssthresh = cubic->cwnd;
+}
+
+static void cubic_on_timeout(congestion_t* cc, uint64_t now){
+    struct cubic_state* cubic = (struct cubic_state*) cc->state;
+    cubic_on_loss(cc, now);
+    cubic->cwnd = 1;
+}
+
+static double cubic_cwnd(const congestion_t* cc){
+    return ((const struct cubic_state*) cc->state)->cwnd;
+}
+
+static double cubic_pacing_rate(const congestion_t* cc){
+    const struct cubic_state* cubic = (const struct cubic_state*) cc->state;
+    double gain = cubic->cwnd < cubic->ssthresh ? 2.0 : 1.2;
+    return congestion_window_pacing_rate(cubic->cwnd, cc->mss, cubic->srtt, gain);
+}
+
+const congestion_ops_t cc_cubic_ops = {
+    .name = "cubic",
+    .init = cubic_init,
+    .release = cubic_release,
+    .on_ack = cubic_on_ack,
+    .on_loss = cubic_on_loss,
+    .on_timeout = cubic_on_timeout,
+    .cwnd = cubic_cwnd,
+    .pacing_rate = cubic_pacing_rate,
+};
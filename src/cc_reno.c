@@ -0,0 +1,89 @@
+/**
+ * @file cc_reno.c
+ * @brief Reno / AIMD congestion control: slow start, additive increase, multiplicative decrease.
+ * @author Connor Johst - cjohst & Aaditya Suri - AadityaSuri
+ * @bug No known bugs
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "congestion.h"
+
+#define RENO_BETA 0.5 // window reduction factor on loss
+
+/**
+ * Private state of a Reno controller.
+ */
+struct reno_state {
+    double cwnd;
+    double ssthresh;
+    uint64_t srtt;
+};
+
+static int reno_init(congestion_t* cc){
+    struct reno_state* reno = (struct reno_state*) malloc(sizeof(struct reno_state));
+    if (reno == NULL){
+        return -1;
+    }
+    reno->cwnd = CC_INITIAL_CWND;
+    reno->ssthresh = 1e9;
+    reno->srtt = 0;
+    cc->state = reno;
+    return 0;
+}
+
+static void reno_release(congestion_t* cc){
+    free(cc->state);
+}
+
+static void reno_on_ack(congestion_t* cc, const cc_ack_sample_t* sample){
+    struct reno_state* reno = (struct reno_state*) cc->state;
+    reno->srtt = sample->srtt_us;
+
+    if (reno->cwnd < reno->ssthresh){
+        // slow start: one packet per packet acked, i.e. doubling every RTT
+        reno->cwnd += sample->acked;
+    } else {
+        // congestion avoidance: one packet per window acked
+        reno->cwnd += (double) sample->acked / reno->cwnd;
+    }
+}
+
+static void reno_on_loss(congestion_t* cc, uint64_t now){
+    (void) now;
+    struct reno_state* reno = (struct reno_state*) cc->state;
+    reno->ssthresh = reno->cwnd * RENO_BETA;
+    if (reno->ssthresh < CC_MIN_CWND){
+        reno->ssthresh = CC_MIN_CWND;
+    }
+    reno->cwnd = reno->ssthresh;
+}
+
+static void reno_on_timeout(congestion_t* cc, uint64_t now){
+    struct reno_state* reno = (struct reno_state*) cc->state;
+    reno_on_loss(cc, now);
+    reno->cwnd = 1;
+}
+
+static double reno_cwnd(const congestion_t* cc){
+    return ((const struct reno_state*) cc->state)->cwnd;
+}
+
+static double reno_pacing_rate(const congestion_t* cc){
+    const struct reno_state* reno = (const struct reno_state*) cc->state;
+    // like Linux: pace at twice the window rate in slow start and 1.2 times afterwards
+    double gain = reno->cwnd < reno->ssthresh ? 2.0 : 1.2;
+    return congestion_window_pacing_rate(reno->cwnd, cc->mss, reno->srtt, gain);
+}
+
+const congestion_ops_t cc_reno_ops = {
+    .name = "reno",
+    .init = reno_init,
+    .release = reno_release,
+    .on_ack = reno_on_ack,
+    .on_loss = reno_on_loss,
+    .on_timeout = reno_on_timeout,
+    .cwnd = reno_cwnd,
+    .pacing_rate = reno_pacing_rate,
+};
@@ -0,0 +1,433 @@
+/**
+ * @file compress.c
+ * @brief Compression of the bytes a connection carries, in blocks of many packets.
+ * @author Connor Johst - cjohst & Aaditya Suri - AadityaSuri
+ * @bug No known bugs
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "compress.h"
+
+#define MIN_MATCH 4        // Shortest match the LZ4 format can express.
+#define LAST_LITERALS 5    // Bytes at the end of a block that are always literals.
+#define MATCH_FIND_LIMIT 12 // No match starts in the last this many bytes of a block.
+#define MAX_OFFSET 65535   // Farthest a match may reach back.
+#define SKIP_TRIGGER 6     // log2 of the bytes without a match after which the search takes longer strides.
+#define SAMPLE_RUNS 16     // Runs of bytes sampled by compress_entropy().
+#define SAMPLE_RUN_SZ 256  // Bytes per run sampled.
+
+/**
+ * @brief Reads 4 bytes in host order.
+ *
+ * @param p The bytes.
+ * @return Their value.
+ */
+
+static inline uint32_t read32(const unsigned char* p){
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+/**
+ * @brief Hashes 4 bytes into the hash table of a compressor.
+ *
+ * @param value The bytes.
+ * @return The index of their entry.
+ */
+
+static inline unsigned hash4(uint32_t value){
+    return (value * 2654435761U) >> (32 - COMPRESS_HASH_LOG);
+}
+
+/**
+ * @brief Writes the part of a literal or match length the token of its sequence cannot hold.
+ *
+ * @param out Where the length goes.
+ * @param len The length, 15 or more.
+ * @return Past the bytes written.
+ */
+
+static unsigned char* write_length(unsigned char* out, size_t len){
+    len -= 15;
+    while (len >= 255){
+        *out++ = 255;
+        len -= 255;
+    }
+    *out++ = (unsigned char) len;
+    return out;
+}
+
+/**
+ * @brief Reads the part of a literal or match length the token of its sequence could not hold.
+ *
+ * @param in The bytes following the token, advanced past the length.
+ * @param end The end of the input.
+ * @param len The length from the token, 15, increased by the bytes read.
+ * @return 0 on success, -1 if the input ends first.
+ */
+
+static int read_length(const unsigned char** in, const unsigned char* end, size_t* len){
+    unsigned char byte;
+    do {
+        if (*in >= end){
+            return -1;
+        }
+        byte = *(*in)++;
+        *len += byte;
+    } while (byte == 255);
+    return 0;
+}
+
+/**
+ * @brief Estimates the entropy of a block from up to 4 KB of its bytes spread over it.
+ *
+ * @param data The bytes.
+ * @param len Number of bytes.
+ * @return The Shannon entropy of the sampled bytes, in bits per byte.
+ */
+
+double compress_entropy(const unsigned char* data, size_t len){
+    uint32_t counts[256];
+    memset(counts, 0, sizeof(counts));
+    size_t sampled = 0;
+    if (len <= SAMPLE_RUNS * SAMPLE_RUN_SZ){
+        for (size_t i = 0; i < len; i++){
+            counts[data[i]]++;
+        }
+        sampled = len;
+    }
+    else {
+        size_t stride = (len - SAMPLE_RUN_SZ) / (SAMPLE_RUNS - 1);
+        for (size_t r = 0; r < SAMPLE_RUNS; r++){
+            const unsigned char* run = data + r * stride;
+            for (size_t i = 0; i < SAMPLE_RUN_SZ; i++){
+                counts[run[i]]++;
+            }
+        }
+        sampled = SAMPLE_RUNS * SAMPLE_RUN_SZ;
+    }
+
+    double entropy = 0;
+    for (unsigned b = 0; b < 256; b++){
+        if (counts[b] > 0){
+            double p = (double) counts[b] / (double) sampled;
+            entropy -= p * log2(p);
+        }
+    }
+    return entropy;
+}
+
+/**
+ * @brief Compresses bytes in the LZ4 block format.
+ *
+ * Greedy: every position is looked up in a table of the last position of each hash of four
+ * bytes, a match is taken as soon as one is found and extended both ways, and the search strides
+ * further the longer it goes without a match, so incompressible bytes are crossed quickly. Stale
+ * entries from earlier blocks are harmless, since every candidate is checked.
+ *
+ * @param table COMPRESS_TABLE_SZ hash table entries, in any state.
+ * @param src The bytes.
+ * @param len Number of bytes, below 4 GB.
+ * @param dst Receives the compressed bytes.
+ * @param capacity Bytes available at dst.
+ * @return The number of compressed bytes, or 0 if they do not fit in capacity.
+ */
+
+size_t lz4_compress(uint32_t* table, const unsigned char* src, size_t len, unsigned char* dst, size_t capacity){
+    const unsigned char* ip = src;
+    const unsigned char* anchor = src;
+    const unsigned char* end = src + len;
+    unsigned char* op = dst;
+    unsigned char* op_end = dst + capacity;
+
+    if (len > MATCH_FIND_LIMIT){
+        const unsigned char* find_limit = end - MATCH_FIND_LIMIT;
+        const unsigned char* match_limit = end - LAST_LITERALS;
+        while (ip < find_limit){
+            uint32_t sequence = read32(ip);
+            unsigned h = hash4(sequence);
+            const unsigned char* match = src + table[h];
+            table[h] = (uint32_t) (ip - src);
+            if (match >= ip || ip - match > MAX_OFFSET || read32(match) != sequence){
+                ip += 1 + ((ip - anchor) >> SKIP_TRIGGER);
+                continue;
+            }
+
+            while (ip > anchor && match > src && ip[-1] == match[-1]){
+                ip--;
+                match--;
+            }
+            const unsigned char* match_end = ip + MIN_MATCH;
+            const unsigned char* ref = match + MIN_MATCH;
+            while (match_end < match_limit && *match_end == *ref){
+                match_end++;
+                ref++;
+            }
+
+            size_t literal_len = ip - anchor;
+            size_t match_len = match_end - ip - MIN_MATCH;
+            if ((size_t) (op_end - op) < 1 + literal_len / 255 + 1 + literal_len + 2 + match_len / 255 + 1){
+                return 0;
+            }
+            unsigned char* token = op++;
+            *token = (unsigned char) ((literal_len < 15 ? literal_len : 15) << 4);
+            if (literal_len >= 15){
+                op = write_length(op, literal_len);
+            }
+            memcpy(op, anchor, literal_len);
+            op += literal_len;
+            size_t offset = ip - match;
+            *op++ = (unsigned char) offset;
+            *op++ = (unsigned char) (offset >> 8);
+            *token |= (unsigned char) (match_len < 15 ? match_len : 15);
+            if (match_len >= 15){
+                op = write_length(op, match_len);
+            }
+
+            ip = match_end;
+            anchor = ip;
+            if (ip < find_limit){
+                table[hash4(read32(ip - 2))] = (uint32_t) (ip - 2 - src);
+            }
+        }
+    }
+
+    size_t literal_len = end - anchor;
+    if ((size_t) (op_end - op) < 1 + literal_len / 255 + 1 + literal_len){
+        return 0;
+    }
+    unsigned char* token = op++;
+    *token = (unsigned char) ((literal_len < 15 ? literal_len : 15) << 4);
+    if (literal_len >= 15){
+        op = write_length(op, literal_len);
+    }
+    memcpy(op, anchor, literal_len);
+    op += literal_len;
+    return op - dst;
+}
+
+/**
+ * @brief Decompresses bytes in the LZ4 block format, which may come from anyone.
+ *
+ * @param src The compressed bytes.
+ * @param len Number of compressed bytes.
+ * @param dst Receives the bytes.
+ * @param capacity Bytes available at dst.
+ * @return The number of bytes, or -1 if the input is invalid or does not fit in capacity.
+ */
+
+long lz4_decompress(const unsigned char* src, size_t len, unsigned char* dst, size_t capacity){
+    const unsigned char* ip = src;
+    const unsigned char* end = src + len;
+    unsigned char* op = dst;
+    unsigned char* op_end = dst + capacity;
+
+    while (ip < end){
+        unsigned char token = *ip++;
+        size_t literal_len = token >> 4;
+        if (literal_len == 15 && read_length(&ip, end, &literal_len) < 0){
+            return -1;
+        }
+        if (literal_len > (size_t) (end - ip) || literal_len > (size_t) (op_end - op)){
+            return -1;
+        }
+        memcpy(op, ip, literal_len);
+        op += literal_len;
+        ip += literal_len;
+        // the last sequence has no match
+        if (ip == end){
+            break;
+        }
+
+        if (end - ip < 2){
+            return -1;
+        }
+        size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        size_t match_len = token & 15;
+        if (match_len == 15 && read_length(&ip, end, &match_len) < 0){
+            return -1;
+        }
+        match_len += MIN_MATCH;
+        if (offset == 0 || offset > (size_t) (op - dst) || match_len > (size_t) (op_end - op)){
+            return -1;
+        }
+        // a match closer than its length repeats its bytes, copied one offset at a time
+        while (match_len > 0){
+            size_t n = match_len < offset ? match_len : offset;
+            memcpy(op, op - offset, n);
+            op += n;
+            match_len -= n;
+        }
+    }
+    return op - dst;
+}
+
+/**
+ * @brief Initializes a compressor.
+ *
+ * @param compressor The compressor.
+ * @return 0 on success, -1 if memory runs out.
+ */
+
+int compressor_init(compressor_t* compressor){
+    memset(compressor, 0, sizeof(*compressor));
+    compressor->table = (uint32_t*) calloc(COMPRESS_TABLE_SZ, sizeof(uint32_t));
+    return compressor->table != NULL ? 0 : -1;
+}
+
+/**
+ * @brief Releases the memory of a compressor. A zeroed compressor may be freed too.
+ *
+ * @param compressor The compressor.
+ */
+
+void compressor_free(compressor_t* compressor){
+    free(compressor->table);
+    compressor->table = NULL;
+}
+
+/**
+ * @brief Appends a block, or the end of the stream, to the stream. The block is stored if its
+ * sample looks random, if it does not shrink, or while the compressor is switched off.
+ *
+ * @param compressor The compressor.
+ * @param raw The bytes of the block.
+ * @param raw_len Number of bytes, 0 to end the stream.
+ * @param out Receives the header and the block, sizeof(compress_header_t) + raw_len bytes at most.
+ * @return The number of bytes written to out.
+ */
+
+size_t compressor_pack(compressor_t* compressor, const unsigned char* raw, uint32_t raw_len, unsigned char* out){
+    compress_header_t header = {raw_len, 0};
+    unsigned char* body = out + sizeof(header);
+    if (raw_len > 0){
+        if (compressor->skip > 0){
+            compressor->skip--;
+        }
+        else if (compress_entropy(raw, raw_len) <= COMPRESS_MAX_ENTROPY){
+            header.wire_len = lz4_compress(compressor->table, raw, raw_len, body, raw_len - 1);
+        }
+
+        if (header.wire_len > 0){
+            compressor->misses = 0;
+        }
+        else {
+            memcpy(body, raw, raw_len);
+            header.wire_len = raw_len;
+            // a run of incompressible blocks is not worth sampling, let alone compressing
+            if (compressor->skip == 0 && ++compressor->misses >= COMPRESS_MISSES){
+                compressor->skip = COMPRESS_BACKOFF;
+                compressor->misses = 0;
+            }
+        }
+    }
+    memcpy(out, &header, sizeof(header));
+    compressor->raw_bytes += raw_len;
+    compressor->wire_bytes += sizeof(header) + header.wire_len;
+    return sizeof(header) + header.wire_len;
+}
+
+/**
+ * @brief Initializes a decompressor.
+ *
+ * @param decompressor The decompressor.
+ * @param max_block Largest block accepted.
+ * @return 0 on success, -1 if memory runs out.
+ */
+
+int decompressor_init(decompressor_t* decompressor, uint32_t max_block){
+    memset(decompressor, 0, sizeof(*decompressor));
+    decompressor->max_block = max_block;
+    decompressor->block = (unsigned char*) malloc(sizeof(compress_header_t) + max_block);
+    decompressor->raw = (unsigned char*) malloc(max_block);
+    if (decompressor->block == NULL || decompressor->raw == NULL){
+        decompressor_free(decompressor);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Releases the memory of a decompressor. A zeroed decompressor may be freed too.
+ *
+ * @param decompressor The decompressor.
+ */
+
+void decompressor_free(decompressor_t* decompressor){
+    free(decompressor->block);
+    free(decompressor->raw);
+    decompressor->block = NULL;
+    decompressor->raw = NULL;
+}
+
+/**
+ * @brief Takes bytes of the stream, in order, up to the end of the next block. Bytes after the
+ * end of the stream are taken and ignored.
+ *
+ * @param decompressor The decompressor.
+ * @param data The bytes.
+ * @param len Number of bytes.
+ * @param raw Set to the bytes of the block if it is complete, NULL otherwise; valid until the next call.
+ * @param raw_len Set to the number of bytes of the block.
+ * @return The number of bytes taken, or -1 if the stream is invalid.
+ */
+
+long decompressor_push(decompressor_t* decompressor, const unsigned char* data, size_t len,
+                       const unsigned char** raw, size_t* raw_len){
+    *raw = NULL;
+    *raw_len = 0;
+    if (decompressor->ended){
+        return len;
+    }
+
+    compress_header_t header;
+    size_t taken = 0;
+    if (decompressor->have < sizeof(header)){
+        taken = sizeof(header) - decompressor->have < len ? sizeof(header) - decompressor->have : len;
+        memcpy(decompressor->block + decompressor->have, data, taken);
+        decompressor->have += taken;
+        if (decompressor->have < sizeof(header)){
+            return taken;
+        }
+    }
+    memcpy(&header, decompressor->block, sizeof(header));
+    if (header.raw_len > decompressor->max_block || header.wire_len > header.raw_len
+        || (header.raw_len > 0 && header.wire_len == 0)){
+        return -1;
+    }
+    if (header.raw_len == 0){
+        decompressor->ended = true;
+        return len;
+    }
+
+    size_t block_len = sizeof(header) + header.wire_len;
+    size_t n = block_len - decompressor->have < len - taken ? block_len - decompressor->have : len - taken;
+    memcpy(decompressor->block + decompressor->have, data + taken, n);
+    decompressor->have += n;
+    taken += n;
+    if (decompressor->have < block_len){
+        return taken;
+    }
+
+    decompressor->have = 0;
+    const unsigned char* body = decompressor->block + sizeof(header);
+    if (header.wire_len == header.raw_len){
+        *raw = body;
+    }
+    else if (lz4_decompress(body, header.wire_len, decompressor->raw, decompressor->max_block) == (long) header.raw_len){
+        *raw = decompressor->raw;
+    }
+    else {
+        return -1;
+    }
+    *raw_len = header.raw_len;
+    return taken;
+}
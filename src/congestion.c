@@ -0,0 +1,78 @@
+/**
+ * @file congestion.c
+ * @brief Congestion control registry and helpers shared by the controllers.
+ * @author Connor Johst - cjohst & Aaditya Suri - AadityaSuri
+ * @bug No known bugs
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "congestion.h"
+
+static const congestion_ops_t* const congestion_algorithms[] = {
+    &cc_reno_ops,
+    &cc_cubic_ops,
+    &cc_bbr_ops,
+};
+
+/**
+ * @brief Looks up a congestion control algorithm by name.
+ *
+ * @param name The algorithm name ("reno", "cubic" or "bbr").
+ * @return The algorithm, or NULL if no algorithm has that name.
+ */
+
+const congestion_ops_t* congestion_find(const char* name){
+    for (size_t i = 0; i < sizeof(congestion_algorithms) / sizeof(congestion_algorithms[0]); i++){
+        if (strcmp(congestion_algorithms[i]->name, name) == 0){
+            return congestion_algorithms[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Creates a controller running the given algorithm.
+ *
+ * @param cc The controller to initialize.
+ * @param ops The algorithm.
+ * @param mss Size of a full packet on the wire in bytes.
+ * @return 0 on success, -1 if the private state could not be allocated.
+ */
+
+int congestion_init(congestion_t* cc, const congestion_ops_t* ops, size_t mss){
+    cc->ops = ops;
+    cc->mss = mss;
+    cc->state = NULL;
+    return ops->init(cc);
+}
+
+/**
+ * @brief Releases a controller's private state.
+ *
+ * @param cc The controller.
+ */
+
+void congestion_free(congestion_t* cc){
+    cc->ops->release(cc);
+    cc->state = NULL;
+}
+
+/**
+ * @brief Computes the pacing rate a window based controller would use: cwnd over srtt with a gain.
+ *
+ * @param cwnd The congestion window in packets.
+ * @param mss Size of a full packet in bytes.
+ * @param srtt_us The smoothed RTT in microseconds, 0 if not known.
+ * @param gain Multiplier applied to cwnd / srtt.
+ * @return The pacing rate in bytes per second, or 0 if srtt is not known.
+ */
+
+double congestion_window_pacing_rate(double cwnd, size_t mss, uint64_t srtt_us, double gain){
+    if (srtt_us == 0){
+        return 0;
+    }
+    return gain * cwnd * (double) mss * 1e6 / (double) srtt_us;
+}
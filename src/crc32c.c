@@ -0,0 +1,375 @@
+/**
+ * @file crc32c.c
+ * @brief CRC32C (Castagnoli) checksums of packets and of whole transfers.
+ * @author Connor Johst - cjohst & Aaditya Suri - AadityaSuri
+ * @bug No known bugs
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+#include "crc32c.h"
+
+#define CRC32C_POLY 0x82f63b78 // reflected Castagnoli polynomial
+#define CRC32C_LONG 8192 // bytes per stream when the hardware CRC runs three streams at once
+#define CRC32C_SHORT 256 // same, for buffers too short for CRC32C_LONG streams
+
+static pthread_once_t crc32c_once = PTHREAD_ONCE_INIT;
+static bool crc32c_has_hw;
+static uint32_t crc32c_table[8][256]; // slicing-by-8 tables
+static uint32_t crc32c_x2n[64]; // x^(2^n) mod p, for shifting CRCs by any length
+static uint32_t crc32c_long_shift[4][256]; // shifts a CRC register by CRC32C_LONG zero bytes
+static uint32_t crc32c_short_shift[4][256]; // shifts a CRC register by CRC32C_SHORT zero bytes
+
+/**
+ * @brief Multiplies two polynomials modulo p, in the reflected bit order of the CRC.
+ *
+ * @param a First polynomial.
+ * @param b Second polynomial.
+ * @return a * b mod p.
+ */
+
+static uint32_t crc32c_multmodp(uint32_t a, uint32_t b){
+    uint32_t m = (uint32_t) 1 << 31;
+    uint32_t p = 0;
+    for (;;){
+        if (a & m){
+            p ^= b;
+            if ((a & (m - 1)) == 0){
+                break;
+            }
+        }
+        m >>= 1;
+        b = b & 1 ? (b >> 1) ^ CRC32C_POLY : b >> 1;
+    }
+    return p;
+}
+
+/**
+ * @brief Computes x^(n * 2^k) mod p.
+ *
+ * @param n The multiplier of the exponent.
+ * @param k log2 of the unit, 3 for n in bytes.
+ * @return The power of x.
+ */
+
+static uint32_t crc32c_x2nmodp(uint64_t n, unsigned k){
+    uint32_t p = (uint32_t) 1 << 31; // x^0
+    while (n){
+        if (n & 1){
+            p = crc32c_multmodp(crc32c_x2n[k & 63], p);
+        }
+        n >>= 1;
+        k++;
+    }
+    return p;
+}
+
+/**
+ * @brief Fills a table that shifts a CRC register by len zero bytes, one byte of it at a time.
+ *
+ * @param table The table.
+ * @param len Number of zero bytes.
+ */
+
+static void crc32c_fill_shift(uint32_t table[4][256], size_t len){
+    uint32_t op = crc32c_x2nmodp(len, 3);
+    for (unsigned k = 0; k < 4; k++){
+        for (uint32_t n = 0; n < 256; n++){
+            table[k][n] = crc32c_multmodp(op, n << (8 * k));
+        }
+    }
+}
+
+/**
+ * @brief Shifts a CRC register by the zero bytes of a table from crc32c_fill_shift().
+ *
+ * @param table The table.
+ * @param crc The register.
+ * @return The shifted register.
+ */
+
+static inline uint32_t crc32c_shift(uint32_t table[4][256], uint32_t crc){
+    return table[0][crc & 0xff] ^ table[1][(crc >> 8) & 0xff]
+           ^ table[2][(crc >> 16) & 0xff] ^ table[3][crc >> 24];
+}
+
+/**
+ * @brief Builds the tables and picks the implementation, once per process.
+ */
+
+static void crc32c_init(void){
+    for (uint32_t n = 0; n < 256; n++){
+        uint32_t crc = n;
+        for (int bit = 0; bit < 8; bit++){
+            crc = crc & 1 ? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+        }
+        crc32c_table[0][n] = crc;
+    }
+    for (uint32_t n = 0; n < 256; n++){
+        for (int k = 1; k < 8; k++){
+            uint32_t prev = crc32c_table[k - 1][n];
+            crc32c_table[k][n] = (prev >> 8) ^ crc32c_table[0][prev & 0xff];
+        }
+    }
+
+    crc32c_x2n[0] = (uint32_t) 1 << 30; // x^1
+    for (int n = 1; n < 64; n++){
+        crc32c_x2n[n] = crc32c_multmodp(crc32c_x2n[n - 1], crc32c_x2n[n - 1]);
+    }
+
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    crc32c_has_hw = __builtin_cpu_supports("sse4.2");
+#endif
+    if (crc32c_has_hw){
+        crc32c_fill_shift(crc32c_long_shift, CRC32C_LONG);
+        crc32c_fill_shift(crc32c_short_shift, CRC32C_SHORT);
+    }
+}
+
+/**
+ * @brief Updates a CRC32C with the table-driven implementation.
+ *
+ * @param crc The CRC of the data before, 0 to start.
+ * @param data The data.
+ * @param len Number of bytes.
+ * @return The CRC of the data before followed by data.
+ */
+
+uint32_t crc32c_sw(uint32_t crc, const void* data, size_t len){
+    pthread_once(&crc32c_once, crc32c_init);
+    const unsigned char* next = (const unsigned char*) data;
+    crc = ~crc;
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    // slicing-by-8: one lookup per byte, but eight independent lookups per word
+    while (len >= 8){
+        uint64_t word;
+        memcpy(&word, next, sizeof(word));
+        word ^= crc;
+        crc = crc32c_table[7][word & 0xff] ^ crc32c_table[6][(word >> 8) & 0xff]
+              ^ crc32c_table[5][(word >> 16) & 0xff] ^ crc32c_table[4][(word >> 24) & 0xff]
+              ^ crc32c_table[3][(word >> 32) & 0xff] ^ crc32c_table[2][(word >> 40) & 0xff]
+              ^ crc32c_table[1][(word >> 48) & 0xff] ^ crc32c_table[0][word >> 56];
+        next += 8;
+        len -= 8;
+    }
+#endif
+    while (len--){
+        crc = (crc >> 8) ^ crc32c_table[0][(crc ^ *next++) & 0xff];
+    }
+    return ~crc;
+}
+
+#if defined(__x86_64__)
+
+/**
+ * @brief Runs the crc32 instruction over three streams of len bytes each, starting at next, and
+ * combines them into the register.
+ *
+ * The instruction has a latency of three cycles but a throughput of one per cycle, so three
+ * independent streams keep it busy.
+ *
+ * @param crc The register before the streams.
+ * @param next The first stream, followed by the other two.
+ * @param len Bytes per stream, a multiple of 8.
+ * @param shift Table from crc32c_fill_shift() for len bytes.
+ * @return The register after the three streams.
+ */
+
+__attribute__((target("sse4.2")))
+static uint64_t crc32c_hw_streams(uint64_t crc, const unsigned char* next, size_t len, uint32_t shift[4][256]){
+    uint64_t crc1 = 0;
+    uint64_t crc2 = 0;
+    const unsigned char* end = next + len;
+    do {
+        uint64_t word0, word1, word2;
+        memcpy(&word0, next, sizeof(word0));
+        memcpy(&word1, next + len, sizeof(word1));
+        memcpy(&word2, next + 2 * len, sizeof(word2));
+        crc = _mm_crc32_u64(crc, word0);
+        crc1 = _mm_crc32_u64(crc1, word1);
+        crc2 = _mm_crc32_u64(crc2, word2);
+        next += 8;
+    } while (next < end);
+    crc = crc32c_shift(shift, (uint32_t) crc) ^ crc1;
+    return crc32c_shift(shift, (uint32_t) crc) ^ crc2;
+}
+
+/**
+ * @brief Updates a CRC32C with the SSE4.2 implementation. Only call it if crc32c_hw_available().
+ *
+ * @param crc The CRC of the data before, 0 to start.
+ * @param data The data.
+ * @param len Number of bytes.
+ * @return The CRC of the data before followed by data.
+ */
+
+__attribute__((target("sse4.2")))
+uint32_t crc32c_hw(uint32_t crc, const void* data, size_t len){
+    pthread_once(&crc32c_once, crc32c_init);
+    const unsigned char* next = (const unsigned char*) data;
+    uint64_t crc0 = ~crc;
+
+    while (len > 0 && ((uintptr_t) next & 7) != 0){
+        crc0 = _mm_crc32_u8((uint32_t) crc0, *next++);
+        len--;
+    }
+    while (len >= 3 * CRC32C_LONG){
+        crc0 = crc32c_hw_streams(crc0, next, CRC32C_LONG, crc32c_long_shift);
+        next += 3 * CRC32C_LONG;
+        len -= 3 * CRC32C_LONG;
+    }
+    while (len >= 3 * CRC32C_SHORT){
+        crc0 = crc32c_hw_streams(crc0, next, CRC32C_SHORT, crc32c_short_shift);
+        next += 3 * CRC32C_SHORT;
+        len -= 3 * CRC32C_SHORT;
+    }
+    while (len >= 8){
+        uint64_t word;
+        memcpy(&word, next, sizeof(word));
+        crc0 = _mm_crc32_u64(crc0, word);
+        next += 8;
+        len -= 8;
+    }
+    while (len--){
+        crc0 = _mm_crc32_u8((uint32_t) crc0, *next++);
+    }
+    return ~(uint32_t) crc0;
+}
+
+#else
+
+/**
+ * @brief Updates a CRC32C with the SSE4.2 implementation. Only call it if crc32c_hw_available().
+ *
+ * @param crc The CRC of the data before, 0 to start.
+ * @param data The data.
+ * @param len Number of bytes.
+ * @return The CRC of the data before followed by data.
+ */
+
+uint32_t crc32c_hw(uint32_t crc, const void* data, size_t len){
+    return crc32c_sw(crc, data, len);
+}
+
+#endif
+
+/**
+ * @brief Checks whether the CPU has the SSE4.2 crc32 instruction, which crc32c() then uses.
+ *
+ * @return true if crc32c_hw() may be called.
+ */
+
+bool crc32c_hw_available(void){
+    pthread_once(&crc32c_once, crc32c_init);
+    return crc32c_has_hw;
+}
+
+/**
+ * @brief Updates a CRC32C with len bytes of data.
+ *
+ * @param crc The CRC of the data before, 0 to start.
+ * @param data The data.
+ * @param len Number of bytes.
+ * @return The CRC of the data before followed by data.
+ */
+
+uint32_t crc32c(uint32_t crc, const void* data, size_t len){
+    return crc32c_hw_available() ? crc32c_hw(crc, data, len) : crc32c_sw(crc, data, len);
+}
+
+/**
+ * @brief Computes the operator that appends len2 bytes to a CRC, for crc32c_combine_op().
+ *
+ * @param len2 Length of the data appended.
+ * @return The operator.
+ */
+
+uint32_t crc32c_combine_gen(uint64_t len2){
+    pthread_once(&crc32c_once, crc32c_init);
+    return crc32c_x2nmodp(len2, 3);
+}
+
+/**
+ * @brief Combines the CRCs of two consecutive blocks with an operator from crc32c_combine_gen().
+ *
+ * @param crc1 CRC of the first block.
+ * @param crc2 CRC of the second block.
+ * @param op crc32c_combine_gen() of the length of the second block.
+ * @return The CRC of the first block followed by the second.
+ */
+
+uint32_t crc32c_combine_op(uint32_t crc1, uint32_t crc2, uint32_t op){
+    return crc32c_multmodp(op, crc1) ^ crc2;
+}
+
+/**
+ * @brief Combines the CRCs of two consecutive blocks.
+ *
+ * @param crc1 CRC of the first block.
+ * @param crc2 CRC of the second block.
+ * @param len2 Length of the second block.
+ * @return The CRC of the first block followed by the second.
+ */
+
+uint32_t crc32c_combine(uint32_t crc1, uint32_t crc2, uint64_t len2){
+    return crc32c_combine_op(crc1, crc2, crc32c_combine_gen(len2));
+}
+
+/**
+ * @brief Starts the digest of an empty range.
+ *
+ * @param digest The digest.
+ * @param step Size of most blocks that will be added.
+ */
+
+void crc32c_digest_init(crc32c_digest_t* digest, uint64_t step){
+    digest->crc = 0;
+    digest->end = 0;
+    digest->step = step;
+    digest->step_op = crc32c_combine_gen(step);
+}
+
+/**
+ * @brief Adds a block to a digest. Blocks may be added in any order, but each only once.
+ *
+ * @param digest The digest.
+ * @param crc CRC of the block.
+ * @param offset Offset of the block in the range.
+ * @param len Length of the block.
+ */
+
+void crc32c_digest_add(crc32c_digest_t* digest, uint32_t crc, uint64_t offset, uint64_t len){
+    // CRCs combine linearly: the CRC of the range is the XOR of the CRC of every block shifted by
+    // the bytes that follow it
+    uint64_t end = offset + len;
+    if (end >= digest->end){
+        uint64_t gap = end - digest->end;
+        uint32_t op = gap == digest->step ? digest->step_op : crc32c_combine_gen(gap);
+        digest->crc = crc32c_combine_op(digest->crc, crc, op);
+        digest->end = end;
+    } else {
+        digest->crc ^= crc32c_combine(crc, 0, digest->end - end);
+    }
+}
+
+/**
+ * @brief Returns the CRC of the whole range, once every block of it has been added.
+ *
+ * @param digest The digest.
+ * @param total Length of the range.
+ * @return The CRC32C of the range.
+ */
+
+uint32_t crc32c_digest_final(const crc32c_digest_t* digest, uint64_t total){
+    return total > digest->end ? crc32c_combine(digest->crc, 0, total - digest->end) : digest->crc;
+}
@@ -0,0 +1,400 @@
+/**
+ * @file delta.c
+ * @brief Delta transfers: sending only the bytes of a file the receiver's older copy lacks.
+ * @author Connor Johst - cjohst & Aaditya Suri - AadityaSuri
+ * @bug No known bugs
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "delta.h"
+#include "crc32c.h"
+
+#define SIGN_CHUNK (1 << 20) // Bytes of the file read at once while signing it.
+
+#define XXH_PRIME1 11400714785074694791ULL
+#define XXH_PRIME2 14029467366897019727ULL
+#define XXH_PRIME3 1609587929392839161ULL
+#define XXH_PRIME4 9650029242287828579ULL
+#define XXH_PRIME5 2870177450012600261ULL
+
+/**
+ * @brief Returns the block size used to sign a file: about the square root of its size, so the
+ * signatures and the bytes of a changed block cost about the same.
+ *
+ * @param file_size Size of the file.
+ * @return A power of two between DELTA_MIN_BLOCK and DELTA_MAX_BLOCK.
+ */
+
+uint32_t delta_block_size(uint64_t file_size){
+    uint32_t block_size = DELTA_MIN_BLOCK;
+    while (block_size < DELTA_MAX_BLOCK && (uint64_t) block_size * block_size < file_size){
+        block_size *= 2;
+    }
+    return block_size;
+}
+
+/**
+ * @brief Computes the weak checksum of a block: the sum of its bytes in the low 16 bits and the
+ * sum of those sums, weighted by position, in the high 16 bits.
+ *
+ * @param data The bytes.
+ * @param len Number of bytes.
+ * @return The checksum.
+ */
+
+uint32_t delta_weak_sum(const uint8_t* data, size_t len){
+    uint32_t a = 0;
+    uint32_t b = 0;
+    for (size_t i = 0; i < len; i++){
+        a += data[i];
+        b += a;
+    }
+    return (a & 0xffff) | (b << 16);
+}
+
+/**
+ * @brief Reads 8 bytes in little-endian order.
+ *
+ * @param p The bytes.
+ * @return Their value.
+ */
+
+static inline uint64_t read64(const uint8_t* p){
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+/**
+ * @brief Reads 4 bytes in little-endian order.
+ *
+ * @param p The bytes.
+ * @return Their value.
+ */
+
+static inline uint32_t read32(const uint8_t* p){
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+/**
+ * @brief Rotates a 64-bit value left.
+ *
+ * @param x The value.
+ * @param r Bits to rotate by, between 1 and 63.
+ * @return The rotated value.
+ */
+
+static inline uint64_t rotl64(uint64_t x, unsigned r){
+    return (x << r) | (x >> (64 - r));
+}
+
+/**
+ * @brief Mixes 8 bytes of input into one of the four XXH64 accumulators.
+ *
+ * @param acc The accumulator.
+ * @param input The bytes.
+ * @return The new accumulator.
+ */
+
+static inline uint64_t xxh64_round(uint64_t acc, uint64_t input){
+    acc += input * XXH_PRIME2;
+    acc = rotl64(acc, 31);
+    return acc * XXH_PRIME1;
+}
+
+/**
+ * @brief Folds one of the four XXH64 accumulators into the hash.
+ *
+ * @param hash The hash.
+ * @param acc The accumulator.
+ * @return The new hash.
+ */
+
+static inline uint64_t xxh64_merge(uint64_t hash, uint64_t acc){
+    hash ^= xxh64_round(0, acc);
+    return hash * XXH_PRIME1 + XXH_PRIME4;
+}
+
+/**
+ * @brief Computes the XXH64 hash of a block, with seed 0.
+ *
+ * @param data The bytes.
+ * @param len Number of bytes.
+ * @return The hash.
+ */
+
+uint64_t delta_strong_hash(const void* data, size_t len){
+    const uint8_t* p = (const uint8_t*) data;
+    const uint8_t* end = p + len;
+    uint64_t hash;
+
+    if (len >= 32){
+        uint64_t v1 = XXH_PRIME1 + XXH_PRIME2;
+        uint64_t v2 = XXH_PRIME2;
+        uint64_t v3 = 0;
+        uint64_t v4 = -XXH_PRIME1;
+        do {
+            v1 = xxh64_round(v1, read64(p));
+            v2 = xxh64_round(v2, read64(p + 8));
+            v3 = xxh64_round(v3, read64(p + 16));
+            v4 = xxh64_round(v4, read64(p + 24));
+            p += 32;
+        } while (p + 32 <= end);
+        hash = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+        hash = xxh64_merge(hash, v1);
+        hash = xxh64_merge(hash, v2);
+        hash = xxh64_merge(hash, v3);
+        hash = xxh64_merge(hash, v4);
+    } else {
+        hash = XXH_PRIME5;
+    }
+    hash += len;
+
+    while (p + 8 <= end){
+        hash ^= xxh64_round(0, read64(p));
+        hash = rotl64(hash, 27) * XXH_PRIME1 + XXH_PRIME4;
+        p += 8;
+    }
+    if (p + 4 <= end){
+        hash ^= (uint64_t) read32(p) * XXH_PRIME1;
+        hash = rotl64(hash, 23) * XXH_PRIME2 + XXH_PRIME3;
+        p += 4;
+    }
+    while (p < end){
+        hash ^= *p * XXH_PRIME5;
+        hash = rotl64(hash, 11) * XXH_PRIME1;
+        p++;
+    }
+
+    hash ^= hash >> 33;
+    hash *= XXH_PRIME2;
+    hash ^= hash >> 29;
+    hash *= XXH_PRIME3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+/**
+ * @brief Signs every whole block of a file. A last block shorter than the others is left out.
+ *
+ * @param fd The file.
+ * @param file_size Bytes of the file to sign.
+ * @param block_size Bytes per block.
+ * @param signatures Set to the signatures, to be freed by the caller.
+ * @param count Set to the number of signatures.
+ * @return 0 on success, -1 on error with errno set.
+ */
+
+int delta_sign(int fd, uint64_t file_size, uint32_t block_size, delta_signature_t** signatures, uint32_t* count){
+    uint64_t blocks = file_size / block_size;
+    if (blocks > UINT32_MAX / sizeof(delta_signature_t)){
+        errno = EFBIG;
+        return -1;
+    }
+    size_t chunk = SIGN_CHUNK / block_size * block_size;
+    delta_signature_t* table = (delta_signature_t*) calloc(blocks + 1, sizeof(delta_signature_t));
+    uint8_t* buffer = (uint8_t*) malloc(chunk);
+    if (table == NULL || buffer == NULL){
+        free(table);
+        free(buffer);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    uint64_t block = 0;
+    while (block < blocks){
+        size_t want = blocks - block < chunk / block_size ? (blocks - block) * block_size : chunk;
+        size_t got = 0;
+        while (got < want){
+            ssize_t n = pread(fd, buffer + got, want - got, block * block_size + got);
+            if (n <= 0){
+                if (n == 0){
+                    errno = EIO;
+                }
+                free(table);
+                free(buffer);
+                return -1;
+            }
+            got += n;
+        }
+        for (size_t off = 0; off < want; off += block_size, block++){
+            table[block].weak = delta_weak_sum(buffer + off, block_size);
+            table[block].strong = delta_strong_hash(buffer + off, block_size);
+            table[block].crc = crc32c(0, buffer + off, block_size);
+        }
+    }
+    free(buffer);
+    *signatures = table;
+    *count = blocks;
+    return 0;
+}
+
+/**
+ * @brief Returns the bucket of a weak checksum.
+ *
+ * @param index The index.
+ * @param weak The weak checksum.
+ * @return The bucket.
+ */
+
+static inline uint32_t delta_bucket(const delta_index_t* index, uint32_t weak){
+    return (weak * 0x9e3779b1u) >> index->shift;
+}
+
+/**
+ * @brief Builds the index of a table of signatures.
+ *
+ * @param index The index.
+ * @param signatures The signatures, which must outlive the index.
+ * @param count Number of signatures.
+ * @param block_size Bytes per block.
+ * @return 0 on success, -1 if memory runs out.
+ */
+
+int delta_index_init(delta_index_t* index, const delta_signature_t* signatures, uint32_t count, uint32_t block_size){
+    // at least two buckets per signature keeps the chains short
+    unsigned bits = 4;
+    while (bits < 31 && (1u << bits) < 2 * (uint64_t) count){
+        bits++;
+    }
+    memset(index, 0, sizeof(*index));
+    index->signatures = signatures;
+    index->count = count;
+    index->block_size = block_size;
+    index->shift = 32 - bits;
+    index->heads = (int32_t*) malloc((1u << bits) * sizeof(int32_t));
+    index->next = (int32_t*) malloc(((size_t) count + 1) * sizeof(int32_t));
+    if (index->heads == NULL || index->next == NULL){
+        delta_index_free(index);
+        return -1;
+    }
+    memset(index->heads, 0xff, (1u << bits) * sizeof(int32_t));
+
+    // chained last to first, so a lookup finds the first block of the copy with the checksums
+    for (uint32_t i = count; i-- > 0;){
+        uint32_t bucket = delta_bucket(index, signatures[i].weak);
+        index->next[i] = index->heads[bucket];
+        index->heads[bucket] = i;
+    }
+    return 0;
+}
+
+/**
+ * @brief Releases the memory of an index.
+ *
+ * @param index The index.
+ */
+
+void delta_index_free(delta_index_t* index){
+    free(index->heads);
+    free(index->next);
+    index->heads = NULL;
+    index->next = NULL;
+}
+
+/**
+ * @brief Looks up the block of the copy holding the same bytes as a window of the file.
+ *
+ * @param index The signatures of the copy.
+ * @param window The block_size bytes of the window.
+ * @param weak The weak checksum of the window.
+ * @return The block, or -1 if none matches.
+ */
+
+static int64_t delta_lookup(const delta_index_t* index, const uint8_t* window, uint32_t weak){
+    bool hashed = false;
+    uint64_t strong = 0;
+    uint32_t crc = 0;
+    for (int32_t i = index->heads[delta_bucket(index, weak)]; i >= 0; i = index->next[i]){
+        const delta_signature_t* signature = &index->signatures[i];
+        if (signature->weak != weak){
+            continue;
+        }
+        if (!hashed){
+            strong = delta_strong_hash(window, index->block_size);
+            crc = crc32c(0, window, index->block_size);
+            hashed = true;
+        }
+        if (signature->strong == strong && signature->crc == crc){
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Finds the blocks of the receiver's copy in a byte range of the sender's file.
+ *
+ * The weak checksum of the window is kept as its two 16-bit sums: moving the window one byte
+ * takes the byte leaving it out of the first sum and block_size times that byte out of the
+ * second, then adds the byte entering it to the first and the new first sum to the second.
+ *
+ * @param index The signatures of the copy.
+ * @param data The bytes of the range.
+ * @param len Length of the range.
+ * @param offset Offset of the range in the file.
+ * @param matches Set to the matches, to be freed by the caller.
+ * @param count Set to the number of matches.
+ * @return 0 on success, -1 if memory runs out.
+ */
+
+int delta_find_matches(const delta_index_t* index, const uint8_t* data, uint64_t len, uint64_t offset,
+                       delta_match_t** matches, size_t* count){
+    size_t block_size = index->block_size;
+    size_t capacity = 16;
+    size_t found = 0;
+    delta_match_t* list = (delta_match_t*) malloc(capacity * sizeof(delta_match_t));
+    if (list == NULL){
+        return -1;
+    }
+
+    uint64_t pos = 0;
+    bool summed = false;
+    uint32_t a = 0;
+    uint32_t b = 0;
+    while (index->count > 0 && pos + block_size <= len){
+        if (!summed){
+            uint32_t weak = delta_weak_sum(data + pos, block_size);
+            a = weak & 0xffff;
+            b = weak >> 16;
+            summed = true;
+        }
+        int64_t block = delta_lookup(index, data + pos, (a & 0xffff) | (b << 16));
+        if (block >= 0){
+            if (found == capacity){
+                delta_match_t* grown = (delta_match_t*) realloc(list, capacity * 2 * sizeof(delta_match_t));
+                if (grown == NULL){
+                    free(list);
+                    return -1;
+                }
+                list = grown;
+                capacity *= 2;
+            }
+            list[found].offset = offset + pos;
+            list[found].block = block;
+            found++;
+            pos += block_size;
+            summed = false;
+        } else if (pos + block_size < len){
+            uint8_t out = data[pos];
+            uint8_t in = data[pos + block_size];
+            a = a - out + in;
+            b = b - block_size * out + a;
+            pos++;
+        } else {
+            break;
+        }
+    }
+    *matches = list;
+    *count = found;
+    return 0;
+}
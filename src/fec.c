@@ -0,0 +1,358 @@
+/**
+ * @file fec.c
+ * @brief Forward error correction: parity packets that let the receiver rebuild lost data
+ * packets without waiting for a retransmission.
+ * @author Connor Johst - cjohst & Aaditya Suri - AadityaSuri
+ * @bug No known bugs
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fec.h"
+#include "gf256.h"
+
+/**
+ * @brief Returns the distance between two rebuilt packets, rounded up so every header stays aligned.
+ *
+ * @param payload_size Bytes of data per packet.
+ * @return The distance in bytes.
+ */
+
+static size_t fec_packet_stride(size_t payload_size){
+    return (PACKET_SIZE(payload_size) + sizeof(uint64_t) - 1) & ~(sizeof(uint64_t) - 1);
+}
+
+/**
+ * @brief Builds the coefficients of a code.
+ *
+ * @param code The code.
+ * @param data Data packets per group.
+ * @param parity Parity packets per group, at most FEC_MAX_PARITY; data + parity is at most FEC_MAX_SYMBOLS.
+ * @return 0 on success, -1 if the shape is invalid or memory runs out.
+ */
+
+int fec_code_init(fec_code_t* code, unsigned data, unsigned parity){
+    memset(code, 0, sizeof(*code));
+    if (data == 0 || parity == 0 || parity > FEC_MAX_PARITY || data + parity > FEC_MAX_SYMBOLS){
+        return -1;
+    }
+    code->coefficients = (uint8_t*) malloc((size_t) parity * data);
+    if (code->coefficients == NULL){
+        return -1;
+    }
+    code->data = data;
+    code->parity = parity;
+
+    // Cauchy matrix 1 / (x_j + y_i) with x_j = j and y_i = parity + i, all distinct, so every square
+    // submatrix is invertible. Dividing column i by its first row keeps that property and turns the
+    // first parity packet into a plain XOR.
+    for (unsigned j = 0; j < parity; j++){
+        for (unsigned i = 0; i < data; i++){
+            uint8_t y = parity + i;
+            code->coefficients[j * data + i] = gf256_mul(gf256_inv(j ^ y), y);
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Releases the coefficients of a code.
+ *
+ * @param code The code.
+ */
+
+void fec_code_free(fec_code_t* code){
+    free(code->coefficients);
+    code->coefficients = NULL;
+}
+
+/**
+ * @brief Adds a data packet into the parity packets of its group.
+ *
+ * @param code The code.
+ * @param index Position of the data packet in its group.
+ * @param data The payload of the data packet.
+ * @param len Length of the payload.
+ * @param parity Payload of the first parity packet, zeroed before the first data packet is added.
+ * @param stride Distance between the payloads of two parity packets.
+ */
+
+void fec_encode(const fec_code_t* code, unsigned index, const void* data, size_t len, unsigned char* parity, size_t stride){
+    for (unsigned j = 0; j < code->parity; j++){
+        gf256_mul_add(parity + j * stride, (const uint8_t*) data, code->coefficients[j * code->data + index], len);
+    }
+}
+
+/**
+ * @brief Initializes the decoder of a connection.
+ *
+ * @param decoder The decoder.
+ * @param data Data packets per group.
+ * @param parity Parity packets per group.
+ * @param payload_size Bytes of data per packet.
+ * @param window Most packets the sender has outstanding, which bounds the groups in flight.
+ * @param total_bytes Bytes of the connection, or UINT64_MAX if every packet is payload_size bytes long.
+ * @return 0 on success, -1 if the shape is invalid or memory runs out.
+ */
+
+int fec_decoder_init(fec_decoder_t* decoder, unsigned data, unsigned parity, size_t payload_size,
+                     uint32_t window, uint64_t total_bytes){
+    memset(decoder, 0, sizeof(*decoder));
+    if (payload_size == 0 || fec_code_init(&decoder->code, data, parity) < 0){
+        return -1;
+    }
+    decoder->payload_size = payload_size;
+    decoder->total_bytes = total_bytes;
+    // the groups of the sender's window, plus the one it is filling and one waiting for parity
+    decoder->num_groups = window / data + 2;
+    decoder->groups = (fec_group_t*) calloc(decoder->num_groups, sizeof(fec_group_t));
+    decoder->recovered = (unsigned char*) malloc(parity * fec_packet_stride(payload_size));
+    if (decoder->groups == NULL || decoder->recovered == NULL){
+        fec_decoder_free(decoder);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Releases the memory of a decoder. A zeroed decoder may be freed too.
+ *
+ * @param decoder The decoder.
+ */
+
+void fec_decoder_free(fec_decoder_t* decoder){
+    if (decoder->groups != NULL){
+        for (unsigned g = 0; g < decoder->num_groups; g++){
+            free(decoder->groups[g].have);
+            free(decoder->groups[g].sums);
+        }
+    }
+    free(decoder->groups);
+    free(decoder->recovered);
+    fec_code_free(&decoder->code);
+    memset(decoder, 0, sizeof(*decoder));
+}
+
+/**
+ * @brief Returns the slot of a group, claiming it if an older group holds it.
+ *
+ * @param decoder The decoder.
+ * @param group The group number.
+ * @return The slot, or NULL if the group is finished, older than the one in its slot, or memory ran out.
+ */
+
+static fec_group_t* fec_decoder_group(fec_decoder_t* decoder, uint32_t group){
+    fec_group_t* slot = &decoder->groups[group % decoder->num_groups];
+    if (slot->active && slot->group == group){
+        return slot->done ? NULL : slot;
+    }
+    if (slot->active && slot->group > group){
+        return NULL;
+    }
+    // a group left unfinished in the slot is recovered by retransmissions instead
+    if (slot->sums == NULL){
+        slot->have = (uint8_t*) malloc(decoder->code.data + decoder->code.parity);
+        slot->sums = (unsigned char*) malloc(decoder->code.parity * decoder->payload_size);
+        if (slot->have == NULL || slot->sums == NULL){
+            free(slot->have);
+            free(slot->sums);
+            slot->have = NULL;
+            slot->sums = NULL;
+            return NULL;
+        }
+    }
+    memset(slot->have, 0, decoder->code.data + decoder->code.parity);
+    memset(slot->sums, 0, decoder->code.parity * decoder->payload_size);
+    slot->active = true;
+    slot->done = false;
+    slot->group = group;
+    slot->data_received = 0;
+    slot->parity_received = 0;
+    slot->size = 0;
+    return slot;
+}
+
+/**
+ * @brief Adds the first copy of a data packet to its group.
+ *
+ * @param decoder The decoder.
+ * @param seq Sequence number of the packet.
+ * @param data Its payload.
+ * @param len Length of the payload.
+ */
+
+void fec_decoder_add_data(fec_decoder_t* decoder, uint32_t seq, const void* data, size_t len){
+    fec_group_t* group = fec_decoder_group(decoder, seq / decoder->code.data);
+    unsigned index = seq % decoder->code.data;
+    if (group == NULL || group->have[index] || len > decoder->payload_size){
+        return;
+    }
+    group->have[index] = 1;
+    group->data_received++;
+    fec_encode(&decoder->code, index, data, len, group->sums, decoder->payload_size);
+}
+
+/**
+ * @brief Adds a parity packet to its group.
+ *
+ * @param decoder The decoder.
+ * @param first_seq Sequence number of the first data packet of the group.
+ * @param index Position of the parity packet in its group.
+ * @param size Number of data packets of the group.
+ * @param data Its payload.
+ * @param len Length of the payload.
+ */
+
+void fec_decoder_add_parity(fec_decoder_t* decoder, uint32_t first_seq, unsigned index, unsigned size,
+                            const void* data, size_t len){
+    if (index >= decoder->code.parity || size == 0 || size > decoder->code.data || first_seq % decoder->code.data != 0
+        || len > decoder->payload_size){
+        return;
+    }
+    fec_group_t* group = fec_decoder_group(decoder, first_seq / decoder->code.data);
+    if (group == NULL || group->have[decoder->code.data + index] || (group->size != 0 && group->size != size)){
+        return;
+    }
+    group->size = size;
+    group->have[decoder->code.data + index] = 1;
+    group->parity_received++;
+    gf256_mul_add(group->sums + index * decoder->payload_size, (const uint8_t*) data, 1, len);
+}
+
+/**
+ * @brief Inverts a square matrix by Gauss-Jordan elimination.
+ *
+ * @param matrix The matrix, row by row; destroyed.
+ * @param inverse Set to the inverse.
+ * @param n Number of rows and columns.
+ * @return 0 on success, -1 if the matrix is singular.
+ */
+
+static int fec_invert(uint8_t* matrix, uint8_t* inverse, unsigned n){
+    memset(inverse, 0, n * n);
+    for (unsigned i = 0; i < n; i++){
+        inverse[i * n + i] = 1;
+    }
+    for (unsigned col = 0; col < n; col++){
+        unsigned pivot = col;
+        while (pivot < n && matrix[pivot * n + col] == 0){
+            pivot++;
+        }
+        if (pivot == n){
+            return -1;
+        }
+        for (unsigned k = 0; pivot != col && k < n; k++){
+            uint8_t t = matrix[pivot * n + k];
+            matrix[pivot * n + k] = matrix[col * n + k];
+            matrix[col * n + k] = t;
+            t = inverse[pivot * n + k];
+            inverse[pivot * n + k] = inverse[col * n + k];
+            inverse[col * n + k] = t;
+        }
+        uint8_t scale = gf256_inv(matrix[col * n + col]);
+        for (unsigned k = 0; k < n; k++){
+            matrix[col * n + k] = gf256_mul(matrix[col * n + k], scale);
+            inverse[col * n + k] = gf256_mul(inverse[col * n + k], scale);
+        }
+        for (unsigned row = 0; row < n; row++){
+            uint8_t factor = matrix[row * n + col];
+            if (row == col || factor == 0){
+                continue;
+            }
+            for (unsigned k = 0; k < n; k++){
+                matrix[row * n + k] ^= gf256_mul(factor, matrix[col * n + k]);
+                inverse[row * n + k] ^= gf256_mul(factor, inverse[col * n + k]);
+            }
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Rebuilds the missing data packets of a group once enough of its packets arrived.
+ *
+ * @param decoder The decoder.
+ * @param seq Sequence number of any data packet of the group.
+ * @return Number of packets rebuilt, available through fec_decoder_packet() until the next call.
+ */
+
+unsigned fec_decoder_recover(fec_decoder_t* decoder, uint32_t seq){
+    const fec_code_t* code = &decoder->code;
+    uint32_t number = seq / code->data;
+    fec_group_t* group = &decoder->groups[number % decoder->num_groups];
+    if (!group->active || group->done || group->group != number){
+        return 0;
+    }
+    uint32_t first = number * code->data;
+    unsigned size = group->size;
+    if (size == 0){
+        return 0;
+    }
+    unsigned missing_count = size > group->data_received ? size - group->data_received : 0;
+    if (missing_count == 0){
+        group->done = true;
+        return 0;
+    }
+    if (missing_count > group->parity_received){
+        return 0;
+    }
+
+    // every sum holds the coefficients of its parity row times the missing packets
+    unsigned missing[FEC_MAX_PARITY];
+    unsigned rows[FEC_MAX_PARITY];
+    unsigned m = 0;
+    for (unsigned i = 0; i < size && m < missing_count; i++){
+        if (!group->have[i]){
+            missing[m++] = i;
+        }
+    }
+    unsigned r = 0;
+    for (unsigned j = 0; j < code->parity && r < missing_count; j++){
+        if (group->have[code->data + j]){
+            rows[r++] = j;
+        }
+    }
+
+    uint8_t matrix[FEC_MAX_PARITY * FEC_MAX_PARITY];
+    uint8_t inverse[FEC_MAX_PARITY * FEC_MAX_PARITY];
+    for (unsigned a = 0; a < m; a++){
+        for (unsigned b = 0; b < m; b++){
+            matrix[a * m + b] = code->coefficients[rows[a] * code->data + missing[b]];
+        }
+    }
+    if (fec_invert(matrix, inverse, m) < 0){
+        return 0;
+    }
+
+    for (unsigned k = 0; k < m; k++){
+        packet_t* packet = fec_decoder_packet(decoder, k);
+        uint64_t offset = (uint64_t) (first + missing[k]) * decoder->payload_size;
+        uint64_t left = decoder->total_bytes > offset ? decoder->total_bytes - offset : 0;
+        packet->header = create_header(0, first + missing[k], 0,
+                                       left < decoder->payload_size ? left : decoder->payload_size, 0);
+        memset(packet->data, 0, decoder->payload_size);
+        for (unsigned a = 0; a < m; a++){
+            gf256_mul_add(packet->data, group->sums + rows[a] * decoder->payload_size, inverse[k * m + a],
+                          decoder->payload_size);
+        }
+    }
+    group->done = true;
+    return m;
+}
+
+/**
+ * @brief Returns a packet rebuilt by the last fec_decoder_recover(), with its sequence number and
+ * length set in its header.
+ *
+ * @param decoder The decoder.
+ * @param index Which packet, below the count fec_decoder_recover() returned.
+ * @return The packet.
+ */
+
+packet_t* fec_decoder_packet(fec_decoder_t* decoder, unsigned index){
+    return (packet_t*) (decoder->recovered + index * fec_packet_stride(decoder->payload_size));
+}
@@ -0,0 +1,110 @@
+/**
+ * @file filesource.c
+ * @brief Random access to the file being sent, through an mmap() of it when possible and pread()
+ * otherwise.
+ * @author Connor Johst - cjohst & Aaditya Suri - AadityaSuri
+ * @bug No known bugs
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "filesource.h"
+
+/**
+ * @brief Opens a file for reading and maps it into memory if it can be mapped.
+ *
+ * Empty files, pipes and file systems without mmap() support are read with pread() instead.
+ *
+ * @param source The source to initialize.
+ * @param filename The file to open.
+ * @return 0 on success, -1 if the file cannot be opened or its size cannot be read.
+ */
+
+int file_source_open(file_source_t* source, const char* filename){
+    struct stat file_stat;
+
+    source->map = NULL;
+    source->fd = open(filename, O_RDONLY);
+    if (source->fd < 0){
+        return -1;
+    }
+    if (fstat(source->fd, &file_stat) < 0){
+        close(source->fd);
+        return -1;
+    }
+    source->size = file_stat.st_size;
+    source->version = (uint64_t) file_stat.st_mtim.tv_sec * 1000000000ULL + file_stat.st_mtim.tv_nsec;
+
+    if (source->size > 0){
+        void* map = mmap(NULL, source->size, PROT_READ, MAP_SHARED, source->fd, 0);
+        if (map != MAP_FAILED){
+            // packets are mostly read in order, so let the kernel read ahead aggressively
+            madvise(map, source->size, MADV_SEQUENTIAL);
+            source->map = (const unsigned char*) map;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Copies len bytes of the file starting at offset into buffer.
+ *
+ * @param source The source.
+ * @param offset Offset of the first byte in the file.
+ * @param buffer Where to copy the bytes.
+ * @param len Number of bytes to copy; offset + len must not exceed the file size.
+ * @return The number of bytes copied, or -1 on a read error.
+ */
+
+ssize_t file_source_read(const file_source_t* source, uint64_t offset, unsigned char* buffer, size_t len){
+    if (source->map != NULL){
+        memcpy(buffer, source->map + offset, len);
+        return len;
+    }
+
+    size_t copied = 0;
+    while (copied < len){
+        ssize_t n = pread(source->fd, buffer + copied, len - copied, offset + copied);
+        if (n < 0 && errno == EINTR){
+            continue;
+        }
+        if (n <= 0){
+            return -1;
+        }
+        copied += n;
+    }
+    return copied;
+}
+
+/**
+ * @brief Returns the mapped bytes of the file starting at offset, to send them without a copy.
+ *
+ * @param source The source.
+ * @param offset Offset of the first byte in the file.
+ * @return The bytes, valid until the source is closed, or NULL if the file is read with pread().
+ */
+
+const unsigned char* file_source_slice(const file_source_t* source, uint64_t offset){
+    return source->map != NULL ? source->map + offset : NULL;
+}
+
+/**
+ * @brief Unmaps and closes the file.
+ *
+ * @param source The source.
+ */
+
+void file_source_close(file_source_t* source){
+    if (source->map != NULL){
+        munmap((void*) source->map, source->size);
+        source->map = NULL;
+    }
+    close(source->fd);
+}
@@ -0,0 +1,222 @@
+/**
+ * @file gf256.c
+ * @brief Arithmetic in GF(2^8), the field the forward error correction code works in.
+ * @author Connor Johst - cjohst & Aaditya Suri - AadityaSuri
+ * @bug No known bugs
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <pthread.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include "gf256.h"
+
+#define GF256_POLY 0x11d // x^8 + x^4 + x^3 + x^2 + 1, with x a generator of the field
+
+typedef void (*gf256_mul_add_fn)(uint8_t* dst, const uint8_t* src, uint8_t c, size_t len);
+
+static pthread_once_t gf256_once = PTHREAD_ONCE_INIT;
+static uint8_t gf256_exp[510]; // x^i, twice over so sums of two logarithms need no reduction
+static uint8_t gf256_log[256]; // i such that x^i = a, for a != 0
+static uint8_t gf256_products[256][256]; // c * a
+static uint8_t gf256_low[256][16]; // c * a for the nibbles a of the low half of a byte
+static uint8_t gf256_high[256][16]; // c * (a << 4) for the nibbles a of the high half of a byte
+static gf256_mul_add_fn gf256_mul_add_impl;
+static const char* gf256_impl_name;
+
+#if defined(__x86_64__)
+
+/**
+ * @brief Adds c times src to dst with the SSSE3 byte shuffle, 16 bytes at a time.
+ *
+ * @param dst The buffer added to.
+ * @param src The buffer multiplied.
+ * @param c The factor.
+ * @param len Number of bytes.
+ */
+
+__attribute__((target("ssse3")))
+static void gf256_mul_add_ssse3(uint8_t* dst, const uint8_t* src, uint8_t c, size_t len){
+    const __m128i low = _mm_loadu_si128((const __m128i*) gf256_low[c]);
+    const __m128i high = _mm_loadu_si128((const __m128i*) gf256_high[c]);
+    const __m128i mask = _mm_set1_epi8(0x0f);
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16){
+        __m128i bytes = _mm_loadu_si128((const __m128i*) (src + i));
+        __m128i product = _mm_xor_si128(_mm_shuffle_epi8(low, _mm_and_si128(bytes, mask)),
+                                        _mm_shuffle_epi8(high, _mm_and_si128(_mm_srli_epi64(bytes, 4), mask)));
+        _mm_storeu_si128((__m128i*) (dst + i), _mm_xor_si128(_mm_loadu_si128((const __m128i*) (dst + i)), product));
+    }
+    for (; i < len; i++){
+        dst[i] ^= gf256_products[c][src[i]];
+    }
+}
+
+/**
+ * @brief Adds c times src to dst with the AVX2 byte shuffle, 32 bytes at a time.
+ *
+ * @param dst The buffer added to.
+ * @param src The buffer multiplied.
+ * @param c The factor.
+ * @param len Number of bytes.
+ */
+
+__attribute__((target("avx2")))
+static void gf256_mul_add_avx2(uint8_t* dst, const uint8_t* src, uint8_t c, size_t len){
+    const __m256i low = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*) gf256_low[c]));
+    const __m256i high = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*) gf256_high[c]));
+    const __m256i mask = _mm256_set1_epi8(0x0f);
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32){
+        __m256i bytes = _mm256_loadu_si256((const __m256i*) (src + i));
+        __m256i product = _mm256_xor_si256(_mm256_shuffle_epi8(low, _mm256_and_si256(bytes, mask)),
+                                           _mm256_shuffle_epi8(high, _mm256_and_si256(_mm256_srli_epi64(bytes, 4), mask)));
+        _mm256_storeu_si256((__m256i*) (dst + i), _mm256_xor_si256(_mm256_loadu_si256((const __m256i*) (dst + i)), product));
+    }
+    for (; i < len; i++){
+        dst[i] ^= gf256_products[c][src[i]];
+    }
+}
+
+#endif
+
+/**
+ * @brief Adds c times src to dst, byte by byte, with the product table.
+ *
+ * @param dst The buffer added to.
+ * @param src The buffer multiplied.
+ * @param c The factor.
+ * @param len Number of bytes.
+ */
+
+static void gf256_mul_add_table(uint8_t* dst, const uint8_t* src, uint8_t c, size_t len){
+    const uint8_t* products = gf256_products[c];
+    for (size_t i = 0; i < len; i++){
+        dst[i] ^= products[src[i]];
+    }
+}
+
+/**
+ * @brief Builds the tables and picks the implementation, once per process.
+ */
+
+static void gf256_init(void){
+    unsigned a = 1;
+    for (int i = 0; i < 255; i++){
+        gf256_exp[i] = gf256_exp[i + 255] = a;
+        gf256_log[a] = i;
+        a <<= 1;
+        if (a & 0x100){
+            a ^= GF256_POLY;
+        }
+    }
+    for (unsigned c = 0; c < 256; c++){
+        for (unsigned b = 0; b < 256; b++){
+            gf256_products[c][b] = c && b ? gf256_exp[gf256_log[c] + gf256_log[b]] : 0;
+        }
+        for (unsigned n = 0; n < 16; n++){
+            gf256_low[c][n] = gf256_products[c][n];
+            gf256_high[c][n] = gf256_products[c][n << 4];
+        }
+    }
+
+    gf256_mul_add_impl = gf256_mul_add_table;
+    gf256_impl_name = "table";
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")){
+        gf256_mul_add_impl = gf256_mul_add_avx2;
+        gf256_impl_name = "avx2";
+    } else if (__builtin_cpu_supports("ssse3")){
+        gf256_mul_add_impl = gf256_mul_add_ssse3;
+        gf256_impl_name = "ssse3";
+    }
+#endif
+}
+
+/**
+ * @brief Multiplies two elements.
+ *
+ * @param a First element.
+ * @param b Second element.
+ * @return a * b.
+ */
+
+uint8_t gf256_mul(uint8_t a, uint8_t b){
+    pthread_once(&gf256_once, gf256_init);
+    return gf256_products[a][b];
+}
+
+/**
+ * @brief Inverts a non-zero element.
+ *
+ * @param a The element, not 0.
+ * @return 1 / a.
+ */
+
+uint8_t gf256_inv(uint8_t a){
+    pthread_once(&gf256_once, gf256_init);
+    return gf256_exp[255 - gf256_log[a]];
+}
+
+/**
+ * @brief Adds c times src to dst, byte by byte: dst[i] ^= c * src[i].
+ *
+ * @param dst The buffer added to.
+ * @param src The buffer multiplied.
+ * @param c The factor.
+ * @param len Number of bytes.
+ */
+
+void gf256_mul_add(uint8_t* dst, const uint8_t* src, uint8_t c, size_t len){
+    pthread_once(&gf256_once, gf256_init);
+    if (c == 0){
+        return;
+    }
+    if (c == 1){
+        // plain XOR parity, a word at a time
+        size_t i = 0;
+        for (; i + sizeof(uint64_t) <= len; i += sizeof(uint64_t)){
+            uint64_t a, b;
+            memcpy(&a, dst + i, sizeof(a));
+            memcpy(&b, src + i, sizeof(b));
+            a ^= b;
+            memcpy(dst + i, &a, sizeof(a));
+        }
+        for (; i < len; i++){
+            dst[i] ^= src[i];
+        }
+        return;
+    }
+    gf256_mul_add_impl(dst, src, c, len);
+}
+
+/**
+ * @brief Same as gf256_mul_add(), always with the product table.
+ *
+ * @param dst The buffer added to.
+ * @param src The buffer multiplied.
+ * @param c The factor.
+ * @param len Number of bytes.
+ */
+
+void gf256_mul_add_sw(uint8_t* dst, const uint8_t* src, uint8_t c, size_t len){
+    pthread_once(&gf256_once, gf256_init);
+    gf256_mul_add_table(dst, src, c, len);
+}
+
+/**
+ * @brief Names the implementation gf256_mul_add() uses on this CPU.
+ *
+ * @return "avx2", "ssse3" or "table".
+ */
+
+const char* gf256_impl(void){
+    pthread_once(&gf256_once, gf256_init);
+    return gf256_impl_name;
+}
@@ -0,0 +1,77 @@
+/**
+ * @file ackpolicy.h
+ * @brief Receiver ACK policy: delayed, coalesced ACKs with immediate ACKs on reordering.
+ * @author Connor Johst - cjohst & Aaditya Suri - AadityaSuri
+ * @bug No known bugs
+ *
+ * In-order packets are acknowledged every ack_every packets, or once max_delay has passed since
+ * the first unacknowledged one. Packets that arrive out of order, fill a gap or are duplicates are
+ * acknowledged immediately so the sender's loss detection is not delayed.
+ */
+
+#ifndef ACKPOLICY_H
+#define ACKPOLICY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define ACK_POLICY_NO_DEADLINE UINT64_MAX /**< Returned by ack_policy_deadline() when no ACK is pending. */
+
+/**
+ * @struct ack_policy
+ * @brief State of the delayed ACK policy.
+ */
+typedef struct ack_policy {
+    unsigned int ack_every; /**< Number of in-order packets acknowledged by one ACK. */
+    uint64_t max_delay;     /**< Longest an ACK may be held back, in microseconds. */
+    unsigned int pending;   /**< Packets received since the last ACK was sent. */
+    uint64_t deadline;      /**< Time at which the pending ACK must be sent. */
+    uint32_t last_seq;      /**< Sequence number of the most recent packet, echoed in the ACK. */
+    uint64_t last_time;     /**< Arrival time of that packet, in microseconds. */
+} ack_policy_t;
+
+/**
+ * @brief Initializes an ACK policy.
+ *
+ * @param policy The policy to initialize.
+ * @param ack_every Number of in-order packets acknowledged by one ACK (1 acknowledges every packet).
+ * @param max_delay Longest an ACK may be held back, in microseconds.
+ */
+void ack_policy_init(ack_policy_t* policy, unsigned int ack_every, uint64_t max_delay);
+
+/**
+ * @brief Records a received data packet and decides whether to acknowledge it right away.
+ *
+ * @param policy The policy.
+ * @param seq The sequence number of the packet.
+ * @param immediate Whether the packet was out of order, filled a gap or was a duplicate.
+ * @param now The current time in microseconds.
+ * @return true if an ACK should be sent now.
+ */
+bool ack_policy_on_packet(ack_policy_t* policy, uint32_t seq, bool immediate, uint64_t now);
+
+/**
+ * @brief Checks whether the delay timer of a pending ACK has expired.
+ *
+ * @param policy The policy.
+ * @param now The current time in microseconds.
+ * @return true if an ACK should be sent now.
+ */
+bool ack_policy_due(const ack_policy_t* policy, uint64_t now);
+
+/**
+ * @brief Returns when the pending ACK must be sent.
+ *
+ * @param policy The policy.
+ * @return The deadline in microseconds, or ACK_POLICY_NO_DEADLINE if no ACK is pending.
+ */
+uint64_t ack_policy_deadline(const ack_policy_t* policy);
+
+/**
+ * @brief Records that an ACK covering every packet received so far has been sent.
+ *
+ * @param policy The policy.
+ */
+void ack_policy_sent(ack_policy_t* policy);
+
+#endif
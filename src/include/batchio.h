@@ -0,0 +1,247 @@
+/**
+ * @file batchio.h
+ * @brief Batched datagram I/O: fills and drains up to BATCH_MAX datagrams per syscall with
+ * sendmmsg() and recvmmsg().
+ * @author Connor Johst - cjohst & Aaditya Suri - AadityaSuri
+ * @bug No known bugs
+ */
+
+#ifndef BATCHIO_H
+#define BATCHIO_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+
+#define BATCH_MAX 64 /**< Maximum number of datagrams moved by one syscall. */
+#define BATCH_MAX_IOV 2 /**< Maximum number of iovecs gathered into one datagram. */
+#define BATCH_GSO_MAX_SEGS 64 /**< Maximum number of datagrams coalesced into one UDP GSO send. */
+#define BATCH_GSO_MAX_BYTES 65000 /**< Maximum size of one UDP GSO send. */
+#define BATCH_GRO_BUFFER_SZ 65536 /**< Size of each receive buffer when UDP GRO is enabled. */
+#define BATCH_FULL_WAIT_MS 1 /**< Longest wait for a full socket buffer or device queue to drain before a send is retried. */
+#define BATCH_ZEROCOPY_MIN 16384 /**< Smallest send worth MSG_ZEROCOPY; page pinning costs more than copying below it. */
+
+/**
+ * @struct batch_io
+ * @brief A batch of datagrams waiting to be sent, or just received.
+ *
+ * Each slot owns a buffer of buf_size bytes. Datagrams to send can either be built in a slot's own
+ * buffer (batch_buffer() then batch_commit()) or gathered from caller memory that stays valid
+ * until the batch is flushed (batch_queue() and batch_queue_iov()).
+ *
+ * With UDP GSO enabled (batch_enable_gso()), runs of consecutive datagrams of exactly gso_size
+ * bytes (the last of a run may be shorter) are handed to the kernel as one large send that it
+ * splits into segments. With UDP GRO enabled (batch_enable_gro()), one received buffer may hold
+ * several datagrams of batch_segment_size() bytes each, coalesced by the kernel.
+ *
+ * With MSG_ZEROCOPY enabled (batch_enable_zerocopy()), sends of at least BATCH_ZEROCOPY_MIN bytes
+ * are transmitted from the caller's pages. The kernel numbers such sends and reports on the
+ * socket's error queue when it is done with them; until then the memory they were gathered from
+ * must not change. batch_zerocopy_mark() and batch_zerocopy_released() tell when it may. Sends
+ * spanning more pages than the kernel pins at once are copied instead.
+ */
+typedef struct batch_io {
+    struct mmsghdr msgs[BATCH_MAX];               /**< Message headers handed to the kernel. */
+    struct iovec iovs[BATCH_MAX][BATCH_MAX_IOV];  /**< Scatter/gather lists of each message. */
+    struct sockaddr_in addrs[BATCH_MAX];          /**< Destination or source address of each message. */
+    unsigned char* buffers;                       /**< BATCH_MAX buffers of buf_size bytes. */
+    size_t buf_size;                              /**< Size of each slot's buffer. */
+    unsigned int count;                           /**< Number of datagrams queued or received. */
+
+    size_t gso_size;                              /**< UDP GSO segment size, 0 when GSO is off. */
+    bool gro;                                     /**< Whether received buffers may be GRO-coalesced. */
+    char control[BATCH_MAX][CMSG_SPACE(sizeof(int))]; /**< Ancillary data (GSO / GRO segment size). */
+    struct mmsghdr gso_msgs[BATCH_MAX];           /**< Coalesced messages built by a GSO flush. */
+    struct iovec gso_iovs[BATCH_MAX * BATCH_MAX_IOV]; /**< Flattened iovecs of the coalesced messages. */
+
+    bool zerocopy;                                /**< Whether large sends use MSG_ZEROCOPY. */
+    uint32_t zc_issued;                           /**< Number of MSG_ZEROCOPY sends, the next send's ID. */
+    uint32_t zc_done;                             /**< Every MSG_ZEROCOPY send below this ID is complete. */
+    uint32_t zc_completed;                        /**< Number of MSG_ZEROCOPY sends reported complete. */
+    size_t zc_limit;                              /**< Sends this large or larger were refused and are copied. */
+} batch_io_t;
+
+/**
+ * @brief Allocates the buffers of a batch.
+ *
+ * @param batch The batch to initialize.
+ * @param buf_size Size of each slot's buffer, the largest datagram it can receive or build.
+ * @return 0 on success, -1 if the buffers could not be allocated.
+ */
+int batch_init(batch_io_t* batch, size_t buf_size);
+
+/**
+ * @brief Frees the buffers of a batch.
+ *
+ * @param batch The batch.
+ */
+void batch_free(batch_io_t* batch);
+
+/**
+ * @brief Turns on UDP generic segmentation offload for sends through this batch.
+ *
+ * @param batch The batch.
+ * @param sock_fd The socket the batch sends on.
+ * @param segment_size Size of a full datagram; shorter datagrams end a coalesced run.
+ * @return 0 if GSO is enabled, -1 if the kernel does not support it (the batch is unchanged).
+ */
+int batch_enable_gso(batch_io_t* batch, int sock_fd, size_t segment_size);
+
+/**
+ * @brief Turns on UDP generic receive offload for receives through this batch, growing its
+ * buffers to BATCH_GRO_BUFFER_SZ.
+ *
+ * @param batch The batch.
+ * @param sock_fd The socket the batch receives from.
+ * @return 0 if GRO is enabled, -1 if the kernel does not support it or the buffers could not be
+ * grown (the batch is unchanged).
+ */
+int batch_enable_gro(batch_io_t* batch, int sock_fd);
+
+/**
+ * @brief Turns on MSG_ZEROCOPY for sends of at least BATCH_ZEROCOPY_MIN bytes through this batch.
+ *
+ * @param batch The batch.
+ * @param sock_fd The socket the batch sends on.
+ * @return 0 if zerocopy is enabled, -1 if the kernel does not support it (the batch is unchanged).
+ */
+int batch_enable_zerocopy(batch_io_t* batch, int sock_fd);
+
+/**
+ * @brief Reads the completions of MSG_ZEROCOPY sends off the socket's error queue, without blocking.
+ *
+ * @param batch The batch.
+ * @param sock_fd The socket the batch sends on.
+ * @return The number of completion reports read, or -1 on error.
+ */
+int batch_reap_zerocopy(batch_io_t* batch, int sock_fd);
+
+/**
+ * @brief Returns a mark covering every send a datagram queued now can go out with.
+ *
+ * @param batch The batch.
+ * @return The mark, to be passed to batch_zerocopy_released().
+ */
+uint32_t batch_zerocopy_mark(const batch_io_t* batch);
+
+/**
+ * @brief Checks whether the kernel is done with every send covered by a mark, so the memory the
+ * datagrams queued before the mark was taken were gathered from may change.
+ *
+ * @param batch The batch.
+ * @param mark A mark returned by batch_zerocopy_mark().
+ * @return true if the memory may change; always true when zerocopy is off.
+ */
+bool batch_zerocopy_released(const batch_io_t* batch, uint32_t mark);
+
+/**
+ * @brief Returns the buffer of the next free slot, to build a datagram in place.
+ *
+ * @param batch The batch. Must not be full.
+ * @return The slot's buffer of buf_size bytes.
+ */
+void* batch_buffer(batch_io_t* batch);
+
+/**
+ * @brief Queues the datagram built in the buffer returned by batch_buffer().
+ *
+ * @param batch The batch.
+ * @param len Length of the datagram.
+ * @param addr Destination address.
+ */
+void batch_commit(batch_io_t* batch, size_t len, const struct sockaddr_in* addr);
+
+/**
+ * @brief Queues a datagram gathered from caller memory, without copying it.
+ *
+ * @param batch The batch. Must not be full.
+ * @param iov The pieces of the datagram, which must stay valid until the batch is flushed.
+ * @param iovcnt Number of pieces, at most BATCH_MAX_IOV.
+ * @param addr Destination address.
+ */
+void batch_queue_iov(batch_io_t* batch, const struct iovec* iov, int iovcnt, const struct sockaddr_in* addr);
+
+/**
+ * @brief Queues a contiguous datagram from caller memory, without copying it.
+ *
+ * @param batch The batch. Must not be full.
+ * @param data The datagram, which must stay valid until the batch is flushed.
+ * @param len Length of the datagram.
+ * @param addr Destination address.
+ */
+void batch_queue(batch_io_t* batch, const void* data, size_t len, const struct sockaddr_in* addr);
+
+/**
+ * @brief Checks whether every slot of the batch is in use.
+ *
+ * @param batch The batch.
+ * @return Non-zero if no more datagrams can be queued before a flush.
+ */
+int batch_full(const batch_io_t* batch);
+
+/**
+ * @brief Sends every queued datagram with as few sendmmsg() calls as possible and empties the batch.
+ *
+ * When the kernel refuses datagrams with EAGAIN or ENOBUFS, the rest of the batch stays queued
+ * and is sent once the socket is writable again, so nothing queued is lost on the way out.
+ *
+ * @param batch The batch.
+ * @param sock_fd The socket to send on.
+ * @return The number of datagrams sent, or -1 on any other send error.
+ */
+int batch_flush(batch_io_t* batch, int sock_fd);
+
+/**
+ * @brief Receives as many waiting datagrams as fit in the batch with one recvmmsg() call,
+ * without blocking.
+ *
+ * @param batch The batch. Previously received datagrams are discarded.
+ * @param sock_fd The socket to receive from.
+ * @return The number of datagrams received (0 if none were waiting), or -1 on error.
+ */
+int batch_recv(batch_io_t* batch, int sock_fd);
+
+/**
+ * @brief Returns the data of a received datagram.
+ *
+ * @param batch The batch.
+ * @param i Index of the datagram, below the count returned by batch_recv().
+ * @return The datagram's data.
+ */
+void* batch_data(batch_io_t* batch, unsigned int i);
+
+/**
+ * @brief Returns the length of a received datagram.
+ *
+ * @param batch The batch.
+ * @param i Index of the datagram, below the count returned by batch_recv().
+ * @return The datagram's length in bytes.
+ */
+size_t batch_len(const batch_io_t* batch, unsigned int i);
+
+/**
+ * @brief Returns the source address of a received datagram.
+ *
+ * @param batch The batch.
+ * @param i Index of the datagram, below the count returned by batch_recv().
+ * @return The address the datagram came from.
+ */
+const struct sockaddr_in* batch_addr(const batch_io_t* batch, unsigned int i);
+
+/**
+ * @brief Returns the size of the datagrams coalesced into a received buffer.
+ *
+ * Every datagram in the buffer is this long except possibly the last one. Without GRO this is the
+ * length of the buffer.
+ *
+ * @param batch The batch.
+ * @param i Index of the buffer, below the count returned by batch_recv().
+ * @return The segment size in bytes.
+ */
+size_t batch_segment_size(const batch_io_t* batch, unsigned int i);
+
+#endif
@@ -0,0 +1,157 @@
+/**
+ * @file compress.h
+ * @brief Compression of the bytes a connection carries, in blocks of many packets.
+ * @author Connor Johst - cjohst & Aaditya Suri - AadityaSuri
+ * @bug No known bugs
+ *
+ * The sender cuts the bytes a connection carries into blocks of a fixed size and compresses each
+ * one on its own in the LZ4 block format, before the packets are cut. Every block goes out behind
+ * a compress_header_t; a block that would not shrink is stored as it is, and one whose sampled
+ * bytes look random (already compressed data, images...) is stored without trying. After
+ * COMPRESS_MISSES stored blocks in a row the compressor switches itself off for COMPRESS_BACKOFF
+ * blocks, then tries again. A header with no bytes ends the stream.
+ *
+ * The compressed blocks are sent back to back as one stream, cut into packets of payload_size
+ * bytes. With forward error correction the last packet is padded up to payload_size too, so the
+ * length of every packet rebuilt from parity packets is known (see fec.h). The receiver takes the
+ * stream in order and decompresses it block by block, writing the bytes of each block where they
+ * belong.
+ */
+
+#ifndef COMPRESS_H
+#define COMPRESS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define COMPRESS_BLOCK_SZ 131072  /**< Bytes per block proposed by the sender. */
+#define COMPRESS_MAX_BLOCK 1048576 /**< Largest block a receiver accepts. */
+#define COMPRESS_MAX_ENTROPY 7.5  /**< Bits per byte of a sample above which a block is stored. */
+#define COMPRESS_MISSES 4         /**< Blocks stored in a row that switch the compressor off. */
+#define COMPRESS_BACKOFF 64       /**< Blocks stored without trying once it is off. */
+#define COMPRESS_HASH_LOG 14      /**< log2 of the entries of the hash table of a compressor. */
+#define COMPRESS_TABLE_SZ (1 << COMPRESS_HASH_LOG) /**< Entries of the hash table of a compressor. */
+
+/**
+ * @struct compress_header
+ * @brief What precedes every block in the stream.
+ */
+typedef struct compress_header {
+    uint32_t raw_len;  /**< Bytes of the block, 0 at the end of the stream. */
+    uint32_t wire_len; /**< Bytes following the header; equal to raw_len if the block is stored. */
+} compress_header_t;
+
+/**
+ * @struct compressor
+ * @brief The sending side of a stream.
+ */
+typedef struct compressor {
+    uint32_t* table;  /**< Last position of every hash of four bytes in the block being compressed. */
+    unsigned misses;  /**< Blocks stored in a row. */
+    unsigned skip;    /**< Blocks still to be stored without trying. */
+    uint64_t raw_bytes;  /**< Bytes of the blocks packed so far. */
+    uint64_t wire_bytes; /**< Bytes of the stream they became, headers included. */
+} compressor_t;
+
+/**
+ * @struct decompressor
+ * @brief The receiving side of a stream.
+ */
+typedef struct decompressor {
+    uint32_t max_block;       /**< Largest block accepted. */
+    unsigned char* block;     /**< The block being received, header first. */
+    size_t have;              /**< Bytes of it received. */
+    unsigned char* raw;       /**< The last block decompressed. */
+    bool ended;               /**< Whether the header ending the stream arrived. */
+} decompressor_t;
+
+/**
+ * @brief Estimates the entropy of a block from up to 4 KB of its bytes spread over it.
+ *
+ * @param data The bytes.
+ * @param len Number of bytes.
+ * @return The Shannon entropy of the sampled bytes, in bits per byte.
+ */
+double compress_entropy(const unsigned char* data, size_t len);
+
+/**
+ * @brief Compresses bytes in the LZ4 block format.
+ *
+ * @param table COMPRESS_TABLE_SZ hash table entries, in any state.
+ * @param src The bytes.
+ * @param len Number of bytes, below 4 GB.
+ * @param dst Receives the compressed bytes.
+ * @param capacity Bytes available at dst.
+ * @return The number of compressed bytes, or 0 if they do not fit in capacity.
+ */
+size_t lz4_compress(uint32_t* table, const unsigned char* src, size_t len, unsigned char* dst, size_t capacity);
+
+/**
+ * @brief Decompresses bytes in the LZ4 block format, which may come from anyone.
+ *
+ * @param src The compressed bytes.
+ * @param len Number of compressed bytes.
+ * @param dst Receives the bytes.
+ * @param capacity Bytes available at dst.
+ * @return The number of bytes, or -1 if the input is invalid or does not fit in capacity.
+ */
+long lz4_decompress(const unsigned char* src, size_t len, unsigned char* dst, size_t capacity);
+
+/**
+ * @brief Initializes a compressor.
+ *
+ * @param compressor The compressor.
+ * @return 0 on success, -1 if memory runs out.
+ */
+int compressor_init(compressor_t* compressor);
+
+/**
+ * @brief Releases the memory of a compressor. A zeroed compressor may be freed too.
+ *
+ * @param compressor The compressor.
+ */
+void compressor_free(compressor_t* compressor);
+
+/**
+ * @brief Appends a block, or the end of the stream, to the stream.
+ *
+ * @param compressor The compressor.
+ * @param raw The bytes of the block.
+ * @param raw_len Number of bytes, 0 to end the stream.
+ * @param out Receives the header and the block, sizeof(compress_header_t) + raw_len bytes at most.
+ * @return The number of bytes written to out.
+ */
+size_t compressor_pack(compressor_t* compressor, const unsigned char* raw, uint32_t raw_len, unsigned char* out);
+
+/**
+ * @brief Initializes a decompressor.
+ *
+ * @param decompressor The decompressor.
+ * @param max_block Largest block accepted.
+ * @return 0 on success, -1 if memory runs out.
+ */
+int decompressor_init(decompressor_t* decompressor, uint32_t max_block);
+
+/**
+ * @brief Releases the memory of a decompressor. A zeroed decompressor may be freed too.
+ *
+ * @param decompressor The decompressor.
+ */
+void decompressor_free(decompressor_t* decompressor);
+
+/**
+ * @brief Takes bytes of the stream, in order, up to the end of the next block. Bytes after the
+ * end of the stream are taken and ignored.
+ *
+ * @param decompressor The decompressor.
+ * @param data The bytes.
+ * @param len Number of bytes.
+ * @param raw Set to the bytes of the block if it is complete, NULL otherwise; valid until the next call.
+ * @param raw_len Set to the number of bytes of the block.
+ * @return The number of bytes taken, or -1 if the stream is invalid.
+ */
+long decompressor_push(decompressor_t* decompressor, const unsigned char* data, size_t len,
+                       const unsigned char** raw, size_t* raw_len);
+
+#endif
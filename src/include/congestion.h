@@ -0,0 +1,101 @@
+/**
+ * @file congestion.h
+ * @brief Pluggable congestion control interface and the available controllers.
+ * @author Connor Johst - cjohst & Aaditya Suri - AadityaSuri
+ * @bug No known bugs
+ *
+ * A controller is a table of callbacks (congestion_ops_t) plus private state. The sender reports
+ * ACKs, losses and timeouts, and queries the congestion window (in packets) and the pacing rate
+ * (in bytes per second) before it puts new packets on the wire.
+ */
+
+#ifndef CONGESTION_H
+#define CONGESTION_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define CC_INITIAL_CWND 10 /**< Initial congestion window in packets. */
+#define CC_MIN_CWND 2      /**< Smallest congestion window after a loss, in packets. */
+
+/**
+ * @struct cc_ack_sample
+ * @brief Everything a controller learns from one batch of ACKs.
+ */
+typedef struct cc_ack_sample {
+    uint32_t acked;         /**< Number of packets newly acknowledged. */
+    uint32_t in_flight;     /**< Packets still outstanding after the ACKs were processed. */
+    uint64_t rtt_us;        /**< RTT measured on this batch, or 0 if no valid sample (Karn's rule). */
+    uint64_t srtt_us;       /**< Smoothed RTT of the connection, or 0 if not known yet. */
+    double delivery_rate;   /**< Delivery rate in packets per second measured on this batch, or 0. */
+    uint64_t now;           /**< Current time in microseconds. */
+} cc_ack_sample_t;
+
+typedef struct congestion congestion_t;
+
+/**
+ * @struct congestion_ops
+ * @brief The callbacks implementing one congestion control algorithm.
+ */
+typedef struct congestion_ops {
+    const char* name; /**< Name used to select the controller on the command line. */
+    int (*init)(congestion_t* cc);                                 /**< Allocates private state, 0 on success. */
+    void (*release)(congestion_t* cc);                             /**< Frees private state. */
+    void (*on_ack)(congestion_t* cc, const cc_ack_sample_t* sample); /**< Packets were acknowledged. */
+    void (*on_loss)(congestion_t* cc, uint64_t now);               /**< A loss was detected without a timeout. */
+    void (*on_timeout)(congestion_t* cc, uint64_t now);            /**< A retransmission timer expired. */
+    double (*cwnd)(const congestion_t* cc);                        /**< Congestion window in packets. */
+    double (*pacing_rate)(const congestion_t* cc);                 /**< Pacing rate in bytes/sec, 0 if unknown. */
+} congestion_ops_t;
+
+/**
+ * @struct congestion
+ * @brief A congestion controller instance.
+ */
+struct congestion {
+    const congestion_ops_t* ops; /**< The algorithm. */
+    size_t mss;                  /**< Size of a full packet on the wire in bytes. */
+    void* state;                 /**< Algorithm private state. */
+};
+
+extern const congestion_ops_t cc_reno_ops;  /**< Reno / AIMD. */
+extern const congestion_ops_t cc_cubic_ops; /**< CUBIC (RFC 8312). */
+extern const congestion_ops_t cc_bbr_ops;   /**< BBR-style bandwidth and min-RTT model. */
+
+/**
+ * @brief Looks up a congestion control algorithm by name.
+ *
+ * @param name The algorithm name ("reno", "cubic" or "bbr").
+ * @return The algorithm, or NULL if no algorithm has that name.
+ */
+const congestion_ops_t* congestion_find(const char* name);
+
+/**
+ * @brief Creates a controller running the given algorithm.
+ *
+ * @param cc The controller to initialize.
+ * @param ops The algorithm.
+ * @param mss Size of a full packet on the wire in bytes.
+ * @return 0 on success, -1 if the private state could not be allocated.
+ */
+int congestion_init(congestion_t* cc, const congestion_ops_t* ops, size_t mss);
+
+/**
+ * @brief Releases a controller's private state.
+ *
+ * @param cc The controller.
+ */
+void congestion_free(congestion_t* cc);
+
+/**
+ * @brief Computes the pacing rate a window based controller would use: cwnd over srtt with a gain.
+ *
+ * @param cwnd The congestion window in packets.
+ * @param mss Size of a full packet in bytes.
+ * @param srtt_us The smoothed RTT in microseconds, 0 if not known.
+ * @param gain Multiplier applied to cwnd / srtt.
+ * @return The pacing rate in bytes per second, or 0 if srtt is not known.
+ */
+double congestion_window_pacing_rate(double cwnd, size_t mss, uint64_t srtt_us, double gain);
+
+#endif
@@ -0,0 +1,130 @@
+/**
+ * @file crc32c.h
+ * @brief CRC32C (Castagnoli) checksums of packets and of whole transfers.
+ * @author Connor Johst - cjohst & Aaditya Suri - AadityaSuri
+ * @bug No known bugs
+ *
+ * crc32c() uses the SSE4.2 crc32 instruction when the CPU has it, running three independent
+ * streams at once to hide its latency, and a slicing-by-8 table lookup otherwise. Both compute the
+ * standard CRC32C: crc32c(0, "123456789", 9) == 0xe3069283.
+ *
+ * The CRC of a concatenation follows from the CRCs of its parts (crc32c_combine()), so a transfer
+ * digest can be built from the CRCs of its packets, in whatever order they arrive
+ * (crc32c_digest_add()), without reading the data again.
+ */
+
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/**
+ * @struct crc32c_digest
+ * @brief CRC32C of a byte range built from the CRCs of its blocks.
+ *
+ * Holds the combined CRC of the blocks added so far, as if they ended at end. Blocks that extend
+ * the range shift it forward; blocks of step bytes right after it, the common case, shift it with
+ * a precomputed operator.
+ */
+typedef struct crc32c_digest {
+    uint32_t crc;     /**< Combined CRC of the blocks added so far, up to end. */
+    uint64_t end;     /**< End of the furthest block added so far. */
+    uint64_t step;    /**< Usual block size. */
+    uint32_t step_op; /**< crc32c_combine_gen(step). */
+} crc32c_digest_t;
+
+/**
+ * @brief Updates a CRC32C with len bytes of data.
+ *
+ * @param crc The CRC of the data before, 0 to start.
+ * @param data The data.
+ * @param len Number of bytes.
+ * @return The CRC of the data before followed by data.
+ */
+uint32_t crc32c(uint32_t crc, const void* data, size_t len);
+
+/**
+ * @brief Updates a CRC32C with the table-driven implementation.
+ *
+ * @param crc The CRC of the data before, 0 to start.
+ * @param data The data.
+ * @param len Number of bytes.
+ * @return The CRC of the data before followed by data.
+ */
+uint32_t crc32c_sw(uint32_t crc, const void* data, size_t len);
+
+/**
+ * @brief Updates a CRC32C with the SSE4.2 implementation. Only call it if crc32c_hw_available().
+ *
+ * @param crc The CRC of the data before, 0 to start.
+ * @param data The data.
+ * @param len Number of bytes.
+ * @return The CRC of the data before followed by data.
+ */
+uint32_t crc32c_hw(uint32_t crc, const void* data, size_t len);
+
+/**
+ * @brief Checks whether the CPU has the SSE4.2 crc32 instruction, which crc32c() then uses.
+ *
+ * @return true if crc32c_hw() may be called.
+ */
+bool crc32c_hw_available(void);
+
+/**
+ * @brief Computes the operator that appends len2 bytes to a CRC, for crc32c_combine_op().
+ *
+ * @param len2 Length of the data appended.
+ * @return The operator.
+ */
+uint32_t crc32c_combine_gen(uint64_t len2);
+
+/**
+ * @brief Combines the CRCs of two consecutive blocks with an operator from crc32c_combine_gen().
+ *
+ * @param crc1 CRC of the first block.
+ * @param crc2 CRC of the second block.
+ * @param op crc32c_combine_gen() of the length of the second block.
+ * @return The CRC of the first block followed by the second.
+ */
+uint32_t crc32c_combine_op(uint32_t crc1, uint32_t crc2, uint32_t op);
+
+/**
+ * @brief Combines the CRCs of two consecutive blocks.
+ *
+ * @param crc1 CRC of the first block.
+ * @param crc2 CRC of the second block.
+ * @param len2 Length of the second block.
+ * @return The CRC of the first block followed by the second.
+ */
+uint32_t crc32c_combine(uint32_t crc1, uint32_t crc2, uint64_t len2);
+
+/**
+ * @brief Starts the digest of an empty range.
+ *
+ * @param digest The digest.
+ * @param step Size of most blocks that will be added.
+ */
+void crc32c_digest_init(crc32c_digest_t* digest, uint64_t step);
+
+/**
+ * @brief Adds a block to a digest. Blocks may be added in any order, but each only once.
+ *
+ * @param digest The digest.
+ * @param crc CRC of the block.
+ * @param offset Offset of the block in the range.
+ * @param len Length of the block.
+ */
+void crc32c_digest_add(crc32c_digest_t* digest, uint32_t crc, uint64_t offset, uint64_t len);
+
+/**
+ * @brief Returns the CRC of the whole range, once every block of it has been added.
+ *
+ * @param digest The digest.
+ * @param total Length of the range.
+ * @return The CRC32C of the range.
+ */
+uint32_t crc32c_digest_final(const crc32c_digest_t* digest, uint64_t total);
+
+#endif
@@ -0,0 +1,137 @@
+/**
+ * @file delta.h
+ * @brief Delta transfers: sending only the bytes of a file the receiver's older copy lacks.
+ * @author Connor Johst - cjohst & Aaditya Suri - AadityaSuri
+ * @bug No known bugs
+ *
+ * The receiver cuts its copy of the file into blocks of a fixed size and signs every whole block
+ * with a weak checksum that can be rolled along a buffer one byte at a time, a strong 64-bit hash
+ * (XXH64) and a CRC32C. The sender slides a window of one block over its own bytes, rolling the
+ * weak checksum; only where it equals the weak checksum of a block does it compute the other two,
+ * and a block matches only if all three do. A match is the offset of the bytes in the sender's
+ * file and the block of the copy that holds them, wherever that block sits in the copy, so
+ * inserted or removed bytes only cost the blocks around them.
+ *
+ * The receiver writes the new version of the file next to its copy: it copies every matched block
+ * from the copy, checking the block still has its CRC32C, and the sender only sends the packets of
+ * the file holding bytes no match covers (see resume.h).
+ */
+
+#ifndef DELTA_H
+#define DELTA_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define DELTA_MIN_BLOCK 2048  /**< Smallest block signed. */
+#define DELTA_MAX_BLOCK 65536 /**< Largest block signed. */
+#define DELTA_ANY_BLOCK UINT32_MAX /**< Block size proposed by a sender asking for a delta: any. */
+
+/**
+ * @struct delta_signature
+ * @brief The checksums of one block of the receiver's copy, as sent to the sender.
+ */
+typedef struct delta_signature {
+    uint64_t strong; /**< delta_strong_hash() of the block. */
+    uint32_t weak;   /**< delta_weak_sum() of the block. */
+    uint32_t crc;    /**< CRC32C of the block. */
+} delta_signature_t;
+
+/**
+ * @struct delta_match
+ * @brief Bytes of the sender's file the receiver's copy holds, as sent to the receiver.
+ */
+typedef struct delta_match {
+    uint64_t offset; /**< Offset of the bytes in the file, one block of them. */
+    uint64_t block;  /**< Block of the copy holding the same bytes. */
+} delta_match_t;
+
+/**
+ * @struct delta_index
+ * @brief Signatures of the receiver's copy, chained in a hash table by weak checksum.
+ */
+typedef struct delta_index {
+    const delta_signature_t* signatures; /**< The signatures, not owned. */
+    uint32_t count;      /**< Number of signatures. */
+    uint32_t block_size; /**< Bytes per block. */
+    int32_t* heads;      /**< First signature of each bucket, -1 if none. */
+    int32_t* next;       /**< Next signature in the same bucket, -1 if none. */
+    unsigned shift;      /**< 32 minus the log2 of the number of buckets. */
+} delta_index_t;
+
+/**
+ * @brief Returns the block size used to sign a file: about the square root of its size, so the
+ * signatures and the bytes of a changed block cost about the same.
+ *
+ * @param file_size Size of the file.
+ * @return A power of two between DELTA_MIN_BLOCK and DELTA_MAX_BLOCK.
+ */
+uint32_t delta_block_size(uint64_t file_size);
+
+/**
+ * @brief Computes the weak checksum of a block: the sum of its bytes in the low 16 bits and the
+ * sum of those sums, weighted by position, in the high 16 bits.
+ *
+ * @param data The bytes.
+ * @param len Number of bytes.
+ * @return The checksum.
+ */
+uint32_t delta_weak_sum(const uint8_t* data, size_t len);
+
+/**
+ * @brief Computes the XXH64 hash of a block, with seed 0.
+ *
+ * @param data The bytes.
+ * @param len Number of bytes.
+ * @return The hash.
+ */
+uint64_t delta_strong_hash(const void* data, size_t len);
+
+/**
+ * @brief Signs every whole block of a file. A last block shorter than the others is left out.
+ *
+ * @param fd The file.
+ * @param file_size Bytes of the file to sign.
+ * @param block_size Bytes per block.
+ * @param signatures Set to the signatures, to be freed by the caller.
+ * @param count Set to the number of signatures.
+ * @return 0 on success, -1 on error with errno set.
+ */
+int delta_sign(int fd, uint64_t file_size, uint32_t block_size, delta_signature_t** signatures, uint32_t* count);
+
+/**
+ * @brief Builds the index of a table of signatures.
+ *
+ * @param index The index.
+ * @param signatures The signatures, which must outlive the index.
+ * @param count Number of signatures.
+ * @param block_size Bytes per block.
+ * @return 0 on success, -1 if memory runs out.
+ */
+int delta_index_init(delta_index_t* index, const delta_signature_t* signatures, uint32_t count, uint32_t block_size);
+
+/**
+ * @brief Releases the memory of an index.
+ *
+ * @param index The index.
+ */
+void delta_index_free(delta_index_t* index);
+
+/**
+ * @brief Finds the blocks of the receiver's copy in a byte range of the sender's file.
+ *
+ * Matches do not overlap and come in the order of their offsets. After a match the search goes
+ * on right after it; elsewhere it moves one byte at a time.
+ *
+ * @param index The signatures of the copy.
+ * @param data The bytes of the range.
+ * @param len Length of the range.
+ * @param offset Offset of the range in the file.
+ * @param matches Set to the matches, to be freed by the caller.
+ * @param count Set to the number of matches.
+ * @return 0 on success, -1 if memory runs out.
+ */
+int delta_find_matches(const delta_index_t* index, const uint8_t* data, uint64_t len, uint64_t offset,
+                       delta_match_t** matches, size_t* count);
+
+#endif
@@ -0,0 +1,165 @@
+/**
+ * @file fec.h
+ * @brief Forward error correction: parity packets that let the receiver rebuild lost data
+ * packets without waiting for a retransmission.
+ * @author Connor Johst - cjohst & Aaditya Suri - AadityaSuri
+ * @bug No known bugs
+ *
+ * Data packets are grouped by sequence number, data packets per group. After the last data packet
+ * of a group the sender sends parity packets computed with a systematic Reed-Solomon code over
+ * GF(2^8) (see gf256.h): parity packet j is the sum of coefficient(j, i) times data packet i, with
+ * shorter packets padded with zeros. The coefficients form a Cauchy matrix, so any data packets of
+ * the group can be rebuilt from as many parity packets, and its columns are scaled so the first
+ * parity packet is the plain XOR of the group.
+ *
+ * Every parity packet names the number of data packets of its group, fewer than data packets per
+ * group only for the last group, so the receiver need not know how long the connection is.
+ *
+ * The receiver does not keep the data packets of a group: it adds each one into one running sum per
+ * parity packet as it arrives, so a sum ends up holding the parity packet minus every data packet
+ * received, a combination of the missing ones only. Solving those combinations rebuilds them.
+ */
+
+#ifndef FEC_H
+#define FEC_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "packet.h"
+
+#define FEC_MAX_SYMBOLS 255 /**< Most data and parity packets in one group. */
+#define FEC_MAX_PARITY 32   /**< Most parity packets per group. */
+
+/**
+ * @struct fec_code
+ * @brief Shape and coefficients of the code.
+ */
+typedef struct fec_code {
+    unsigned data;          /**< Data packets per group. */
+    unsigned parity;        /**< Parity packets per group. */
+    uint8_t* coefficients;  /**< parity rows of data coefficients each. */
+} fec_code_t;
+
+/**
+ * @struct fec_group
+ * @brief What a receiver knows about one group.
+ */
+typedef struct fec_group {
+    bool active;              /**< Whether the slot holds a group. */
+    bool done;                /**< Whether every data packet of the group arrived or was rebuilt. */
+    uint32_t group;           /**< Group number: sequence number / data packets per group. */
+    unsigned data_received;   /**< Data packets added. */
+    unsigned parity_received; /**< Parity packets added. */
+    unsigned size;            /**< Data packets of the group, as its parity packets say; 0 before the first. */
+    uint8_t* have;            /**< Which data packets, then which parity packets, were added. */
+    unsigned char* sums;      /**< One running sum per parity packet, payload_size bytes each. */
+} fec_group_t;
+
+/**
+ * @struct fec_decoder
+ * @brief State of the receiving side of one connection.
+ */
+typedef struct fec_decoder {
+    fec_code_t code;           /**< The code of the connection. */
+    size_t payload_size;       /**< Bytes of data per packet. */
+    uint64_t total_bytes;      /**< Bytes of the connection, giving the length of every packet. */
+    fec_group_t* groups;       /**< Groups in flight, group g in slot g % num_groups. */
+    unsigned num_groups;       /**< Number of slots. */
+    unsigned char* recovered;  /**< Packets rebuilt by the last fec_decoder_recover(). */
+} fec_decoder_t;
+
+/**
+ * @brief Builds the coefficients of a code.
+ *
+ * @param code The code.
+ * @param data Data packets per group.
+ * @param parity Parity packets per group, at most FEC_MAX_PARITY; data + parity is at most FEC_MAX_SYMBOLS.
+ * @return 0 on success, -1 if the shape is invalid or memory runs out.
+ */
+int fec_code_init(fec_code_t* code, unsigned data, unsigned parity);
+
+/**
+ * @brief Releases the coefficients of a code.
+ *
+ * @param code The code.
+ */
+void fec_code_free(fec_code_t* code);
+
+/**
+ * @brief Adds a data packet into the parity packets of its group.
+ *
+ * @param code The code.
+ * @param index Position of the data packet in its group.
+ * @param data The payload of the data packet.
+ * @param len Length of the payload.
+ * @param parity Payload of the first parity packet, zeroed before the first data packet is added.
+ * @param stride Distance between the payloads of two parity packets.
+ */
+void fec_encode(const fec_code_t* code, unsigned index, const void* data, size_t len, unsigned char* parity, size_t stride);
+
+/**
+ * @brief Initializes the decoder of a connection.
+ *
+ * @param decoder The decoder.
+ * @param data Data packets per group.
+ * @param parity Parity packets per group.
+ * @param payload_size Bytes of data per packet.
+ * @param window Most packets the sender has outstanding, which bounds the groups in flight.
+ * @param total_bytes Bytes of the connection, or UINT64_MAX if every packet is payload_size bytes long.
+ * @return 0 on success, -1 if the shape is invalid or memory runs out.
+ */
+int fec_decoder_init(fec_decoder_t* decoder, unsigned data, unsigned parity, size_t payload_size,
+                     uint32_t window, uint64_t total_bytes);
+
+/**
+ * @brief Releases the memory of a decoder. A zeroed decoder may be freed too.
+ *
+ * @param decoder The decoder.
+ */
+void fec_decoder_free(fec_decoder_t* decoder);
+
+/**
+ * @brief Adds the first copy of a data packet to its group.
+ *
+ * @param decoder The decoder.
+ * @param seq Sequence number of the packet.
+ * @param data Its payload.
+ * @param len Length of the payload.
+ */
+void fec_decoder_add_data(fec_decoder_t* decoder, uint32_t seq, const void* data, size_t len);
+
+/**
+ * @brief Adds a parity packet to its group.
+ *
+ * @param decoder The decoder.
+ * @param first_seq Sequence number of the first data packet of the group.
+ * @param index Position of the parity packet in its group.
+ * @param size Number of data packets of the group.
+ * @param data Its payload.
+ * @param len Length of the payload.
+ */
+void fec_decoder_add_parity(fec_decoder_t* decoder, uint32_t first_seq, unsigned index, unsigned size,
+                            const void* data, size_t len);
+
+/**
+ * @brief Rebuilds the missing data packets of a group once enough of its packets arrived.
+ *
+ * @param decoder The decoder.
+ * @param seq Sequence number of any data packet of the group.
+ * @return Number of packets rebuilt, available through fec_decoder_packet() until the next call.
+ */
+unsigned fec_decoder_recover(fec_decoder_t* decoder, uint32_t seq);
+
+/**
+ * @brief Returns a packet rebuilt by the last fec_decoder_recover(), with its sequence number and
+ * length set in its header.
+ *
+ * @param decoder The decoder.
+ * @param index Which packet, below the count fec_decoder_recover() returned.
+ * @return The packet.
+ */
+packet_t* fec_decoder_packet(fec_decoder_t* decoder, unsigned index);
+
+#endif
@@ -0,0 +1,63 @@
+/**
+ * @file filesource.h
+ * @brief Random access to the file being sent, through an mmap() of it when possible and pread()
+ * otherwise, so any packet can be (re)built from the file without keeping a copy of its data.
+ * @author Connor Johst - cjohst & Aaditya Suri - AadityaSuri
+ * @bug No known bugs
+ */
+
+#ifndef FILESOURCE_H
+#define FILESOURCE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/**
+ * @struct file_source
+ * @brief An open input file.
+ */
+typedef struct file_source {
+    int fd;                   /**< The open file. */
+    uint64_t size;            /**< Size of the file in bytes when it was opened. */
+    uint64_t version;         /**< Modification time of the file in nanoseconds when it was opened. */
+    const unsigned char* map; /**< Read-only mapping of the whole file, NULL when reading with pread(). */
+} file_source_t;
+
+/**
+ * @brief Opens a file for reading and maps it into memory if it can be mapped.
+ *
+ * @param source The source to initialize.
+ * @param filename The file to open.
+ * @return 0 on success, -1 if the file cannot be opened or its size cannot be read.
+ */
+int file_source_open(file_source_t* source, const char* filename);
+
+/**
+ * @brief Copies len bytes of the file starting at offset into buffer.
+ *
+ * @param source The source.
+ * @param offset Offset of the first byte in the file.
+ * @param buffer Where to copy the bytes.
+ * @param len Number of bytes to copy; offset + len must not exceed the file size.
+ * @return The number of bytes copied, or -1 on a read error.
+ */
+ssize_t file_source_read(const file_source_t* source, uint64_t offset, unsigned char* buffer, size_t len);
+
+/**
+ * @brief Returns the mapped bytes of the file starting at offset, to send them without a copy.
+ *
+ * @param source The source.
+ * @param offset Offset of the first byte in the file.
+ * @return The bytes, valid until the source is closed, or NULL if the file is read with pread().
+ */
+const unsigned char* file_source_slice(const file_source_t* source, uint64_t offset);
+
+/**
+ * @brief Unmaps and closes the file.
+ *
+ * @param source The source.
+ */
+void file_source_close(file_source_t* source);
+
+#endif
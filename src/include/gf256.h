@@ -0,0 +1,64 @@
+/**
+ * @file gf256.h
+ * @brief Arithmetic in GF(2^8), the field the forward error correction code works in.
+ * @author Connor Johst - cjohst & Aaditya Suri - AadityaSuri
+ * @bug No known bugs
+ *
+ * Elements are bytes, addition is XOR and multiplication is modulo x^8 + x^4 + x^3 + x^2 + 1.
+ * The bulk operation, adding a multiple of one buffer to another, splits every byte into its two
+ * nibbles and looks both products up in 16-entry tables, 32 or 16 bytes at a time with the
+ * AVX2 or SSSE3 byte shuffle when the CPU has one, and one byte at a time in a full product table
+ * otherwise.
+ */
+
+#ifndef GF256_H
+#define GF256_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @brief Multiplies two elements.
+ *
+ * @param a First element.
+ * @param b Second element.
+ * @return a * b.
+ */
+uint8_t gf256_mul(uint8_t a, uint8_t b);
+
+/**
+ * @brief Inverts a non-zero element.
+ *
+ * @param a The element, not 0.
+ * @return 1 / a.
+ */
+uint8_t gf256_inv(uint8_t a);
+
+/**
+ * @brief Adds c times src to dst, byte by byte: dst[i] ^= c * src[i].
+ *
+ * @param dst The buffer added to.
+ * @param src The buffer multiplied.
+ * @param c The factor.
+ * @param len Number of bytes.
+ */
+void gf256_mul_add(uint8_t* dst, const uint8_t* src, uint8_t c, size_t len);
+
+/**
+ * @brief Same as gf256_mul_add(), always with the product table.
+ *
+ * @param dst The buffer added to.
+ * @param src The buffer multiplied.
+ * @param c The factor.
+ * @param len Number of bytes.
+ */
+void gf256_mul_add_sw(uint8_t* dst, const uint8_t* src, uint8_t c, size_t len);
+
+/**
+ * @brief Names the implementation gf256_mul_add() uses on this CPU.
+ *
+ * @return "avx2", "ssse3" or "table".
+ */
+const char* gf256_impl(void);
+
+#endif
@@ -0,0 +1,81 @@
+/**
+ * @file iopool.h
+ * @brief Worker threads writing received payloads to their output files off the receive loop.
+ * @author Connor Johst - cjohst & Aaditya Suri - AadityaSuri
+ * @bug A failed write terminates the program, as it does on the receive loop.
+ *
+ * Each submitted write copies its payload into a job and holds a reference to its output file
+ * until a worker has written it with pwrite(). The queue is bounded: once IO_POOL_MAX_JOBS writes
+ * are waiting, submitting blocks until the workers catch up, so a slow disk slows the receive loop
+ * instead of growing the queue without bound. The bytes waiting count toward the backlog of their
+ * file (see output_backlog()), which shrinks the window the receiver advertises to its senders.
+ */
+
+#ifndef IOPOOL_H
+#define IOPOOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "output.h"
+
+#define IO_POOL_MAX_JOBS 4096 /**< Most writes waiting for a worker before submitting blocks. */
+
+/**
+ * @struct io_job
+ * @brief A payload waiting to be written at its offset.
+ */
+typedef struct io_job {
+    struct io_job* next;   /**< Next job in the queue. */
+    output_file_t* file;   /**< The file, referenced by the job. */
+    uint64_t offset;       /**< Offset of the payload in the file. */
+    size_t len;            /**< Length of the payload. */
+    unsigned char data[];  /**< The payload. */
+} io_job_t;
+
+/**
+ * @struct io_pool
+ * @brief A queue of writes shared by a fixed number of worker threads.
+ */
+typedef struct io_pool {
+    pthread_t* threads;       /**< The workers; NULL if writes are made by the caller. */
+    unsigned int num_threads; /**< Number of workers. */
+    io_job_t* head;           /**< Oldest waiting job. */
+    io_job_t* tail;           /**< Newest waiting job. */
+    size_t queued;            /**< Number of waiting jobs. */
+    bool stopping;            /**< Set when the workers should exit once the queue is empty. */
+    pthread_mutex_t lock;     /**< Guards the queue. */
+    pthread_cond_t not_empty; /**< Signalled when a job is queued or the pool stops. */
+    pthread_cond_t not_full;  /**< Signalled when a worker takes a job. */
+} io_pool_t;
+
+/**
+ * @brief Starts the worker threads.
+ *
+ * @param pool The pool to initialize.
+ * @param num_threads Number of workers; 0 makes io_pool_submit() write in the calling thread.
+ * @return 0 on success, -1 if the workers could not be started.
+ */
+int io_pool_init(io_pool_t* pool, unsigned int num_threads);
+
+/**
+ * @brief Queues a payload to be written at an offset of a file.
+ *
+ * @param pool The pool.
+ * @param file The file to write to.
+ * @param offset Offset of the payload in the file.
+ * @param data The payload, copied before the call returns.
+ * @param len Length of the payload.
+ */
+void io_pool_submit(io_pool_t* pool, output_file_t* file, uint64_t offset, const void* data, size_t len);
+
+/**
+ * @brief Writes every queued payload, then stops the workers.
+ *
+ * @param pool The pool.
+ */
+void io_pool_free(io_pool_t* pool);
+
+#endif
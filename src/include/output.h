@@ -0,0 +1,119 @@
+/**
+ * @file output.h
+ * @brief Output file of one transfer, written in order through stdio or at packet offsets.
+ * @author Connor Johst - cjohst & Aaditya Suri - AadityaSuri
+ * @bug No known bugs
+ *
+ * An output file is reference counted: the session receiving into it holds one reference and
+ * every write queued to the I/O workers (see iopool.h) holds another, so the file is only closed
+ * once the session has ended and its last write has reached the kernel. Writes at offsets may come
+ * from several threads at once and share the file's write rate limiter.
+ */
+
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+#include "ratelimit.h"
+#include "resume.h"
+
+#define OUTPUT_BUFFER_SZ (1 << 20) // Size of the stdio buffer of files written in order.
+#define OUTPUT_RATE_BURST_NS 100000000ULL // Bytes of its write rate a file takes at once, as the time they take: 100ms.
+
+/**
+ * @struct output_file
+ * @brief An open output file.
+ */
+typedef struct output_file {
+    FILE* stream;           /**< Stream for in-order writes. */
+    int fd;                 /**< Descriptor of the stream, for writes at offsets. */
+    rate_limiter_t limiter; /**< Write rate of the file. */
+    pthread_mutex_t lock;   /**< Guards limiter, refs and pending. */
+    unsigned int refs;      /**< References held by the session and by queued writes. */
+    uint64_t pending;       /**< Bytes queued for an I/O pool worker and not written yet. */
+    checkpoint_t* checkpoint; /**< Records the bytes written at offsets, NULL if the file is not checkpointed. */
+} output_file_t;
+
+/**
+ * @brief Opens an output file, creating it if needed, holding one reference for the caller.
+ *
+ * @param path The file to write.
+ * @param write_rate Bytes per second written to the file, 0 for no limit.
+ * @param truncate Whether to empty the file. Files written at offsets by several connections are
+ * not truncated, so a stripe set up after another one ended cannot wipe out its data.
+ * @return The file, or NULL if it could not be opened.
+ */
+output_file_t* output_open(const char* path, uint64_t write_rate, bool truncate);
+
+/**
+ * @brief Sizes the file for the whole transfer, so writes at offsets never extend it, and cuts
+ * off anything an earlier file of the same name left beyond it.
+ *
+ * @param file The file.
+ * @param total_bytes Size of the transfer.
+ * @return 0 on success, -1 on error.
+ */
+int output_preallocate(output_file_t* file, uint64_t total_bytes);
+
+/**
+ * @brief Appends data through the stdio buffer after waiting for the write rate.
+ *
+ * @param file The file.
+ * @param data The data.
+ * @param len Length of the data.
+ * @return The number of bytes written.
+ */
+size_t output_append(output_file_t* file, const void* data, size_t len);
+
+/**
+ * @brief Writes data at an offset with pwrite() after waiting for the write rate, and records it in
+ * the checkpoint of the file if it has one. Safe to call from several threads.
+ *
+ * @param file The file.
+ * @param offset Offset of the data in the file.
+ * @param data The data.
+ * @param len Length of the data.
+ * @return len on success, -1 on error.
+ */
+ssize_t output_write_at(output_file_t* file, uint64_t offset, const void* data, size_t len);
+
+/**
+ * @brief Takes another reference to the file.
+ *
+ * @param file The file.
+ */
+void output_retain(output_file_t* file);
+
+/**
+ * @brief Counts bytes queued for the file by an I/O pool, or written by one of its workers.
+ *
+ * @param file The file.
+ * @param len Number of bytes.
+ * @param queued Whether they were queued rather than written.
+ */
+void output_count_pending(output_file_t* file, size_t len, bool queued);
+
+/**
+ * @brief Returns the bytes the file takes before a writer has to wait: the tokens of its write
+ * rate, less the bytes queued for I/O pool workers. Without a write rate only the queued bytes
+ * count.
+ *
+ * @param file The file.
+ * @return The number of bytes, negative while writes are behind.
+ */
+int64_t output_room(output_file_t* file);
+
+/**
+ * @brief Drops a reference to the file, closing it when it was the last one.
+ *
+ * @param file The file.
+ */
+void output_release(output_file_t* file);
+
+#endif
@@ -0,0 +1,81 @@
+/**
+ * @file pacer.h
+ * @brief Sender pacing: spreads transmissions at the congestion controller's pacing rate instead
+ * of sending a window's worth of packets back-to-back.
+ * @author Connor Johst - cjohst & Aaditya Suri - AadityaSuri
+ * @bug No known bugs
+ *
+ * With kernel pacing the rate is handed to the socket with SO_MAX_PACING_RATE and the fq qdisc
+ * spaces the packets; the pacer itself then never holds a packet back. Otherwise every send moves
+ * a release time forward by its length over the rate, and packets are only sent while the release
+ * time is less than PACER_SLACK_NS ahead of now, which bounds a burst to PACER_SLACK_NS at the
+ * pacing rate while letting one flush carry several packets at high rates.
+ */
+
+#ifndef PACER_H
+#define PACER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define PACER_SLACK_NS 200000ULL /**< How far ahead of now the release time may run. */
+#define PACER_NO_WAIT 0 /**< Returned by pacer_release_time() when packets may go at once. */
+
+/**
+ * @struct pacer
+ * @brief State of the pacer.
+ */
+typedef struct pacer {
+    double rate;          /**< Pacing rate in bytes per second, 0 to send without pacing. */
+    uint64_t release_ns;  /**< Time at which the next packet is due, in nanoseconds. */
+    bool kernel;          /**< Whether the socket paces with SO_MAX_PACING_RATE. */
+    int sock_fd;          /**< The socket, for kernel pacing. */
+} pacer_t;
+
+/**
+ * @brief Initializes an unpaced pacer.
+ *
+ * @param pacer The pacer to initialize.
+ * @param sock_fd The socket packets are sent on.
+ * @param kernel Whether to try kernel pacing (SO_MAX_PACING_RATE, needs the fq qdisc).
+ * @return 0 on success, -1 if kernel pacing was asked for but the socket does not support it; the
+ * pacer then paces in user space.
+ */
+int pacer_init(pacer_t* pacer, int sock_fd, bool kernel);
+
+/**
+ * @brief Sets the pacing rate.
+ *
+ * @param pacer The pacer.
+ * @param rate Pacing rate in bytes per second, 0 to stop pacing.
+ */
+void pacer_set_rate(pacer_t* pacer, double rate);
+
+/**
+ * @brief Checks whether the next packet may be sent now.
+ *
+ * @param pacer The pacer.
+ * @param now Current time in nanoseconds.
+ * @return true if a packet may be sent.
+ */
+bool pacer_ready(const pacer_t* pacer, uint64_t now);
+
+/**
+ * @brief Accounts for a packet that is being sent.
+ *
+ * @param pacer The pacer.
+ * @param bytes Size of the packet.
+ * @param now Current time in nanoseconds.
+ */
+void pacer_on_send(pacer_t* pacer, size_t bytes, uint64_t now);
+
+/**
+ * @brief Returns when the next packet may be sent.
+ *
+ * @param pacer The pacer.
+ * @return The time in nanoseconds, or PACER_NO_WAIT if packets may be sent at once.
+ */
+uint64_t pacer_release_time(const pacer_t* pacer);
+
+#endif
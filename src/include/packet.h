@@ -9,58 +9,212 @@
 #define PACKET_H
 
 #include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
 
-#define PAYLOAD_SZ 500 // bytes of data contained within each packet.
+#define DEFAULT_PAYLOAD_SZ 500 // bytes of data per packet when the path MTU cannot be determined.
+#define MAX_PAYLOAD_SZ 65487 // largest payload that fits in one UDP datagram after the header.
+#define PACKET_SIZE(payload_size) (sizeof(header_t) + (payload_size)) // bytes of a packet carrying payload_size bytes.
 
 // Define flag values for packet headers
+#define SYN_FLAG 0b1000000000000000 // Setup flag, the data carries a setup_t
 #define ACK_FLAG 0b0100000000000000 //Ack flag
 #define FIN_FLAG 0b0000010000000000 // Finish flag 
+#define SACK_FLAG 0b0000001000000000 // ACK carries selective acknowledgment blocks in its data
+#define FEC_FLAG 0b0000000100000000 // Parity packet of a group of data packets, see fec.h
+#define RESUME_FLAG 0b0000000010000000 // Request for, or with ACK_FLAG a chunk of, the blocks the receiver already has
+#define DELTA_FLAG 0b0000000001000000 // Request for, or with ACK_FLAG a chunk of, the signatures of the receiver's copy
+#define MATCH_FLAG 0b0000000000100000 // Chunk of the blocks the receiver copies from its copy, or with ACK_FLAG its receipt
+#define WINDOW_FLAG 0b0000000000010000 // Probe of the receive window, or with ACK_FLAG an ACK carrying it in its data
 
 
 // Macros to check flag values
+#define IS_SYN(flags) (flags & SYN_FLAG) //
 #define IS_ACK(flags) (flags & ACK_FLAG) //
 #define IS_FIN(flags) (flags & FIN_FLAG) //
+#define IS_SACK(flags) (flags & SACK_FLAG) //
+#define IS_FEC(flags) (flags & FEC_FLAG) //
+#define IS_RESUME(flags) (flags & RESUME_FLAG) //
+#define IS_DELTA(flags) (flags & DELTA_FLAG) //
+#define IS_MATCH(flags) (flags & MATCH_FLAG) //
+#define IS_WINDOW(flags) (flags & WINDOW_FLAG) //
+
+#define MAX_SACK_BLOCKS 32 // Maximum number of SACK blocks carried by one ACK.
+#define ACK_PACKET_SZ (sizeof(header_t) + 2 * sizeof(uint32_t) + MAX_SACK_BLOCKS * sizeof(sack_block_t)) // largest ACK datagram
+#define MAX_TABLE_CHUNK 1024 // Most bytes of a table exchanged during setup carried by one packet.
+#define MAX_FIN_SENT 10 // Most FINs a sender sends before giving up; the receiver lingers until the last one.
 
 /**
  * @struct header
  * @brief Structure representing a packet header.
+ *
+ * Every packet carries a CRC32C of its payload followed by its header with the checksum field
+ * zeroed (see packet_checksum()); receivers drop packets that do not match. A FIN carries the
+ * CRC32C of every byte of the connection in its data, and its FIN-ACK the CRC32C of the bytes the
+ * receiver got, so both ends can tell whether the transfer arrived intact.
+ *
+ * A FIN also carries the sender's RTO in microseconds in ack_num and its own number, from 1 to
+ * MAX_FIN_SENT, in seq_num, and is sent again every such RTO until its FIN-ACK arrives. The
+ * receiver lingers until the last FIN the sender may still send could arrive, repeating its
+ * FIN-ACK for every repeated FIN, and leaves as soon as the sender acknowledges the FIN-ACK with a
+ * FIN_FLAG | ACK_FLAG packet of its own.
+ *
+ * A parity packet (FEC_FLAG) carries the sequence number of the first data packet of its group in
+ * seq_num, and in ack_num its position among the parity packets of the group in the low 16 bits and
+ * the number of data packets of the group in the high 16 bits.
  */
 
 typedef struct header {
     uint32_t seq_num; /**< Sequence number */
     uint32_t ack_num; /**< Acknowledgment number */
+    uint32_t conn_id; /**< Connection the packet belongs to, chosen by the sender */
     uint16_t length;  /**< Length of the packet */
     uint16_t flags;   /**< Flags associated with the packet */
+    uint32_t checksum; /**< CRC32C of the packet, see packet_checksum() */
 } header_t;
 
+/**
+ * @struct sack_block
+ * @brief A range [start, end) of sequence numbers the receiver holds beyond the cumulative ACK.
+ *
+ * An ACK packet carries the next sequence number the receiver expects in ack_num, echoes the
+ * sequence number of the packet that triggered it in seq_num, and, when SACK_FLAG is set, carries
+ * SACK blocks in its data.
+ *
+ * With WINDOW_FLAG its data starts with the receive window, a uint32_t: the number of packets from
+ * ack_num on the receiver can take. The window shrinks while bytes wait to be written to the output
+ * file, so a slow disk slows the sender down rather than losing packets. A second uint32_t follows
+ * it: the microseconds the echoed packet waited at the receiver before the ACK was sent, which the
+ * sender subtracts from its RTT sample. The SACK blocks come after both. A sender whose window
+ * stays closed probes it with a WINDOW_FLAG packet without data, which the receiver answers with an
+ * ACK at once.
+ */
+
+typedef struct sack_block {
+    uint32_t start; /**< First sequence number of the range */
+    uint32_t end;   /**< One past the last sequence number of the range */
+} sack_block_t;
+
+/**
+ * @struct setup
+ * @brief Transfer parameters agreed on before any data is sent.
+ *
+ * The sender opens a transfer with a SYN packet carrying the largest payload and window it wants
+ * to use. The receiver answers with SYN_FLAG | ACK_FLAG and the values both sides then use, which
+ * are never larger than the ones proposed.
+ *
+ * A file may be striped: split into byte ranges sent over separate connections at once. Each
+ * stripe is set up on its own and says where its bytes go in the file and which file it is part of.
+ *
+ * A sender may protect the connection with forward error correction (see fec.h): fec_parity parity
+ * packets after every fec_data data packets. The receiver agrees to any valid shape.
+ *
+ * A receiver that checkpoints its output file (see resume.h) answers with the bytes of the stripe
+ * it already has from an earlier transfer of the same file_size and file_version. The sender then
+ * asks for the bitmap of the blocks the stripe covers with RESUME_FLAG packets carrying the offset
+ * of the first bitmap byte they want in seq_num; each answer (RESUME_FLAG | ACK_FLAG) echoes it and
+ * carries up to MAX_TABLE_CHUNK bytes of the bitmap, one bit per block, from the block holding
+ * offset. The connection then only carries the packets of the stripe with bytes of missing blocks.
+ *
+ * A sender may ask for a delta transfer (see delta.h) by setting delta_block_size to
+ * DELTA_ANY_BLOCK. A receiver updating an older copy of the file answers with the block size and
+ * number of its signatures, which the sender fetches like the bitmap with DELTA_FLAG packets. The
+ * sender then pushes the blocks of the copy the receiver should reuse: MATCH_FLAG packets carrying
+ * the offset of their chunk of the table in seq_num and the length of the whole table in ack_num,
+ * each acknowledged by a MATCH_FLAG | ACK_FLAG packet echoing seq_num. Every table is cut into
+ * chunks of the smaller of payload_size and MAX_TABLE_CHUNK bytes. The connection then only carries
+ * the packets of the stripe with bytes the matches leave out, so the receiver caps their
+ * payload_size at its block size.
+ *
+ * A sender may ask for the connection to be compressed (see compress.h) by setting compress_block;
+ * the receiver agrees to blocks up to COMPRESS_MAX_BLOCK bytes. The connection then carries the
+ * compressed stream of the bytes it would have carried, and its length, unknown until the last
+ * block is compressed, is no longer total_bytes.
+ *
+ * The receiver also answers with its receive_window, which bounds the first flight of packets
+ * until ACKs carry the window (see sack_block_t), and with max_ack_delay, the longest it holds an
+ * ACK back, which the sender adds to its RTO so that delayed ACKs do not cause retransmissions.
+ */
+
+typedef struct setup {
+    uint32_t payload_size; /**< Bytes of data carried by every packet but the last */
+    uint32_t window_size;  /**< Most packets the sender may have outstanding, the receiver's reorder window */
+    uint64_t total_bytes;  /**< Bytes the sender is going to transfer on this connection, set by the sender only */
+    uint64_t offset;       /**< Offset in the file of the first byte of this connection, set by the sender only */
+    uint64_t file_size;    /**< Bytes of the whole file across all stripes, set by the sender only */
+    uint32_t transfer_id;  /**< Connection ID of the first stripe, shared by every stripe of the file */
+    uint32_t stripes;      /**< Number of connections the file is striped over, 1 if it is not */
+    uint16_t fec_data;     /**< Data packets per forward error correction group, 0 without it */
+    uint16_t fec_parity;   /**< Parity packets per group, 0 without forward error correction */
+    uint64_t file_version; /**< Modification time of the file in nanoseconds, set by the sender only */
+    uint64_t present_bytes; /**< Bytes of the stripe the receiver already has, set by the receiver only */
+    uint32_t delta_block_size; /**< Sender: DELTA_ANY_BLOCK to ask for a delta transfer, 0 otherwise; receiver: bytes per block of its signatures, 0 if it has none */
+    uint32_t delta_blocks; /**< Signatures of the receiver's copy of the file, set by the receiver only */
+    uint32_t compress_block; /**< Bytes per compressed block, 0 if the connection is not compressed */
+    uint32_t receive_window; /**< Packets the receiver can take before its first ACK, set by the receiver only */
+    uint32_t max_ack_delay; /**< Longest the receiver holds an ACK back in microseconds, set by the receiver only */
+} setup_t;
+
 /**
  * @struct packet
  * @brief Structure representing a packet with header and data.
+ *
+ * The payload size is agreed on at runtime, so packets live in buffers of
+ * PACKET_SIZE(payload_size) bytes rather than in a fixed-size structure.
  */
 
 typedef struct packet {
     header_t header;
-    unsigned char data[PAYLOAD_SZ];
+    unsigned char data[];
 } packet_t;
 
 /**
  * @brief Creates a packet header with the specified parameters.
  * 
+ * @param conn_id The connection the packet belongs to.
  * @param seq_number The sequence number of the packet.
  * @param ack_number The acknowledgment number of the packet.
  * @param length The length of the packet.
  * @param flags The flags associated with the packet.
  * @return The created packet header.
  */
-header_t create_header(uint32_t seq_number, uint32_t ack_number, uint16_t length, uint16_t flags);
+header_t create_header(uint32_t conn_id, uint32_t seq_number, uint32_t ack_number, uint16_t length, uint16_t flags);
 
 /**
  * @brief Creates a packet with the specified data and header.
  * 
- * @param data The data to be included in the packet.
+ * @param packet The buffer to build the packet in, at least PACKET_SIZE(pkt_header.length) bytes
+ * unless data is NULL.
+ * @param data The data to be included in the packet, or NULL for a header-only packet.
  * @param pkt_header The header of the packet.
- * @return The created packet.
  */
-packet_t create_packet(unsigned char [], header_t pkt_header);
+void create_packet(packet_t* packet, const unsigned char [], header_t pkt_header);
+
+/**
+ * @brief Computes the checksum of a packet from the CRC32C of its payload, so a payload that is
+ * not stored after its header does not need to be copied.
+ *
+ * @param header The header of the packet; its checksum field is ignored.
+ * @param payload_crc crc32c() of the header->length bytes of payload.
+ * @return The value of the checksum field.
+ */
+uint32_t packet_checksum(const header_t* header, uint32_t payload_crc);
+
+/**
+ * @brief Sets the checksum of a packet whose payload follows its header.
+ *
+ * @param packet The packet.
+ */
+void packet_seal(packet_t* packet);
+
+/**
+ * @brief Checks that a received datagram holds a whole packet with a matching checksum.
+ *
+ * @param packet The datagram.
+ * @param len Length of the datagram.
+ * @param payload_crc Set to the CRC32C of the payload if not NULL.
+ * @return true if the packet is intact.
+ */
+bool packet_verify(const packet_t* packet, size_t len, uint32_t* payload_crc);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,57 @@
+/**
+ * @file ratelimit.h
+ * @brief Token bucket rate limiter on CLOCK_MONOTONIC, used to pace writes to the output file.
+ * @author Connor Johst - cjohst & Aaditya Suri - AadityaSuri
+ * @bug No known bugs
+ *
+ * Tokens (bytes) accumulate at rate bytes per second up to burst bytes. A write may take more
+ * tokens than the bucket holds; the bucket then goes into debt and the next write sleeps until
+ * it is paid back, so the average rate stays exact whatever the write sizes.
+ */
+
+#ifndef RATELIMIT_H
+#define RATELIMIT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define RATE_LIMIT_BURST_NS 10000000ULL /**< Default bucket depth: 10ms worth of tokens. */
+
+/**
+ * @struct rate_limiter
+ * @brief State of a token bucket.
+ */
+typedef struct rate_limiter {
+    uint64_t rate;     /**< Bytes per second, 0 for no limit. */
+    double burst;      /**< Most tokens the bucket holds. */
+    double tokens;     /**< Tokens available; negative while in debt. */
+    uint64_t last_ns;  /**< Time tokens were last added, in nanoseconds. */
+} rate_limiter_t;
+
+/**
+ * @brief Initializes a full token bucket.
+ *
+ * @param limiter The limiter to initialize.
+ * @param rate Bytes per second, 0 for no limit.
+ * @param burst_ns Bucket depth, as the time it takes to fill it.
+ */
+void rate_limiter_init(rate_limiter_t* limiter, uint64_t rate, uint64_t burst_ns);
+
+/**
+ * @brief Sleeps until len bytes may be sent or written, then takes them from the bucket.
+ *
+ * @param limiter The limiter.
+ * @param len Number of bytes about to be sent or written.
+ */
+void rate_limiter_wait(rate_limiter_t* limiter, size_t len);
+
+/**
+ * @brief Returns the tokens in the bucket without taking any.
+ *
+ * @param limiter The limiter.
+ * @param now Current time in nanoseconds.
+ * @return The tokens in bytes, negative while the bucket is in debt.
+ */
+int64_t rate_limiter_tokens(const rate_limiter_t* limiter, uint64_t now);
+
+#endif
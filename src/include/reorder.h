@@ -0,0 +1,103 @@
+/**
+ * @file reorder.h
+ * @brief Receiver reorder window: a circular buffer of packets received ahead of the next
+ * expected sequence number, indexed by seq_num % window with an occupancy bitmap.
+ * @author Connor Johst - cjohst & Aaditya Suri - AadityaSuri
+ * @bug No known bugs
+ *
+ * The sender never has more than the agreed window of packets outstanding, so every packet it
+ * can send falls in [expected, expected + window) and owns a distinct slot. Inserting, rejecting
+ * a duplicate and taking the next in-order packet are O(1); SACK blocks are read off the bitmap.
+ *
+ * With a slot_size of 0 the window only tracks which packets arrived, for receivers that write
+ * every packet to its place in the file as soon as it arrives.
+ */
+
+#ifndef REORDER_H
+#define REORDER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "packet.h"
+
+#define REORDER_STORED 0     /**< reorder_insert() buffered the packet. */
+#define REORDER_DUPLICATE 1  /**< reorder_insert() found the packet already buffered. */
+#define REORDER_OUTSIDE (-1) /**< reorder_insert() got a packet outside the window. */
+
+/**
+ * @struct reorder_buffer
+ * @brief Packets buffered beyond the next expected sequence number.
+ */
+typedef struct reorder_buffer {
+    uint32_t window;     /**< Number of slots, the agreed window size. */
+    size_t slot_size;    /**< Largest payload a slot holds. */
+    unsigned char* pool; /**< window slots of slot_size bytes, preallocated; NULL if slot_size is 0. */
+    uint16_t* lengths;   /**< Payload length of each slot; NULL if slot_size is 0. */
+    uint64_t* occupied;  /**< One bit per slot, set while the slot holds a packet. */
+    unsigned int count;  /**< Number of packets buffered. */
+} reorder_buffer_t;
+
+/**
+ * @brief Allocates an empty reorder window.
+ *
+ * @param reorder The reorder window to initialize.
+ * @param window Number of slots.
+ * @param slot_size Largest payload of a packet, or 0 to only track which packets arrived.
+ * @return 0 on success, -1 if the slots could not be allocated.
+ */
+int reorder_init(reorder_buffer_t* reorder, uint32_t window, size_t slot_size);
+
+/**
+ * @brief Frees the slots of a reorder window.
+ *
+ * @param reorder The reorder window.
+ */
+void reorder_free(reorder_buffer_t* reorder);
+
+/**
+ * @brief Copies a packet received ahead of the next expected one into its slot.
+ *
+ * @param reorder The reorder window.
+ * @param expected The next sequence number expected in order.
+ * @param seq Sequence number of the packet, above expected.
+ * @param data Payload of the packet, ignored when slot_size is 0.
+ * @param len Length of the payload, at most slot_size.
+ * @return REORDER_STORED, REORDER_DUPLICATE, or REORDER_OUTSIDE if seq is not within the window.
+ */
+int reorder_insert(reorder_buffer_t* reorder, uint32_t expected, uint32_t seq, const unsigned char* data, size_t len);
+
+/**
+ * @brief Forgets the packet with sequence number seq, if it arrived.
+ *
+ * @param reorder The reorder window.
+ * @param seq The next sequence number expected in order.
+ * @return true if seq had arrived.
+ */
+bool reorder_remove(reorder_buffer_t* reorder, uint32_t seq);
+
+/**
+ * @brief Takes the packet with sequence number seq out of the window, if it is buffered.
+ *
+ * @param reorder The reorder window, with slot_size above 0.
+ * @param seq The next sequence number expected in order.
+ * @param len Set to the payload length of the packet.
+ * @return The payload, valid until the next reorder_insert(), or NULL if seq is not buffered.
+ */
+const unsigned char* reorder_take(reorder_buffer_t* reorder, uint32_t seq, size_t* len);
+
+/**
+ * @brief Describes the lowest ranges of buffered packets as SACK blocks.
+ *
+ * The lowest ranges border the holes the sender should fill first.
+ *
+ * @param reorder The reorder window.
+ * @param expected The next sequence number expected in order.
+ * @param blocks Destination array.
+ * @param max_blocks Capacity of blocks.
+ * @return The number of blocks written.
+ */
+size_t reorder_encode_sack(const reorder_buffer_t* reorder, uint32_t expected, sack_block_t* blocks, size_t max_blocks);
+
+#endif
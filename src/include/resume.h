@@ -0,0 +1,233 @@
+/**
+ * @file resume.h
+ * @brief Resuming interrupted transfers: the receiver's checkpoint of the blocks of a file it
+ * wrote, and the packets a connection still has to carry.
+ * @author Connor Johst - cjohst & Aaditya Suri - AadityaSuri
+ * @bug No known bugs
+ *
+ * The receiver tracks the output file in blocks of RESUME_BLOCK_SZ bytes. A block is done once
+ * every byte of it has been written, and the bitmap of done blocks is saved next to the output
+ * file, after the data it covers has been synced, so a transfer cut short by a timeout, a signal
+ * or a crash leaves a record of what arrived. The checkpoint names the file it belongs to by its
+ * size and version (its modification time at the sender), so it is only ever applied to the same
+ * contents.
+ *
+ * When a stripe is set up again, its sender fetches the bitmap of the blocks the stripe covers and
+ * both sides skip the packets of the stripe that only hold bytes of done blocks, or of any other
+ * byte ranges the receiver can do without (see delta.h). The packets left are numbered 0, 1, 2...
+ * on the connection as if they were the whole stripe (see resume_map_t), so windows,
+ * acknowledgments, parity groups and digests work on them unchanged; only the offset a packet is
+ * read from and written to goes through the map.
+ */
+
+#ifndef RESUME_H
+#define RESUME_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#define RESUME_BLOCK_SZ 65536 /**< Bytes of the file tracked by one bit of a checkpoint. */
+
+/**
+ * @struct checkpoint
+ * @brief The blocks of one output file written so far. Safe to use from several threads.
+ */
+typedef struct checkpoint {
+    char* path;             /**< The checkpoint file. */
+    uint64_t file_size;     /**< Size of the file the blocks belong to, 0 before checkpoint_reset(). */
+    uint64_t file_version;  /**< Version of the file the blocks belong to. */
+    uint64_t num_blocks;    /**< Blocks of the file. */
+    uint64_t blocks_done;   /**< Blocks whose bytes were all written. */
+    uint8_t* done;          /**< One bit per block, set once the block is done. */
+    uint32_t* received;     /**< Bytes written of each block that is not done, since it was loaded. */
+    bool dirty;             /**< Whether blocks were done since the last save. */
+    pthread_mutex_t lock;   /**< Guards the fields above. */
+    pthread_mutex_t save_lock; /**< Held while the checkpoint is being saved. */
+} checkpoint_t;
+
+/**
+ * @struct byte_range
+ * @brief Bytes [start, end) of a file.
+ */
+typedef struct byte_range {
+    uint64_t start; /**< Offset of the first byte. */
+    uint64_t end;   /**< Offset one past the last byte. */
+} byte_range_t;
+
+/**
+ * @struct byte_ranges
+ * @brief A growable list of byte ranges.
+ */
+typedef struct byte_ranges {
+    byte_range_t* ranges; /**< The ranges. */
+    size_t count;         /**< Number of ranges. */
+    size_t capacity;      /**< Number of ranges allocated. */
+} byte_ranges_t;
+
+/**
+ * @struct resume_map
+ * @brief The packets of a stripe a connection carries, as runs of consecutive packets.
+ *
+ * Packet i of the stripe holds its bytes [i * payload_size, (i + 1) * payload_size). The packets
+ * carried are numbered in stripe order; runs[r] starts at packet firsts[r] of the stripe and is
+ * carried as packets starts[r] to starts[r + 1] - 1.
+ */
+typedef struct resume_map {
+    uint32_t* firsts;  /**< First packet of the stripe of each run. */
+    uint32_t* starts;  /**< First packet carried of each run, with the number of packets carried last. */
+    size_t runs;       /**< Number of runs. */
+    uint64_t bytes;    /**< Bytes the packets carried hold. */
+} resume_map_t;
+
+/**
+ * @brief Loads the checkpoint saved at path, or starts an empty one if there is none or it is
+ * damaged.
+ *
+ * @param checkpoint The checkpoint.
+ * @param path The checkpoint file.
+ * @return 0 on success, -1 if memory runs out.
+ */
+int checkpoint_open(checkpoint_t* checkpoint, const char* path);
+
+/**
+ * @brief Checks whether the checkpoint belongs to a file.
+ *
+ * @param checkpoint The checkpoint.
+ * @param file_size Size of the file.
+ * @param file_version Version of the file.
+ * @return true if the blocks done are blocks of that file.
+ */
+bool checkpoint_matches(checkpoint_t* checkpoint, uint64_t file_size, uint64_t file_version);
+
+/**
+ * @brief Forgets every block and starts over for a file.
+ *
+ * @param checkpoint The checkpoint.
+ * @param file_size Size of the file.
+ * @param file_version Version of the file.
+ * @return 0 on success, -1 if memory runs out.
+ */
+int checkpoint_reset(checkpoint_t* checkpoint, uint64_t file_size, uint64_t file_version);
+
+/**
+ * @brief Records that bytes of the file were written. Each byte must be recorded once.
+ *
+ * @param checkpoint The checkpoint.
+ * @param offset Offset of the bytes in the file.
+ * @param len Number of bytes.
+ */
+void checkpoint_mark(checkpoint_t* checkpoint, uint64_t offset, uint64_t len);
+
+/**
+ * @brief Copies the bits of the blocks covering a byte range of the file.
+ *
+ * @param checkpoint The checkpoint.
+ * @param offset Offset of the range.
+ * @param len Length of the range.
+ * @param bits Receives one bit per block from the block holding offset, (blocks + 7) / 8 bytes.
+ * @return The bytes of the range in done blocks.
+ */
+uint64_t checkpoint_snapshot(checkpoint_t* checkpoint, uint64_t offset, uint64_t len, uint8_t* bits);
+
+/**
+ * @brief Checks whether every block of the file is done.
+ *
+ * @param checkpoint The checkpoint.
+ * @return true if the whole file was written.
+ */
+bool checkpoint_complete(checkpoint_t* checkpoint);
+
+/**
+ * @brief Saves the checkpoint if blocks were done since the last save: syncs the file the blocks
+ * were written to, then replaces the checkpoint file. Returns at once if another thread is saving.
+ *
+ * @param checkpoint The checkpoint.
+ * @param data_fd The file the blocks were written to.
+ * @return 0 on success, -1 on error.
+ */
+int checkpoint_save(checkpoint_t* checkpoint, int data_fd);
+
+/**
+ * @brief Deletes the checkpoint file, once the file is complete or not worth resuming.
+ *
+ * @param checkpoint The checkpoint.
+ */
+void checkpoint_remove(checkpoint_t* checkpoint);
+
+/**
+ * @brief Releases the memory of a checkpoint.
+ *
+ * @param checkpoint The checkpoint.
+ */
+void checkpoint_free(checkpoint_t* checkpoint);
+
+/**
+ * @brief Appends a range to a list.
+ *
+ * @param list The list, zeroed when empty.
+ * @param start Offset of the first byte.
+ * @param end Offset one past the last byte.
+ * @return 0 on success, -1 if memory runs out.
+ */
+int byte_ranges_add(byte_ranges_t* list, uint64_t start, uint64_t end);
+
+/**
+ * @brief Releases the memory of a list.
+ *
+ * @param list The list.
+ */
+void byte_ranges_free(byte_ranges_t* list);
+
+/**
+ * @brief Returns the number of blocks covering a byte range of a file.
+ *
+ * @param offset Offset of the range.
+ * @param len Length of the range.
+ * @return The number of blocks, counted from the block holding offset.
+ */
+uint64_t resume_blocks(uint64_t offset, uint64_t len);
+
+/**
+ * @brief Adds the bytes of a stripe in done blocks to a list of ranges.
+ *
+ * @param list The list.
+ * @param present Bits of the blocks covering the stripe (see checkpoint_snapshot()).
+ * @param offset Offset of the stripe in the file.
+ * @param total_bytes Length of the stripe.
+ * @return 0 on success, -1 if memory runs out.
+ */
+int resume_present_ranges(byte_ranges_t* list, const uint8_t* present, uint64_t offset, uint64_t total_bytes);
+
+/**
+ * @brief Builds the map of the packets of a stripe holding bytes the receiver does not have.
+ *
+ * @param map The map.
+ * @param covered Ranges of the file the receiver has, in any order, possibly overlapping; sorted
+ * and merged in place. NULL to carry every packet.
+ * @param offset Offset of the stripe in the file.
+ * @param total_bytes Length of the stripe.
+ * @param payload_size Bytes of data per packet.
+ * @return 0 on success, -1 if memory runs out.
+ */
+int resume_map_build(resume_map_t* map, byte_ranges_t* covered, uint64_t offset, uint64_t total_bytes,
+                     uint32_t payload_size);
+
+/**
+ * @brief Returns the packet of the stripe a packet carried holds.
+ *
+ * @param map The map.
+ * @param seq Number of the packet carried.
+ * @return Number of the packet of the stripe.
+ */
+uint32_t resume_map_packet(const resume_map_t* map, uint32_t seq);
+
+/**
+ * @brief Releases the memory of a map. A zeroed map may be freed too.
+ *
+ * @param map The map.
+ */
+void resume_map_free(resume_map_t* map);
+
+#endif
@@ -0,0 +1,58 @@
+/**
+ * @file rtt.h
+ * @brief Round trip time estimation and retransmission timeout calculation (RFC 6298).
+ * @author Connor Johst - cjohst & Aaditya Suri - AadityaSuri
+ * @bug No known bugs
+ */
+
+#ifndef RTT_H
+#define RTT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define RTO_INITIAL_US 150000 /**< RTO used before the first RTT sample, the old fixed ACK timeout. */
+#define RTO_MIN_US 5000       /**< Lower bound on the RTO in microseconds. */
+#define RTO_MAX_US 2000000    /**< Upper bound on the RTO (including backoff) in microseconds. */
+#define RTO_GRANULARITY_US 1000 /**< Clock granularity term G of RFC 6298. */
+
+/**
+ * @struct rtt_estimator
+ * @brief Smoothed RTT state and the current retransmission timeout.
+ */
+typedef struct rtt_estimator {
+    uint64_t srtt;       /**< Smoothed round trip time in microseconds. */
+    uint64_t rttvar;     /**< Round trip time variance in microseconds. */
+    uint64_t min_rtt;    /**< Smallest RTT sample seen in microseconds. */
+    uint64_t rto;        /**< Current retransmission timeout in microseconds, including backoff. */
+    unsigned int backoff; /**< Number of consecutive timeouts since the last valid sample. */
+    bool has_sample;     /**< Whether at least one RTT sample has been taken. */
+    uint64_t max_ack_delay; /**< Longest the peer holds an ACK back in microseconds, added to the RTO. */
+} rtt_estimator_t;
+
+/**
+ * @brief Initializes an RTT estimator with the initial RTO.
+ *
+ * @param rtt The estimator to initialize.
+ */
+void rtt_init(rtt_estimator_t* rtt);
+
+/**
+ * @brief Feeds a new RTT measurement into the estimator and recomputes the RTO.
+ *
+ * Callers must follow Karn's rule and only pass samples from packets that were never retransmitted.
+ * A valid sample also clears any exponential backoff.
+ *
+ * @param rtt The estimator.
+ * @param sample_us The measured round trip time in microseconds.
+ */
+void rtt_sample(rtt_estimator_t* rtt, uint64_t sample_us);
+
+/**
+ * @brief Doubles the RTO after a retransmission timeout, up to RTO_MAX_US.
+ *
+ * @param rtt The estimator.
+ */
+void rtt_backoff(rtt_estimator_t* rtt);
+
+#endif
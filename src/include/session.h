@@ -0,0 +1,132 @@
+/**
+ * @file session.h
+ * @brief Per-transfer state of the receiver and the table finding it by connection ID.
+ * @author Connor Johst - cjohst & Aaditya Suri - AadityaSuri
+ * @bug No known bugs
+ *
+ * Every packet carries the connection ID its sender picked, so one receiver socket serves any
+ * number of transfers at once. The table is a chained hash table that doubles its buckets whenever
+ * it holds more sessions than buckets, so finding a session stays O(1) with thousands of them.
+ */
+
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <netinet/in.h>
+
+#include "packet.h"
+#include "reorder.h"
+#include "ackpolicy.h"
+#include "timerwheel.h"
+#include "output.h"
+#include "crc32c.h"
+#include "fec.h"
+#include "resume.h"
+#include "compress.h"
+
+/**
+ * @enum session_state
+ * @brief Where a session is in its lifecycle. A session is created established by the SYN setting
+ * it up; the FIN moves it to SESSION_TIME_WAIT, in which it only answers repeated FINs until the
+ * sender acknowledges the FIN-ACK or the linger runs out.
+ */
+typedef enum session_state {
+    SESSION_ESTABLISHED, /**< Set up, receiving data. */
+    SESSION_TIME_WAIT,   /**< Finished, lingering for the sender's acknowledgment of the FIN-ACK. */
+} session_state_t;
+
+/**
+ * @struct session
+ * @brief State of one transfer.
+ */
+typedef struct session {
+    uint32_t conn_id;               /**< Connection ID of the transfer. */
+    struct sockaddr_in client_addr; /**< Address the sender's packets come from. */
+    session_state_t state;          /**< Where the session is in its lifecycle. */
+    setup_t agreed;                 /**< Parameters agreed on in the setup exchange. */
+    bool positional;                /**< Whether packets are written at their offset as they arrive. */
+    bool compressed;                /**< Whether the connection carries a compressed stream (see compress.h). */
+    reorder_buffer_t reorder;       /**< Packets received beyond expected_sequence. */
+    ack_policy_t ack_policy;        /**< Delayed ACK state. */
+    uint32_t expected_sequence;     /**< Next sequence number expected in order. */
+    uint64_t bytes_written;         /**< Payload bytes handed to the output file. */
+    crc32c_digest_t digest;         /**< CRC32C of the payload bytes received so far. */
+    fec_decoder_t fec;              /**< Rebuilds lost packets from parity packets, if the sender sends any. */
+    resume_map_t map;               /**< Packets of the stripe the connection carries. */
+    uint8_t* present;               /**< Blocks of the stripe received before the transfer was set up, NULL if none. */
+    size_t present_len;             /**< Bytes of the present bitmap. */
+    unsigned char* match_table;     /**< Chunks of the sender's delta_match_t table received so far, NULL before the first. */
+    uint32_t match_len;             /**< Bytes of the match table. */
+    uint8_t* match_chunks;          /**< One bit per chunk of the match table, set once it arrived. */
+    uint32_t match_missing;         /**< Chunks of the match table still to arrive. */
+    decompressor_t decompressor;    /**< Decompresses the stream of a compressed connection, taken in order. */
+    uint64_t stream_received;       /**< Bytes of the compressed stream taken in order so far. */
+    uint64_t raw_received;          /**< Bytes of the packets of the stripe decompressed so far. */
+    uint64_t last_receive_time;     /**< Time the last packet arrived, in microseconds. */
+    uint64_t window_update_time;    /**< Time to check whether the closed receive window reopened, 0 while it is open. */
+    uint64_t linger_deadline;       /**< In SESSION_TIME_WAIT, time the session ends if it is not acknowledged. */
+    uint32_t fin_digest;            /**< In SESSION_TIME_WAIT, the digest its FIN-ACKs carry. */
+    output_file_t* output;          /**< The file the transfer is written to. */
+    timer_node_t timer;             /**< Fires at the delayed ACK deadline, the window update, the inactivity timeout or the linger deadline. */
+    struct session* next;           /**< Next session in the same bucket. */
+} session_t;
+
+#define session_of_timer(node) ((session_t*) ((char*) (node) - offsetof(session_t, timer)))
+
+/**
+ * @struct session_table
+ * @brief Sessions hashed by connection ID.
+ */
+typedef struct session_table {
+    session_t** buckets; /**< Chains of sessions. */
+    size_t num_buckets;  /**< Number of buckets, a power of two. */
+    size_t count;        /**< Number of sessions. */
+} session_table_t;
+
+/**
+ * @brief Initializes an empty session table.
+ *
+ * @param table The table to initialize.
+ * @param num_buckets Initial number of buckets, rounded up to a power of two.
+ * @return 0 on success, -1 if the buckets could not be allocated.
+ */
+int session_table_init(session_table_t* table, size_t num_buckets);
+
+/**
+ * @brief Destroys every session left in the table and releases its buckets.
+ *
+ * @param table The table.
+ */
+void session_table_free(session_table_t* table);
+
+/**
+ * @brief Finds the session of a connection.
+ *
+ * @param table The table.
+ * @param conn_id The connection ID.
+ * @return The session, or NULL if there is none.
+ */
+session_t* session_find(const session_table_t* table, uint32_t conn_id);
+
+/**
+ * @brief Adds a zeroed session for a connection to the table.
+ *
+ * @param table The table.
+ * @param conn_id The connection ID, not yet in the table.
+ * @return The session, or NULL if it could not be allocated.
+ */
+session_t* session_create(session_table_t* table, uint32_t conn_id);
+
+/**
+ * @brief Removes a session from the table, releasing its reorder window, its maps, its decompressor
+ * and its reference to the output file. Its timer must not be armed.
+ *
+ * @param table The table.
+ * @param session The session.
+ */
+void session_destroy(session_table_t* table, session_t* session);
+
+#endif
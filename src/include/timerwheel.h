@@ -0,0 +1,104 @@
+/**
+ * @file timerwheel.h
+ * @brief Hashed timer wheel holding the retransmission timers of outstanding packets.
+ * @author Connor Johst - cjohst & Aaditya Suri - AadityaSuri
+ * @bug No known bugs
+ */
+
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define TIMER_WHEEL_NO_TIMER UINT64_MAX /**< Returned by timer_wheel_next_expiry() when nothing is armed. */
+#define TIMER_WHEEL_MAX_SLOTS 4096 /**< Largest wheel, one bit per slot in 64 words of 64 bits. */
+
+/**
+ * @struct timer_node
+ * @brief A timer embedded in the object it belongs to. Nodes are linked into the wheel's slots.
+ */
+typedef struct timer_node {
+    struct timer_node* next; /**< Next node in the slot, or in the list returned by timer_wheel_expire(). */
+    struct timer_node* prev; /**< Previous node in the slot. */
+    uint64_t deadline;       /**< Absolute expiry time in microseconds. */
+    uint64_t tick;           /**< Wheel tick at which the timer fires. */
+    bool armed;              /**< Whether the node is currently linked into the wheel. */
+} timer_node_t;
+
+/**
+ * @struct timer_wheel
+ * @brief Hashed timer wheel: a circular array of slots, each a doubly linked list of timers.
+ *
+ * Arming and cancelling are O(1). Expiring only visits the slots of ticks that have elapsed, so
+ * the cost does not depend on how many timers are armed for later ticks. A bitmap of the
+ * non-empty slots, summarized by one bit per word, finds the next occupied slot in O(1).
+ */
+typedef struct timer_wheel {
+    timer_node_t* slots;   /**< Sentinel heads of the circular slot lists. */
+    size_t num_slots;      /**< Number of slots, a power of two. */
+    uint64_t tick_us;      /**< Duration of one tick in microseconds. */
+    uint64_t current_tick; /**< Last tick that has been fully processed. */
+    size_t armed_count;    /**< Number of armed timers. */
+    uint64_t occupied[TIMER_WHEEL_MAX_SLOTS / 64]; /**< Bit i % 64 of word i / 64 is set if slot i holds a timer. */
+    uint64_t occupied_words; /**< Bit w is set if occupied[w] is not zero. */
+} timer_wheel_t;
+
+/**
+ * @brief Initializes a timer wheel.
+ *
+ * @param wheel The wheel to initialize.
+ * @param num_slots The number of slots, rounded up to a power of two, at most TIMER_WHEEL_MAX_SLOTS.
+ * @param tick_us The resolution of the wheel in microseconds.
+ * @param now The current time in microseconds.
+ * @return 0 on success, -1 if there are too many slots or they could not be allocated.
+ */
+int timer_wheel_init(timer_wheel_t* wheel, size_t num_slots, uint64_t tick_us, uint64_t now);
+
+/**
+ * @brief Releases the slots of a timer wheel. Armed nodes are simply forgotten.
+ *
+ * @param wheel The wheel to free.
+ */
+void timer_wheel_free(timer_wheel_t* wheel);
+
+/**
+ * @brief Arms a timer to fire at the given deadline, re-arming it if it is already armed.
+ *
+ * @param wheel The wheel.
+ * @param node The timer to arm.
+ * @param deadline The absolute expiry time in microseconds.
+ */
+void timer_wheel_arm(timer_wheel_t* wheel, timer_node_t* node, uint64_t deadline);
+
+/**
+ * @brief Cancels a timer. Cancelling a timer that is not armed does nothing.
+ *
+ * @param wheel The wheel.
+ * @param node The timer to cancel.
+ */
+void timer_wheel_cancel(timer_wheel_t* wheel, timer_node_t* node);
+
+/**
+ * @brief Removes every timer whose deadline has passed.
+ *
+ * The expired timers are disarmed and returned as a list chained through their next pointers,
+ * so the caller may re-arm each of them while walking the list (after saving next).
+ *
+ * @param wheel The wheel.
+ * @param now The current time in microseconds.
+ * @return The first expired timer, or NULL if none expired.
+ */
+timer_node_t* timer_wheel_expire(timer_wheel_t* wheel, uint64_t now);
+
+/**
+ * @brief Returns a time at or before which the next armed timer fires: the tick of the next
+ * occupied slot, which is early only if that slot holds nothing but timers of a later rotation.
+ *
+ * @param wheel The wheel.
+ * @return The time in microseconds, or TIMER_WHEEL_NO_TIMER if nothing is armed.
+ */
+uint64_t timer_wheel_next_expiry(const timer_wheel_t* wheel);
+
+#endif
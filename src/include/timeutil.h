@@ -0,0 +1,36 @@
+/**
+ * @file timeutil.h
+ * @brief Monotonic clock helpers shared by the sender and receiver.
+ * @author Connor Johst - cjohst & Aaditya Suri - AadityaSuri
+ * @bug No known bugs
+ */
+
+#ifndef TIMEUTIL_H
+#define TIMEUTIL_H
+
+#include <stdint.h>
+#include <sys/time.h>
+
+/**
+ * @brief Returns the current CLOCK_MONOTONIC time in microseconds.
+ *
+ * @return Microseconds since an arbitrary, fixed point in the past.
+ */
+uint64_t now_usec(void);
+
+/**
+ * @brief Returns the current CLOCK_MONOTONIC time in nanoseconds.
+ *
+ * @return Nanoseconds since an arbitrary, fixed point in the past.
+ */
+uint64_t now_nsec(void);
+
+/**
+ * @brief Converts a duration in microseconds to a timeval suitable for select().
+ *
+ * @param usec The duration in microseconds.
+ * @return The equivalent timeval.
+ */
+struct timeval usec_to_timeval(uint64_t usec);
+
+#endif
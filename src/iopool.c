@@ -0,0 +1,165 @@
+/**
+ * @file iopool.c
+ * @brief Worker threads writing received payloads to their output files off the receive loop.
+ * @author Connor Johst - cjohst & Aaditya Suri - AadityaSuri
+ * @bug A failed write terminates the program, as it does on the receive loop.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "iopool.h"
+
+/**
+ * @brief Writes a payload to its file, terminating the program if the write fails.
+ *
+ * @param file The file.
+ * @param offset Offset of the payload in the file.
+ * @param data The payload.
+ * @param len Length of the payload.
+ */
+
+static void io_write(output_file_t* file, uint64_t offset, const void* data, size_t len){
+    if (output_write_at(file, offset, data, len) < 0){
+        fprintf(stderr, "Output file write failed: %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * @brief Body of a worker: takes jobs off the queue and writes them until the pool stops.
+ *
+ * @param arg The pool.
+ * @return NULL.
+ */
+
+static void* io_worker(void* arg){
+    io_pool_t* pool = (io_pool_t*) arg;
+    for (;;){
+        pthread_mutex_lock(&pool->lock);
+        while (pool->head == NULL && !pool->stopping){
+            pthread_cond_wait(&pool->not_empty, &pool->lock);
+        }
+        io_job_t* job = pool->head;
+        if (job == NULL){
+            // stopping and nothing left to write
+            pthread_mutex_unlock(&pool->lock);
+            return NULL;
+        }
+        pool->head = job->next;
+        if (pool->head == NULL){
+            pool->tail = NULL;
+        }
+        pool->queued--;
+        pthread_cond_signal(&pool->not_full);
+        pthread_mutex_unlock(&pool->lock);
+
+        io_write(job->file, job->offset, job->data, job->len);
+        output_count_pending(job->file, job->len, false);
+        output_release(job->file);
+        free(job);
+    }
+}
+
+/**
+ * @brief Starts the worker threads.
+ *
+ * @param pool The pool to initialize.
+ * @param num_threads Number of workers; 0 makes io_pool_submit() write in the calling thread.
+ * @return 0 on success, -1 if the workers could not be started.
+ */
+
+int io_pool_init(io_pool_t* pool, unsigned int num_threads){
+    memset(pool, 0, sizeof(*pool));
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->not_empty, NULL);
+    pthread_cond_init(&pool->not_full, NULL);
+    if (num_threads == 0){
+        return 0;
+    }
+
+    pool->threads = (pthread_t*) calloc(num_threads, sizeof(pthread_t));
+    if (pool->threads == NULL){
+        return -1;
+    }
+    for (unsigned int i = 0; i < num_threads; i++){
+        if (pthread_create(&pool->threads[i], NULL, io_worker, pool) != 0){
+            io_pool_free(pool);
+            return -1;
+        }
+        pool->num_threads++;
+    }
+    return 0;
+}
+
+/**
+ * @brief Queues a payload to be written at an offset of a file.
+ *
+ * @param pool The pool.
+ * @param file The file to write to.
+ * @param offset Offset of the payload in the file.
+ * @param data The payload, copied before the call returns.
+ * @param len Length of the payload.
+ */
+
+void io_pool_submit(io_pool_t* pool, output_file_t* file, uint64_t offset, const void* data, size_t len){
+    if (pool->num_threads == 0){
+        io_write(file, offset, data, len);
+        return;
+    }
+
+    io_job_t* job = (io_job_t*) malloc(sizeof(io_job_t) + len);
+    if (job == NULL){
+        // no memory to queue the write, make it here instead
+        io_write(file, offset, data, len);
+        return;
+    }
+    job->next = NULL;
+    job->file = file;
+    job->offset = offset;
+    job->len = len;
+    memcpy(job->data, data, len);
+    output_retain(file);
+    output_count_pending(file, len, true);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->queued >= IO_POOL_MAX_JOBS){
+        pthread_cond_wait(&pool->not_full, &pool->lock);
+    }
+    if (pool->tail != NULL){
+        pool->tail->next = job;
+    }
+    else{
+        pool->head = job;
+    }
+    pool->tail = job;
+    pool->queued++;
+    pthread_cond_signal(&pool->not_empty);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/**
+ * @brief Writes every queued payload, then stops the workers.
+ *
+ * @param pool The pool.
+ */
+
+void io_pool_free(io_pool_t* pool){
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->not_empty);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (unsigned int i = 0; i < pool->num_threads; i++){
+        pthread_join(pool->threads[i], NULL);
+    }
+    free(pool->threads);
+    pool->threads = NULL;
+    pool->num_threads = 0;
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->not_empty);
+    pthread_cond_destroy(&pool->not_full);
+}
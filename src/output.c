@@ -0,0 +1,195 @@
+/**
+ * @file output.c
+ * @brief Output file of one transfer, written in order through stdio or at packet offsets.
+ * @author Connor Johst - cjohst & Aaditya Suri - AadityaSuri
+ * @bug No known bugs
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "output.h"
+#include "timeutil.h"
+
+/**
+ * @brief Opens an output file, creating it if needed, holding one reference for the caller.
+ *
+ * @param path The file to write.
+ * @param write_rate Bytes per second written to the file, 0 for no limit.
+ * @param truncate Whether to empty the file. Files written at offsets by several connections are
+ * not truncated, so a stripe set up after another one ended cannot wipe out its data.
+ * @return The file, or NULL if it could not be opened.
+ */
+
+output_file_t* output_open(const char* path, uint64_t write_rate, bool truncate){
+    output_file_t* file = (output_file_t*) malloc(sizeof(output_file_t));
+    if (file == NULL){
+        return NULL;
+    }
+    int fd = open(path, O_WRONLY | O_CREAT | (truncate ? O_TRUNC : 0), 0644);
+    file->stream = fd < 0 ? NULL : fdopen(fd, "w");
+    if (file->stream == NULL){
+        if (fd >= 0){
+            close(fd);
+        }
+        free(file);
+        return NULL;
+    }
+    setvbuf(file->stream, NULL, _IOFBF, OUTPUT_BUFFER_SZ);
+    file->fd = fileno(file->stream);
+    rate_limiter_init(&file->limiter, write_rate, OUTPUT_RATE_BURST_NS);
+    pthread_mutex_init(&file->lock, NULL);
+    file->refs = 1;
+    file->pending = 0;
+    file->checkpoint = NULL;
+    return file;
+}
+
+/**
+ * @brief Sizes the file for the whole transfer, so writes at offsets never extend it, and cuts
+ * off anything an earlier file of the same name left beyond it.
+ *
+ * @param file The file.
+ * @param total_bytes Size of the transfer.
+ * @return 0 on success, -1 on error.
+ */
+
+int output_preallocate(output_file_t* file, uint64_t total_bytes){
+    // file systems without fallocate() still get the right size, just without reserved blocks
+    if (total_bytes > 0){
+        fallocate(file->fd, 0, 0, total_bytes);
+    }
+    return ftruncate(file->fd, total_bytes);
+}
+
+/**
+ * @brief Waits until len more bytes fit within the write rate of the file.
+ *
+ * @param file The file.
+ * @param len Number of bytes about to be written.
+ */
+
+static void output_wait(output_file_t* file, size_t len){
+    if (file->limiter.rate == 0){
+        return;
+    }
+    // writers of the same file queue up behind the one paying back the bucket's debt
+    pthread_mutex_lock(&file->lock);
+    rate_limiter_wait(&file->limiter, len);
+    pthread_mutex_unlock(&file->lock);
+}
+
+/**
+ * @brief Appends data through the stdio buffer after waiting for the write rate.
+ *
+ * @param file The file.
+ * @param data The data.
+ * @param len Length of the data.
+ * @return The number of bytes written.
+ */
+
+size_t output_append(output_file_t* file, const void* data, size_t len){
+    output_wait(file, len);
+    return fwrite(data, 1, len, file->stream);
+}
+
+/**
+ * @brief Writes data at an offset with pwrite() after waiting for the write rate, and records it in
+ * the checkpoint of the file if it has one. Safe to call from several threads.
+ *
+ * @param file The file.
+ * @param offset Offset of the data in the file.
+ * @param data The data.
+ * @param len Length of the data.
+ * @return len on success, -1 on error.
+ */
+
+ssize_t output_write_at(output_file_t* file, uint64_t offset, const void* data, size_t len){
+    output_wait(file, len);
+    size_t written = 0;
+    while (written < len){
+        ssize_t n = pwrite(file->fd, (const unsigned char*) data + written, len - written, offset + written);
+        if (n < 0 && errno == EINTR){
+            continue;
+        }
+        if (n <= 0){
+            return -1;
+        }
+        written += n;
+    }
+    if (file->checkpoint != NULL){
+        checkpoint_mark(file->checkpoint, offset, len);
+    }
+    return written;
+}
+
+/**
+ * @brief Takes another reference to the file.
+ *
+ * @param file The file.
+ */
+
+void output_retain(output_file_t* file){
+    pthread_mutex_lock(&file->lock);
+    file->refs++;
+    pthread_mutex_unlock(&file->lock);
+}
+
+/**
+ * @brief Counts bytes queued for the file by an I/O pool, or written by one of its workers.
+ *
+ * @param file The file.
+ * @param len Number of bytes.
+ * @param queued Whether they were queued rather than written.
+ */
+
+void output_count_pending(output_file_t* file, size_t len, bool queued){
+    pthread_mutex_lock(&file->lock);
+    if (queued){
+        file->pending += len;
+    }
+    else{
+        file->pending -= len;
+    }
+    pthread_mutex_unlock(&file->lock);
+}
+
+/**
+ * @brief Returns the bytes the file takes before a writer has to wait: the tokens of its write
+ * rate, less the bytes queued for I/O pool workers. Without a write rate only the queued bytes
+ * count.
+ *
+ * @param file The file.
+ * @return The number of bytes, negative while writes are behind.
+ */
+
+int64_t output_room(output_file_t* file){
+    pthread_mutex_lock(&file->lock);
+    int64_t room = (file->limiter.rate > 0 ? rate_limiter_tokens(&file->limiter, now_nsec()) : 0) - (int64_t) file->pending;
+    pthread_mutex_unlock(&file->lock);
+    return room;
+}
+
+/**
+ * @brief Drops a reference to the file, closing it when it was the last one.
+ *
+ * @param file The file.
+ */
+
+void output_release(output_file_t* file){
+    pthread_mutex_lock(&file->lock);
+    unsigned int refs = --file->refs;
+    pthread_mutex_unlock(&file->lock);
+    if (refs > 0){
+        return;
+    }
+    fclose(file->stream);
+    pthread_mutex_destroy(&file->lock);
+    free(file);
+}
@@ -0,0 +1,117 @@
+/**
+ * @file pacer.c
+ * @brief Sender pacing: spreads transmissions at the congestion controller's pacing rate instead
+ * of sending a window's worth of packets back-to-back.
+ * @author Connor Johst - cjohst & Aaditya Suri - AadityaSuri
+ * @bug No known bugs
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+
+#include "pacer.h"
+
+#define PACER_TIMER_SLACK_NS 1000 // Timer slack of the process while pacing in user space.
+
+/**
+ * @brief Initializes an unpaced pacer.
+ *
+ * Pacing in user space relies on select() timeouts of a few microseconds, so the process timer
+ * slack is lowered from the default 50us.
+ *
+ * @param pacer The pacer to initialize.
+ * @param sock_fd The socket packets are sent on.
+ * @param kernel Whether to try kernel pacing (SO_MAX_PACING_RATE, needs the fq qdisc).
+ * @return 0 on success, -1 if kernel pacing was asked for but the socket does not support it; the
+ * pacer then paces in user space.
+ */
+
+int pacer_init(pacer_t* pacer, int sock_fd, bool kernel){
+    pacer->rate = 0;
+    pacer->release_ns = 0;
+    pacer->sock_fd = sock_fd;
+    pacer->kernel = false;
+
+    if (kernel){
+        // probe with "no limit"; the real rate is set once the congestion controller has one
+        uint64_t unlimited = UINT64_MAX;
+        if (setsockopt(sock_fd, SOL_SOCKET, SO_MAX_PACING_RATE, &unlimited, sizeof(unlimited)) == 0){
+            pacer->kernel = true;
+            return 0;
+        }
+    }
+    prctl(PR_SET_TIMERSLACK, PACER_TIMER_SLACK_NS, 0, 0, 0);
+    return kernel ? -1 : 0;
+}
+
+/**
+ * @brief Sets the pacing rate.
+ *
+ * The kernel is only told about changes of more than an eighth, to keep setsockopt() off the
+ * per-ACK path.
+ *
+ * @param pacer The pacer.
+ * @param rate Pacing rate in bytes per second, 0 to stop pacing.
+ */
+
+void pacer_set_rate(pacer_t* pacer, double rate){
+    if (pacer->kernel){
+        double change = rate > pacer->rate ? rate - pacer->rate : pacer->rate - rate;
+        if (change * 8 > pacer->rate){
+            uint64_t kernel_rate = rate > 0 ? (uint64_t) rate : UINT64_MAX;
+            setsockopt(pacer->sock_fd, SOL_SOCKET, SO_MAX_PACING_RATE, &kernel_rate, sizeof(kernel_rate));
+            pacer->rate = rate;
+        }
+        return;
+    }
+    pacer->rate = rate;
+}
+
+/**
+ * @brief Checks whether the next packet may be sent now.
+ *
+ * @param pacer The pacer.
+ * @param now Current time in nanoseconds.
+ * @return true if a packet may be sent.
+ */
+
+bool pacer_ready(const pacer_t* pacer, uint64_t now){
+    return pacer->kernel || pacer->rate <= 0 || pacer->release_ns <= now + PACER_SLACK_NS;
+}
+
+/**
+ * @brief Accounts for a packet that is being sent.
+ *
+ * An idle sender does not bank credit: the release time restarts from now.
+ *
+ * @param pacer The pacer.
+ * @param bytes Size of the packet.
+ * @param now Current time in nanoseconds.
+ */
+
+void pacer_on_send(pacer_t* pacer, size_t bytes, uint64_t now){
+    if (pacer->kernel || pacer->rate <= 0){
+        return;
+    }
+    if (pacer->release_ns < now){
+        pacer->release_ns = now;
+    }
+    pacer->release_ns += (uint64_t) ((double) bytes * 1e9 / pacer->rate);
+}
+
+/**
+ * @brief Returns when the next packet may be sent.
+ *
+ * @param pacer The pacer.
+ * @return The time in nanoseconds, or PACER_NO_WAIT if packets may be sent at once.
+ */
+
+uint64_t pacer_release_time(const pacer_t* pacer){
+    if (pacer->kernel || pacer->rate <= 0 || pacer->release_ns <= PACER_SLACK_NS){
+        return PACER_NO_WAIT;
+    }
+    return pacer->release_ns - PACER_SLACK_NS;
+}
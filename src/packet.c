@@ -7,12 +7,15 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "packet.h"
+#include "crc32c.h"
 
 /**
  * @brief Creates a packet header with the specified parameters.
  * 
+ * @param conn_id The connection the packet belongs to.
  * @param seq_number The sequence number of the packet.
  * @param ack_number The acknowledgment number of the packet.
  * @param length The length of the packet.
@@ -20,14 +23,16 @@
  * @return The created packet header.
  */
 
-header_t create_header(uint32_t seq_number, uint32_t ack_number, uint16_t length, uint16_t flags){
+header_t create_header(uint32_t conn_id, uint32_t seq_number, uint32_t ack_number, uint16_t length, uint16_t flags){
 
     header_t created_header;
     
+    created_header.conn_id = conn_id;
     created_header.seq_num = seq_number;
     created_header.ack_num = ack_number;
     created_header.flags = flags;
     created_header.length = length;
+    created_header.checksum = 0;
     return created_header;
 
 }
@@ -35,21 +40,61 @@ header_t create_header(uint32_t seq_number, uint32_t ack_number, uint16_t length
 /**
  * @brief Creates a packet with the specified data and header.
  * 
- * @param data The data to be included in the packet.
+ * @param packet The buffer to build the packet in, at least PACKET_SIZE(pkt_header.length) bytes
+ * unless data is NULL.
+ * @param data The data to be included in the packet, or NULL for a header-only packet.
  * @param pkt_header The header of the packet.
- * @return The created packet.
  */
 
-packet_t create_packet(unsigned char data[], header_t pkt_header) {
-  packet_t created_packet; 
-  created_packet.header = pkt_header;
-
+void create_packet(packet_t* packet, const unsigned char data[], header_t pkt_header) {
+  packet->header = pkt_header;
 
   if (data){
-    for (size_t i = 0; i < created_packet.header.length; i++) {
-      created_packet.data[i] = data[i];
-    }
+    memcpy(packet->data, data, packet->header.length);
   }
+}
+
+/**
+ * @brief Computes the checksum of a packet from the CRC32C of its payload, so a payload that is
+ * not stored after its header does not need to be copied.
+ *
+ * @param header The header of the packet; its checksum field is ignored.
+ * @param payload_crc crc32c() of the header->length bytes of payload.
+ * @return The value of the checksum field.
+ */
 
-  return created_packet;
+uint32_t packet_checksum(const header_t* header, uint32_t payload_crc){
+  header_t unsealed = *header;
+  unsealed.checksum = 0;
+  return crc32c(payload_crc, &unsealed, sizeof(unsealed));
+}
+
+/**
+ * @brief Sets the checksum of a packet whose payload follows its header.
+ *
+ * @param packet The packet.
+ */
+
+void packet_seal(packet_t* packet){
+  packet->header.checksum = packet_checksum(&packet->header, crc32c(0, packet->data, packet->header.length));
+}
+
+/**
+ * @brief Checks that a received datagram holds a whole packet with a matching checksum.
+ *
+ * @param packet The datagram.
+ * @param len Length of the datagram.
+ * @param payload_crc Set to the CRC32C of the payload if not NULL.
+ * @return true if the packet is intact.
+ */
+
+bool packet_verify(const packet_t* packet, size_t len, uint32_t* payload_crc){
+  if (len < sizeof(header_t) || packet->header.length > len - sizeof(header_t)){
+    return false;
+  }
+  uint32_t crc = crc32c(0, packet->data, packet->header.length);
+  if (payload_crc != NULL){
+    *payload_crc = crc;
+  }
+  return packet_checksum(&packet->header, crc) == packet->header.checksum;
 }
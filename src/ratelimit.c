@@ -0,0 +1,84 @@
+/**
+ * @file ratelimit.c
+ * @brief Token bucket rate limiter on CLOCK_MONOTONIC, used to pace writes to the output file.
+ * @author Connor Johst - cjohst & Aaditya Suri - AadityaSuri
+ * @bug No known bugs
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <errno.h>
+#include <time.h>
+
+#include "ratelimit.h"
+#include "timeutil.h"
+
+/**
+ * @brief Initializes a full token bucket.
+ *
+ * @param limiter The limiter to initialize.
+ * @param rate Bytes per second, 0 for no limit.
+ * @param burst_ns Bucket depth, as the time it takes to fill it.
+ */
+
+void rate_limiter_init(rate_limiter_t* limiter, uint64_t rate, uint64_t burst_ns){
+    limiter->rate = rate;
+    limiter->burst = (double) rate * burst_ns / 1e9;
+    limiter->tokens = limiter->burst;
+    limiter->last_ns = now_nsec();
+}
+
+/**
+ * @brief Adds the tokens accumulated since the last refill.
+ *
+ * @param limiter The limiter.
+ * @param now Current time in nanoseconds.
+ */
+
+static void rate_limiter_refill(rate_limiter_t* limiter, uint64_t now){
+    limiter->tokens += (double) limiter->rate * (now - limiter->last_ns) / 1e9;
+    if (limiter->tokens > limiter->burst){
+        limiter->tokens = limiter->burst;
+    }
+    limiter->last_ns = now;
+}
+
+/**
+ * @brief Sleeps until len bytes may be sent or written, then takes them from the bucket.
+ *
+ * The caller only waits while the bucket is in debt, and sleeps exactly until the debt is paid.
+ *
+ * @param limiter The limiter.
+ * @param len Number of bytes about to be sent or written.
+ */
+
+void rate_limiter_wait(rate_limiter_t* limiter, size_t len){
+    if (limiter->rate == 0){
+        return;
+    }
+
+    rate_limiter_refill(limiter, now_nsec());
+    if (limiter->tokens < 0){
+        uint64_t wake = limiter->last_ns + (uint64_t) (-limiter->tokens * 1e9 / limiter->rate) + 1;
+        struct timespec ts;
+        ts.tv_sec = wake / 1000000000ULL;
+        ts.tv_nsec = wake % 1000000000ULL;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR){
+        }
+        rate_limiter_refill(limiter, now_nsec());
+    }
+    limiter->tokens -= len;
+}
+
+/**
+ * @brief Returns the tokens in the bucket without taking any.
+ *
+ * @param limiter The limiter.
+ * @param now Current time in nanoseconds.
+ * @return The tokens in bytes, negative while the bucket is in debt.
+ */
+
+int64_t rate_limiter_tokens(const rate_limiter_t* limiter, uint64_t now){
+    double tokens = limiter->tokens + (double) limiter->rate * (now - limiter->last_ns) / 1e9;
+    return (int64_t) (tokens < limiter->burst ? tokens : limiter->burst);
+}
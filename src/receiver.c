@@ -18,225 +18,1825 @@
 #include <sys/time.h>
 #include <sys/socket.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <time.h>
 
 #include <pthread.h>
 #include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <inttypes.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
 
 #include "packet.h"
-#include "priorityqueue.h"
+#include "reorder.h"
+#include "ackpolicy.h"
+#include "timeutil.h"
+#include "batchio.h"
+#include "timerwheel.h"
+#include "output.h"
+#include "iopool.h"
+#include "session.h"
+#include "crc32c.h"
+#include "resume.h"
+#include "delta.h"
+#include "compress.h"
 
 #define RECEIVE_TIMEOUT 10 //Terminate the protocol after 10 seconds of inactivity in socket
+#define DEFAULT_FIN_RTO 150000 // RTO assumed for a FIN that does not carry one, in microseconds.
+#define RWND_CHECK_INTERVAL 1000 // Time between two checks of a closed window of a file without a write rate, in microseconds.
+#define DEFAULT_ACK_EVERY 2 // Number of in-order packets acknowledged by one ACK.
+#define DEFAULT_ACK_DELAY 1000 // Longest an ACK is held back, in microseconds.
+#define DEFAULT_MAX_WINDOW 1024 // Largest window, in packets, accepted in the setup exchange.
+#define SESSION_TABLE_SIZE 64 // Initial number of buckets of the session table.
+#define TIMER_WHEEL_SLOTS 1024 // Number of slots in the session timer wheel.
+#define TIMER_WHEEL_TICK 100 // Resolution of the session timer wheel in microseconds.
+#define CHECKPOINT_INTERVAL 1000000 // Time between two saves of the checkpoint with -r, in microseconds.
+
+#define MAX_SOCKETS 64 // Most receive threads, each with its own socket on the port.
+
+#define RECEIVER_USAGE "usage: %s [-a ack_every] [-d ack_delay_us] [-p max_payload] [-w max_window] [-o] [-t io_threads] [-s sockets] [-D] [-r] [-u] UDP_port filename_to_write writerate\n\n"
+
+/**
+ * Options controlling the receiver, set from the command line.
+ */
+struct receiver_options
+{
+    unsigned long long int write_rate; // bytes per second written to each file, 0 for no limit
+    unsigned int ack_every;            // number of in-order packets acknowledged by one ACK
+    uint64_t ack_delay;                // longest an ACK is held back, in microseconds
+    uint32_t max_payload;              // largest payload per packet accepted in the setup exchange
+    uint32_t max_window;               // largest window, in packets, accepted in the setup exchange
+    bool positional;                   // write every packet at its offset as soon as it arrives
+    unsigned int io_threads;           // threads writing packets to disk, 0 to write on the receive loop
+    unsigned int sockets;              // receive threads, each with its own SO_REUSEPORT socket
+    bool daemon;                       // serve transfers into a directory until killed
+    bool resume;                       // checkpoint the output file, so an interrupted transfer resumes
+    bool update;                       // write the file next to the existing copy, which delta transfers reuse
+};
+
+/**
+ * A file being received by a daemon, shared by the sessions of its stripes.
+ */
+struct transfer
+{
+    uint32_t transfer_id;   // connection ID of the first stripe, names the file
+    output_file_t *output;  // the file, referenced by the transfer
+    unsigned int sessions;  // sessions of the transfer currently open
+    struct transfer *next;
+};
+
+/**
+ * State shared by the receive threads.
+ */
+struct receiver_shared
+{
+    const struct receiver_options *options;
+    const char *destination;       // the output file, or the directory of the output files of a daemon
+    io_pool_t io_pool;             // threads writing positional packets
+    int stop_fd;                   // eventfd, readable once every receive thread should stop
+    pthread_mutex_t lock;          // guards the fields below
+    struct transfer *transfers;    // with -D, the files being received
+    output_file_t *single_output;  // without -D, the output file
+    uint32_t single_transfer_id;   // without -D, the transfer being received
+    unsigned int stripes;          // without -D, stripes of that transfer, 0 until it is set up
+    unsigned int stripes_opened;   // without -D, its sessions set up so far
+    unsigned int stripes_closed;   // without -D, its sessions that ended
+    unsigned int stripes_finished; // without -D, its sessions that ended with a FIN
+    bool corrupted;                // a connection ended with a digest that does not match its sender's
+    checkpoint_t checkpoint;       // with -r, the blocks of the output file written so far
+    uint64_t checkpoint_time;      // with -r, time the checkpoint was last saved
+    int copy_fd;                   // with -u, the existing copy of the output file, -1 if there is none
+    delta_signature_t *signatures; // with -u, the signatures of the blocks of that copy
+    uint32_t num_signatures;       // with -u, number of signatures
+    uint32_t block_size;           // with -u, bytes per block signed
+};
+
+/**
+ * State of one receive thread shared by its packet, timer and session paths. Every thread has
+ * its own socket bound to the port with SO_REUSEPORT; the kernel sends all the packets of a
+ * connection to the same socket, so each session lives in exactly one thread.
+ */
+struct receiver
+{
+    struct receiver_shared *shared;
+    const struct receiver_options *options;
+    pthread_t thread;
+    int sock_fd;
+    int epoll_fd;                  // waits on sock_fd, timer_fd and the shared stop_fd
+    int timer_fd;                  // fires at the earliest session timer
+    uint64_t timer_fd_deadline;    // time timer_fd is set to, TIMER_WHEEL_NO_TIMER if disarmed
+    batch_io_t packet_batch;       // packets drained by one recvmmsg()
+    batch_io_t ack_batch;          // ACKs queued for the next sendmmsg()
+    session_table_t sessions;      // transfers in progress, by connection ID
+    uint64_t socket_buffer;        // bytes of datagrams sock_fd holds before the kernel drops them
+    timer_wheel_t wheel;           // one timer per session
+    bool stopping;                 // the thread leaves its loop
+};
+
+static int signal_stop_fd = -1; // stop_fd of the receiver, for the signal handler
+
+/**
+ * @brief Asks the receive threads to stop, so writes still queued to the I/O threads are finished.
+ *
+ * @param signum The signal received.
+ */
+static void request_stop(int signum)
+{
+    (void)signum;
+    uint64_t one = 1;
+    if (write(signal_stop_fd, &one, sizeof(one)) < 0)
+    {
+        // already readable
+    }
+}
+
+/**
+ * @brief Makes stop_fd readable, waking every receive thread to stop.
+ *
+ * @param shared The shared receiver state.
+ */
+static void stop_receivers(struct receiver_shared *shared)
+{
+    uint64_t one = 1;
+    if (write(shared->stop_fd, &one, sizeof(one)) < 0)
+    {
+        fprintf(stderr, "Cannot stop the receive threads: %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * @brief Sends every ACK queued in the batch.
+ *
+ * @param ack_batch The batch of ACKs.
+ * @param sock_fd The socket to send on.
+ */
+static void flush_acks(batch_io_t *ack_batch, int sock_fd)
+{
+    if (ack_batch->count > 0 && batch_flush(ack_batch, sock_fd) < 0)
+    {
+        fprintf(stderr, "Ack send failed: %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * @brief Computes the receive window of a session: the packets from the next expected one on it
+ * can take.
+ *
+ * A file with a write rate only lets in the packets its tokens cover (see output_room()), shared by
+ * the stripes writing it, and no more than the session's share of the socket buffer, so the receive
+ * thread does not sleep on them and their ACKs are not held back. Without a write rate the bytes
+ * queued for I/O pool workers hold slots of the reorder window. A file with nothing waiting always
+ * takes a packet.
+ *
+ * @param receiver The receive thread.
+ * @param session The session.
+ * @param reopen_delay If not NULL, set to the time in microseconds after which a closed window may
+ * have reopened.
+ * @return The window in packets.
+ */
+static uint32_t receive_window(const struct receiver *receiver, const session_t *session, uint64_t *reopen_delay)
+{
+    uint32_t payload_size = session->agreed.payload_size;
+    uint64_t rate = session->output->limiter.rate;
+    uint64_t slots = session->agreed.window_size;
+    int64_t room = output_room(session->output);
+    if (rate > 0)
+    {
+        uint64_t share = receiver->socket_buffer / receiver->sessions.count / payload_size;
+        uint64_t covered = room > 0 ? (uint64_t)room / session->agreed.stripes / payload_size : 0;
+        slots = slots < share ? slots : share;
+        slots = slots < covered ? slots : covered;
+    }
+    else if (room < 0)
+    {
+        uint64_t queued = ((uint64_t)-room + payload_size - 1) / payload_size;
+        slots = queued < slots ? slots - queued : 0;
+    }
+    if (slots == 0 && room >= 0)
+    {
+        slots = 1;
+    }
+    if (reopen_delay != NULL)
+    {
+        *reopen_delay = rate > 0 && room < 0 ? (uint64_t)-room * 1000000 / rate + 1 : RWND_CHECK_INTERVAL;
+    }
+    return slots;
+}
+
+/**
+ * @brief Queues a cumulative ACK carrying the receive window and how long the echoed packet was
+ * held, followed by the SACK blocks of the out-of-order ranges. A closed window is checked again
+ * once a packet may have been written, and the ACK repeated as a window update if it reopened (see
+ * expire_sessions()).
+ *
+ * @param receiver The receive thread.
+ * @param session The transfer being acknowledged.
+ * @param echoed_seq The sequence number of the most recent packet received.
+ * @param echoed_time The time that packet arrived, in microseconds.
+ * @param now The current time in microseconds.
+ */
+static void queue_ack(struct receiver *receiver, session_t *session, uint32_t echoed_seq, uint64_t echoed_time,
+                      uint64_t now)
+{
+    batch_io_t *ack_batch = &receiver->ack_batch;
+    if (batch_full(ack_batch))
+    {
+        flush_acks(ack_batch, receiver->sock_fd);
+    }
+
+    packet_t *ack_packet = (packet_t *)batch_buffer(ack_batch);
+    uint64_t reopen_delay;
+    uint32_t window = receive_window(receiver, session, &reopen_delay);
+    session->window_update_time = window == 0 ? now + reopen_delay : 0;
+    // a delayed ACK tells the sender how long it sat on the echoed packet, so the wait is no RTT
+    uint32_t held = now - echoed_time < UINT32_MAX ? (uint32_t)(now - echoed_time) : UINT32_MAX;
+    memcpy(ack_packet->data, &window, sizeof(window));
+    memcpy(ack_packet->data + sizeof(window), &held, sizeof(held));
+    size_t sack_blocks = reorder_encode_sack(&session->reorder, session->expected_sequence,
+                                             (sack_block_t *)(ack_packet->data + sizeof(window) + sizeof(held)),
+                                             MAX_SACK_BLOCKS);
+    ack_packet->header = create_header(session->conn_id, echoed_seq, session->expected_sequence,
+        sizeof(window) + sizeof(held) + sack_blocks * sizeof(sack_block_t),
+        sack_blocks ? ACK_FLAG | WINDOW_FLAG | SACK_FLAG : ACK_FLAG | WINDOW_FLAG);
+    packet_seal(ack_packet);
+    batch_commit(ack_batch, sizeof(header_t) + ack_packet->header.length, &session->client_addr);
+}
+
+/**
+ * @brief Picks the payload size and window both sides use for the transfer: the smaller of what
+ * the sender proposes and what this receiver accepts.
+ *
+ * @param request The SYN packet of the sender.
+ * @param request_len Length of the received datagram.
+ * @param max_payload Largest payload this receiver accepts.
+ * @param max_window Largest window this receiver accepts.
+ * @return The agreed parameters.
+ */
+static setup_t agree_setup(const packet_t *request, size_t request_len, uint32_t max_payload, uint32_t max_window)
+{
+    setup_t agreed = {max_payload, max_window, 0, 0, 0, request->header.conn_id, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+    if (request_len >= PACKET_SIZE(sizeof(setup_t)))
+    {
+        // the payload follows a 20-byte header, too loosely aligned to read the 64-bit fields in place
+        setup_t copy;
+        memcpy(&copy, request->data, sizeof(copy));
+        const setup_t *proposed = &copy;
+        agreed.total_bytes = proposed->total_bytes;
+        agreed.offset = proposed->offset;
+        agreed.file_size = proposed->file_size;
+        agreed.transfer_id = proposed->transfer_id;
+        agreed.stripes = proposed->stripes;
+        agreed.file_version = proposed->file_version;
+        agreed.delta_block_size = proposed->delta_block_size;
+        if (proposed->compress_block <= COMPRESS_MAX_BLOCK)
+        {
+            agreed.compress_block = proposed->compress_block;
+        }
+        if (proposed->fec_data > 0 && proposed->fec_parity > 0 && proposed->fec_parity <= FEC_MAX_PARITY
+            && proposed->fec_data + proposed->fec_parity <= FEC_MAX_SYMBOLS)
+        {
+            agreed.fec_data = proposed->fec_data;
+            agreed.fec_parity = proposed->fec_parity;
+        }
+        if (proposed->payload_size > 0 && proposed->payload_size < agreed.payload_size)
+        {
+            agreed.payload_size = proposed->payload_size;
+        }
+        if (proposed->window_size > 0 && proposed->window_size < agreed.window_size)
+        {
+            agreed.window_size = proposed->window_size;
+        }
+        if (agreed.stripes == 0)
+        {
+            agreed.stripes = 1;
+        }
+        if (agreed.file_size < agreed.offset + agreed.total_bytes)
+        {
+            agreed.file_size = agreed.offset + agreed.total_bytes;
+        }
+    }
+    return agreed;
+}
+
+/**
+ * @brief Answers a setup request with the parameters both sides use for the transfer.
+ *
+ * Retransmitted setup requests get the same answer, so a lost answer is simply sent again.
+ *
+ * @param sock_fd The socket to send on.
+ * @param session The transfer being set up.
+ */
+static void send_setup_ack(int sock_fd, const session_t *session)
+{
+    unsigned char buffer[PACKET_SIZE(sizeof(setup_t))];
+    packet_t *setup_ack = (packet_t *)buffer;
+    create_packet(setup_ack, (const unsigned char *)&session->agreed,
+        create_header(session->conn_id, 0, 0, sizeof(setup_t), SYN_FLAG | ACK_FLAG));
+    packet_seal(setup_ack);
+    sendto(sock_fd, setup_ack, sizeof(buffer), 0, (const struct sockaddr *)&session->client_addr, sizeof(session->client_addr));
+}
+
+/**
+ * @brief Answers a FIN packet. Connections without a session get an answer too, since their
+ * FIN-ACK may have been lost after the session ended, but without a digest.
+ *
+ * @param sock_fd The socket to send on.
+ * @param conn_id The connection being finished.
+ * @param client_addr The address of the sender.
+ * @param digest The CRC32C of the bytes received on the connection, or NULL if it is not known.
+ */
+static void send_fin_ack(int sock_fd, uint32_t conn_id, const struct sockaddr_in *client_addr, const uint32_t *digest)
+{
+    unsigned char buffer[PACKET_SIZE(sizeof(uint32_t))];
+    packet_t *fin_ack_packet = (packet_t *)buffer;
+    uint16_t length = digest != NULL ? sizeof(*digest) : 0;
+    create_packet(fin_ack_packet, (const unsigned char *)digest,
+        create_header(conn_id, 0, 0, length, FIN_FLAG | ACK_FLAG));
+    packet_seal(fin_ack_packet);
+    sendto(sock_fd, fin_ack_packet, PACKET_SIZE(length), 0, (const struct sockaddr *)client_addr, sizeof(*client_addr));
+}
+
+/**
+ * @brief Returns the bytes of a table exchanged during setup carried by one packet.
+ *
+ * @param session The transfer being set up.
+ * @return The smaller of the payload size and MAX_TABLE_CHUNK.
+ */
+static size_t table_chunk(const session_t *session)
+{
+    return session->agreed.payload_size < MAX_TABLE_CHUNK ? session->agreed.payload_size : MAX_TABLE_CHUNK;
+}
+
+/**
+ * @brief Answers a request for a chunk of a table the sender fetches during setup: the bitmap of
+ * the blocks of a stripe the receiver had before the transfer was set up, or the signatures of its
+ * copy of the file. Requests past the end of the table get an empty answer.
+ *
+ * @param sock_fd The socket to send on.
+ * @param session The transfer being set up.
+ * @param flag RESUME_FLAG or DELTA_FLAG, the table asked for.
+ * @param table The table, NULL if there is none.
+ * @param table_len Bytes of the table.
+ * @param first Offset in the table of the first byte asked for.
+ */
+static void send_table_chunk(int sock_fd, const session_t *session, uint16_t flag, const void *table, size_t table_len,
+                             uint32_t first)
+{
+    unsigned char buffer[PACKET_SIZE(MAX_TABLE_CHUNK)];
+    packet_t *answer = (packet_t *)buffer;
+    uint16_t length = 0;
+    if (table != NULL && first < table_len)
+    {
+        length = table_len - first < table_chunk(session) ? table_len - first : table_chunk(session);
+    }
+    create_packet(answer, length > 0 ? (const unsigned char *)table + first : NULL,
+        create_header(session->conn_id, first, 0, length, flag | ACK_FLAG));
+    packet_seal(answer);
+    sendto(sock_fd, answer, PACKET_SIZE(length), 0, (const struct sockaddr *)&session->client_addr, sizeof(session->client_addr));
+}
+
+/**
+ * @brief Arms the timer of a session for its delayed ACK deadline or window update, or for its
+ * inactivity timeout if neither is pending. A finished session only waits for its linger deadline.
+ *
+ * @param receiver The receiver.
+ * @param session The session.
+ */
+static void arm_session_timer(struct receiver *receiver, session_t *session)
+{
+    if (session->state == SESSION_TIME_WAIT)
+    {
+        timer_wheel_arm(&receiver->wheel, &session->timer, session->linger_deadline);
+        return;
+    }
+    uint64_t deadline = session->last_receive_time + RECEIVE_TIMEOUT * 1000000ULL;
+    uint64_t ack_deadline = ack_policy_deadline(&session->ack_policy);
+    if (session->window_update_time != 0 && session->window_update_time < ack_deadline)
+    {
+        ack_deadline = session->window_update_time;
+    }
+    timer_wheel_arm(&receiver->wheel, &session->timer, ack_deadline < deadline ? ack_deadline : deadline);
+}
+
+/**
+ * @brief Takes a reference to the output file of the transfer a new session belongs to.
+ *
+ * A daemon writes each transfer to a file named after its transfer ID in the destination
+ * directory, opened by the first of its stripes and shared by the others. Otherwise only the
+ * stripes of the first transfer set up are accepted, into the output file opened at start; with
+ * -r the first of them starts the checkpoint over unless it belongs to the same file.
+ *
+ * @param shared The shared receiver state.
+ * @param agreed The parameters of the new session.
+ * @return The output file, or NULL if the session is not accepted.
+ */
+static output_file_t *acquire_output(struct receiver_shared *shared, const setup_t *agreed)
+{
+    output_file_t *output = NULL;
+    pthread_mutex_lock(&shared->lock);
+    if (shared->options->daemon)
+    {
+        struct transfer *transfer = shared->transfers;
+        while (transfer != NULL && transfer->transfer_id != agreed->transfer_id)
+        {
+            transfer = transfer->next;
+        }
+        if (transfer == NULL && (transfer = (struct transfer *)calloc(1, sizeof(struct transfer))) != NULL)
+        {
+            char path[PATH_MAX];
+            snprintf(path, sizeof(path), "%s/%08x", shared->destination, agreed->transfer_id);
+            transfer->transfer_id = agreed->transfer_id;
+            transfer->output = output_open(path, shared->options->write_rate, false);
+            if (transfer->output == NULL)
+            {
+                fprintf(stderr, "Output file open failed: %s\n", path);
+                free(transfer);
+                transfer = NULL;
+            }
+            else
+            {
+                transfer->next = shared->transfers;
+                shared->transfers = transfer;
+            }
+        }
+        if (transfer != NULL)
+        {
+            transfer->sessions++;
+            output = transfer->output;
+        }
+    }
+    else if (shared->stripes == 0
+             || (agreed->transfer_id == shared->single_transfer_id && shared->stripes_opened < shared->stripes))
+    {
+        // blocks of another file, or of another version of it, are of no use
+        if (shared->stripes == 0 && shared->options->resume
+            && !checkpoint_matches(&shared->checkpoint, agreed->file_size, agreed->file_version)
+            && (checkpoint_reset(&shared->checkpoint, agreed->file_size, agreed->file_version) < 0
+                || output_preallocate(shared->single_output, 0) < 0))
+        {
+            fprintf(stderr, "Cannot start the checkpoint of %s: %s\n", shared->destination, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+        shared->single_transfer_id = agreed->transfer_id;
+        shared->stripes = agreed->stripes;
+        shared->stripes_opened++;
+        output = shared->single_output;
+    }
+    if (output != NULL)
+    {
+        output_retain(output);
+    }
+    pthread_mutex_unlock(&shared->lock);
+    return output;
+}
+
+/**
+ * @brief Records that a session of a transfer ended. A daemon closes the file of a transfer once
+ * none of its sessions are open; otherwise the receiver stops once every stripe has ended.
+ *
+ * @param shared The shared receiver state.
+ * @param agreed The parameters of the session.
+ * @param finished Whether the sender finished the session with a FIN.
+ */
+static void release_output(struct receiver_shared *shared, const setup_t *agreed, bool finished)
+{
+    pthread_mutex_lock(&shared->lock);
+    if (shared->options->daemon)
+    {
+        struct transfer **link = &shared->transfers;
+        while (*link != NULL && (*link)->transfer_id != agreed->transfer_id)
+        {
+            link = &(*link)->next;
+        }
+        struct transfer *transfer = *link;
+        if (transfer != NULL && --transfer->sessions == 0)
+        {
+            *link = transfer->next;
+            output_release(transfer->output);
+            free(transfer);
+        }
+    }
+    else
+    {
+        shared->stripes_finished += finished;
+        if (++shared->stripes_closed == shared->stripes)
+        {
+            stop_receivers(shared);
+        }
+    }
+    pthread_mutex_unlock(&shared->lock);
+}
+
+/**
+ * @brief Sets up a transfer requested by a SYN packet: attaches its output file, sizes its
+ * reorder window by the agreed parameters and, with -r, leaves out the packets of the stripe
+ * whose blocks the checkpoint has. With -u a sender asking for a delta transfer is told about the
+ * signatures of the existing copy. Without -D, failing to set it up ends the program.
+ *
+ * @param receiver The receive thread.
+ * @param request The SYN packet.
+ * @param request_len Length of the received datagram.
+ * @param client_addr The address of the sender.
+ * @param now The current time in microseconds.
+ * @return The new session, or NULL if the transfer is not accepted or could not be set up.
+ */
+static session_t *open_session(struct receiver *receiver, const packet_t *request, size_t request_len,
+                               const struct sockaddr_in *client_addr, uint64_t now)
+{
+    const struct receiver_options *options = receiver->options;
+    uint32_t conn_id = request->header.conn_id;
+
+    setup_t agreed = agree_setup(request, request_len, options->max_payload, options->max_window);
+    // an ACK is only held back while fewer than ack_every packets are pending
+    agreed.max_ack_delay = options->ack_every > 1 ? (uint32_t)options->ack_delay : 0;
+    if (agreed.delta_block_size > 0 && receiver->shared->num_signatures > 0)
+    {
+        agreed.delta_block_size = receiver->shared->block_size;
+        agreed.delta_blocks = receiver->shared->num_signatures;
+        // packets are only left out when matched blocks cover them whole, so a packet larger than
+        // a block would resend a whole packet around every changed byte
+        if (agreed.payload_size > agreed.delta_block_size)
+        {
+            agreed.payload_size = agreed.delta_block_size;
+        }
+    }
+    else
+    {
+        agreed.delta_block_size = 0;
+    }
+    output_file_t *output = acquire_output(receiver->shared, &agreed);
+    if (output == NULL)
+    {
+        return NULL;
+    }
+
+    session_t *session = session_create(&receiver->sessions, conn_id);
+    if (session == NULL)
+    {
+        output_release(output);
+        release_output(receiver->shared, &agreed, false);
+        fprintf(stderr, "Cannot allocate the session of %08x\n", conn_id);
+        if (!options->daemon)
+        {
+            exit(EXIT_FAILURE);
+        }
+        return NULL;
+    }
+    session->output = output;
+    session->client_addr = *client_addr;
+    session->last_receive_time = now;
+    session->agreed = agreed;
+    // a reorder window of payloads per session does not scale to many sessions, does not help
+    // when workers write packets out of order anyway, and cannot append stripes in order. A
+    // compressed stream has to be taken in order, but its blocks are written where they belong
+    session->compressed = agreed.compress_block > 0;
+    session->positional = !session->compressed
+                          && (options->positional || options->daemon || options->io_threads > 0 || agreed.stripes > 1
+                              || agreed.offset > 0 || options->resume || options->update);
+    ack_policy_init(&session->ack_policy, options->ack_every, options->ack_delay);
+    crc32c_digest_init(&session->digest, agreed.payload_size);
+
+    // the blocks the checkpoint has, which the sender asks for before sending the rest
+    byte_ranges_t covered;
+    memset(&covered, 0, sizeof(covered));
+    if (options->resume)
+    {
+        session->present_len = (resume_blocks(agreed.offset, agreed.total_bytes) + 7) / 8;
+        session->present = (uint8_t *)calloc(session->present_len + 1, 1);
+        if (session->present != NULL)
+        {
+            session->agreed.present_bytes = checkpoint_snapshot(&receiver->shared->checkpoint, agreed.offset,
+                                                                agreed.total_bytes, session->present);
+        }
+    }
+
+    int built = -1;
+    if ((!options->resume || session->present != NULL)
+        && (session->agreed.present_bytes == 0
+            || resume_present_ranges(&covered, session->present, agreed.offset, agreed.total_bytes) == 0))
+    {
+        built = resume_map_build(&session->map, &covered, agreed.offset, agreed.total_bytes, agreed.payload_size);
+    }
+    byte_ranges_free(&covered);
+
+    if (built < 0
+        || reorder_init(&session->reorder, agreed.window_size, session->positional ? 0 : agreed.payload_size) < 0
+        || ((session->positional || session->compressed) && output_preallocate(output, agreed.file_size) < 0)
+        || (session->compressed && decompressor_init(&session->decompressor, agreed.compress_block) < 0)
+        || (agreed.fec_parity > 0 && fec_decoder_init(&session->fec, agreed.fec_data, agreed.fec_parity,
+                                                      agreed.payload_size, agreed.window_size,
+                                                      session->compressed ? UINT64_MAX : session->map.bytes) < 0))
+    {
+        fprintf(stderr, "Cannot set up the transfer of %08x: %s\n", conn_id, strerror(errno));
+        session_destroy(&receiver->sessions, session);
+        release_output(receiver->shared, &agreed, false);
+        if (!options->daemon)
+        {
+            exit(EXIT_FAILURE);
+        }
+        return NULL;
+    }
+    if (session->agreed.present_bytes > 0)
+    {
+        fprintf(stderr, "Resuming %08x: %" PRIu64 " of %" PRIu64 " bytes already received\n", conn_id,
+                session->agreed.present_bytes, agreed.total_bytes);
+    }
+    return session;
+}
+
+/**
+ * @brief Ends a transfer, releasing its state.
+ *
+ * @param receiver The receive thread.
+ * @param session The session.
+ * @param finished Whether the sender finished the transfer with a FIN.
+ */
+static void close_session(struct receiver *receiver, session_t *session, bool finished)
+{
+    setup_t agreed = session->agreed;
+    timer_wheel_cancel(&receiver->wheel, &session->timer);
+    session_destroy(&receiver->sessions, session);
+    release_output(receiver->shared, &agreed, finished);
+}
+
+/**
+ * @brief Marks the output file as corrupted, so it is not kept.
+ *
+ * @param shared The shared receiver state.
+ */
+static void mark_corrupted(struct receiver_shared *shared)
+{
+    pthread_mutex_lock(&shared->lock);
+    shared->corrupted = true;
+    pthread_mutex_unlock(&shared->lock);
+}
+
+/**
+ * @brief Writes bytes decompressed from the stream of a connection where they belong: the bytes of
+ * the stripe's packets the connection carries follow each other in the stream, so packet i of them
+ * is packet resume_map_packet() of the stripe.
+ *
+ * @param receiver The receiver.
+ * @param session The session.
+ * @param raw The bytes.
+ * @param len Number of bytes.
+ * @return 0 on success, -1 if the stream holds more bytes than the connection carries.
+ */
+static int write_decompressed(struct receiver *receiver, session_t *session, const unsigned char *raw, size_t len)
+{
+    uint32_t payload_size = session->agreed.payload_size;
+    if (len > session->map.bytes - session->raw_received)
+    {
+        return -1;
+    }
+    while (len > 0)
+    {
+        uint64_t pos = session->raw_received;
+        uint64_t offset = session->agreed.offset
+                          + (uint64_t)resume_map_packet(&session->map, pos / payload_size) * payload_size
+                          + pos % payload_size;
+        // packets next to each other in the file are written at once
+        size_t run = len < payload_size - pos % payload_size ? len : payload_size - pos % payload_size;
+        while (run < len && session->agreed.offset + (uint64_t)resume_map_packet(&session->map, (pos + run) / payload_size)
+                                                         * payload_size == offset + run)
+        {
+            run += len - run < payload_size ? len - run : payload_size;
+        }
+        io_pool_submit(&receiver->shared->io_pool, session->output, offset, raw, run);
+        session->raw_received += run;
+        session->bytes_written += run;
+        raw += run;
+        len -= run;
+    }
+    return 0;
+}
+
+/**
+ * @brief Hands the payloads of a connection to the output in order: appends them to the file, or
+ * decompresses them and writes each block where it belongs if the connection is compressed. A
+ * stream that cannot be decompressed marks the output corrupted and the rest of it is dropped.
+ *
+ * @param receiver The receiver.
+ * @param session The session.
+ * @param data The payload.
+ * @param len Its length.
+ */
+static void deliver_in_order(struct receiver *receiver, session_t *session, const unsigned char *data, size_t len)
+{
+    if (!session->compressed)
+    {
+        session->bytes_written += output_append(session->output, data, len);
+        return;
+    }
+    session->stream_received += len;
+    while (len > 0)
+    {
+        const unsigned char *raw;
+        size_t raw_len;
+        long taken = decompressor_push(&session->decompressor, data, len, &raw, &raw_len);
+        if (taken < 0 || (raw != NULL && write_decompressed(receiver, session, raw, raw_len) < 0))
+        {
+            fprintf(stderr, "Transfer %08x corrupted: invalid compressed stream\n", session->conn_id);
+            mark_corrupted(receiver->shared);
+            session->decompressor.ended = true;
+            return;
+        }
+        data += taken;
+        len -= taken;
+    }
+}
+
+/**
+ * @brief Takes the first copy of a data packet into the digest of its connection, and into its
+ * group if the sender sends parity packets.
+ *
+ * @param session The transfer the packet belongs to.
+ * @param packet The data packet.
+ * @param payload_crc The CRC32C of its payload.
+ */
+static void accept_payload(session_t *session, const packet_t *packet, uint32_t payload_crc)
+{
+    uint64_t offset = (uint64_t)packet->header.seq_num * session->agreed.payload_size;
+    crc32c_digest_add(&session->digest, payload_crc, offset, packet->header.length);
+    if (session->agreed.fec_parity > 0)
+    {
+        fec_decoder_add_data(&session->fec, packet->header.seq_num, packet->data, packet->header.length);
+    }
+}
+
+/**
+ * @brief Writes the payload of a data packet, or buffers it until the packets before it arrived,
+ * and advances the next expected sequence number.
+ *
+ * In positional mode every packet is written at its offset the first time it arrives, by the I/O
+ * workers if there are any, and the reorder window only tracks which packets arrived. Packet
+ * seq_num of the connection holds packet resume_map_packet() of the stripe, which starts at
+ * offset + payload_size times its number. Otherwise packets are appended in order, or decompressed
+ * in order if the connection is compressed, and those ahead of the next expected one wait in the
+ * reorder window. Either way the first copy of every packet is taken by accept_payload().
+ *
+ * @param receiver The receiver.
+ * @param session The transfer the packet belongs to.
+ * @param packet The data packet.
+ * @param payload_crc The CRC32C of its payload.
+ */
+static void receive_data(struct receiver *receiver, session_t *session, const packet_t *packet, uint32_t payload_crc)
+{
+    reorder_buffer_t *reorder = &session->reorder;
+    uint32_t seq = packet->header.seq_num;
+
+    if (session->positional)
+    {
+        // write the packet in place the first time it arrives, and only remember that it did
+        if (seq == session->expected_sequence
+            || reorder_insert(reorder, session->expected_sequence, seq, NULL, 0) == REORDER_STORED)
+        {
+            uint64_t offset = (uint64_t)resume_map_packet(&session->map, seq) * session->agreed.payload_size;
+            io_pool_submit(&receiver->shared->io_pool, session->output, session->agreed.offset + offset,
+                           packet->data, packet->header.length);
+            session->bytes_written += packet->header.length;
+            accept_payload(session, packet, payload_crc);
+        }
+        if (seq == session->expected_sequence)
+        {
+            session->expected_sequence += 1;
+        }
+        while (reorder_remove(reorder, session->expected_sequence))
+        {
+            session->expected_sequence += 1;
+        }
+        return;
+    }
+
+    if (seq > session->expected_sequence)
+    {
+        // buffer the packet in its slot to be written later; duplicates are dropped
+        if (reorder_insert(reorder, session->expected_sequence, seq, packet->data, packet->header.length) == REORDER_STORED)
+        {
+            accept_payload(session, packet, payload_crc);
+        }
+    }
+    else if (seq == session->expected_sequence)
+    {
+        // write packet
+        deliver_in_order(receiver, session, packet->data, packet->header.length);
+        session->expected_sequence += 1;
+        accept_payload(session, packet, payload_crc);
+    }
+    // write every buffered packet that is now in order
+    const unsigned char *buffered;
+    size_t buffered_len;
+    while ((buffered = reorder_take(reorder, session->expected_sequence, &buffered_len)) != NULL)
+    {
+        deliver_in_order(receiver, session, buffered, buffered_len);
+        session->expected_sequence += 1;
+    }
+}
+
+/**
+ * @brief Rebuilds the lost data packets of a group from its parity packets, once enough of them
+ * arrived, and receives them as if they had.
+ *
+ * @param receiver The receiver.
+ * @param session The session.
+ * @param seq Sequence number of any data packet of the group.
+ * @param last_seq Set to the sequence number of the last packet rebuilt, if any.
+ * @return The number of packets rebuilt.
+ */
+static unsigned recover_packets(struct receiver *receiver, session_t *session, uint32_t seq, uint32_t *last_seq)
+{
+    unsigned recovered = fec_decoder_recover(&session->fec, seq);
+    for (unsigned i = 0; i < recovered; i++)
+    {
+        packet_t *packet = fec_decoder_packet(&session->fec, i);
+        packet->header.conn_id = session->conn_id;
+        receive_data(receiver, session, packet, crc32c(0, packet->data, packet->header.length));
+        *last_seq = packet->header.seq_num;
+    }
+    return recovered;
+}
+
+/**
+ * @brief Checks the digest a sender put in its FIN against the bytes received on the connection.
+ *
+ * @param receiver The receiver.
+ * @param session The session.
+ * @param fin The FIN packet.
+ * @return The digest of the bytes received.
+ */
+static uint32_t check_digest(struct receiver *receiver, const session_t *session, const packet_t *fin)
+{
+    uint32_t digest = crc32c_digest_final(&session->digest,
+                                          session->compressed ? session->stream_received : session->map.bytes);
+    uint32_t expected;
+    if (fin->header.length < sizeof(expected))
+    {
+        return digest;
+    }
+    memcpy(&expected, fin->data, sizeof(expected));
+    if (digest != expected)
+    {
+        fprintf(stderr, "Transfer %08x corrupted: CRC32C %08x, sender's %08x\n", session->conn_id, digest, expected);
+        mark_corrupted(receiver->shared);
+    }
+    else if (session->compressed && (!session->decompressor.ended || session->raw_received != session->map.bytes))
+    {
+        fprintf(stderr, "Transfer %08x corrupted: compressed stream ended after %" PRIu64 " of %" PRIu64 " bytes\n",
+                session->conn_id, session->raw_received, session->map.bytes);
+        mark_corrupted(receiver->shared);
+    }
+    return digest;
+}
+
+/**
+ * @brief Copies the blocks of the existing copy a sender matched into the output file, checking
+ * each one still has the CRC32C it was signed with, and leaves the packets of the stripe the
+ * matches cover out of the connection.
+ *
+ * @param receiver The receiver.
+ * @param session The session, whose match table arrived whole.
+ * @return 0 on success, -1 if a match is invalid, the copy changed or memory runs out.
+ */
+static int apply_matches(struct receiver *receiver, session_t *session)
+{
+    struct receiver_shared *shared = receiver->shared;
+    const setup_t *agreed = &session->agreed;
+    const delta_match_t *matches = (const delta_match_t *)session->match_table;
+    size_t count = session->match_len / sizeof(delta_match_t);
+    uint32_t block_size = shared->block_size;
+
+    byte_ranges_t covered;
+    memset(&covered, 0, sizeof(covered));
+    unsigned char *block = (unsigned char *)malloc(block_size);
+    int result = block != NULL ? 0 : -1;
+    for (size_t m = 0; m < count && result == 0; m++)
+    {
+        if (matches[m].block >= shared->num_signatures || matches[m].offset < agreed->offset
+            || matches[m].offset + block_size > agreed->offset + agreed->total_bytes
+            || pread(shared->copy_fd, block, block_size, matches[m].block * block_size) != (ssize_t)block_size
+            || crc32c(0, block, block_size) != shared->signatures[matches[m].block].crc
+            || byte_ranges_add(&covered, matches[m].offset, matches[m].offset + block_size) < 0)
+        {
+            result = -1;
+            break;
+        }
+        io_pool_submit(&shared->io_pool, session->output, matches[m].offset, block, block_size);
+    }
+    free(block);
+
+    // the map is built from the same ranges as the sender's
+    if (result == 0 && session->agreed.present_bytes > 0)
+    {
+        result = resume_present_ranges(&covered, session->present, agreed->offset, agreed->total_bytes);
+    }
+    if (result == 0)
+    {
+        resume_map_free(&session->map);
+        result = resume_map_build(&session->map, &covered, agreed->offset, agreed->total_bytes, agreed->payload_size);
+    }
+    if (result == 0 && agreed->fec_parity > 0)
+    {
+        fec_decoder_free(&session->fec);
+        result = fec_decoder_init(&session->fec, agreed->fec_data, agreed->fec_parity, agreed->payload_size,
+                                  agreed->window_size, session->compressed ? UINT64_MAX : session->map.bytes);
+    }
+    byte_ranges_free(&covered);
+    if (result == 0)
+    {
+        fprintf(stderr, "Delta %08x: %zu blocks copied from %s, %" PRIu64 " of %" PRIu64 " bytes to receive\n",
+                session->conn_id, count, shared->destination, session->map.bytes, agreed->total_bytes);
+    }
+    return result;
+}
+
+/**
+ * @brief Takes a chunk of the table of matches a sender pushes before a delta transfer and
+ * acknowledges it. Once every chunk arrived the matched blocks are copied (see apply_matches()).
+ *
+ * @param receiver The receiver.
+ * @param session The session.
+ * @param packet The MATCH_FLAG packet, with the offset of its chunk in seq_num and the length of the
+ * table in ack_num.
+ */
+static void receive_matches(struct receiver *receiver, session_t *session, const packet_t *packet)
+{
+    uint32_t first = packet->header.seq_num;
+    uint32_t len = packet->header.ack_num;
+    size_t chunk = table_chunk(session);
+    if (session->agreed.delta_blocks == 0 || len == 0 || len % sizeof(delta_match_t) != 0 || first % chunk != 0
+        || first >= len || packet->header.length != (len - first < chunk ? len - first : chunk)
+        || (session->match_table != NULL && len != session->match_len))
+    {
+        return;
+    }
+    if (session->match_table == NULL)
+    {
+        uint32_t chunks = (len + chunk - 1) / chunk;
+        session->match_table = (unsigned char *)malloc(len);
+        session->match_chunks = (uint8_t *)calloc((chunks + 7) / 8, 1);
+        if (session->match_table == NULL || session->match_chunks == NULL)
+        {
+            free(session->match_table);
+            free(session->match_chunks);
+            session->match_table = NULL;
+            session->match_chunks = NULL;
+            return;
+        }
+        session->match_len = len;
+        session->match_missing = chunks;
+    }
+
+    uint32_t c = first / chunk;
+    if (!(session->match_chunks[c / 8] & (1 << (c % 8))))
+    {
+        session->match_chunks[c / 8] |= 1 << (c % 8);
+        memcpy(session->match_table + first, packet->data, packet->header.length);
+        if (--session->match_missing == 0 && apply_matches(receiver, session) < 0)
+        {
+            fprintf(stderr, "Transfer %08x: cannot copy the blocks the sender matched in %s\n", session->conn_id,
+                    receiver->shared->destination);
+            mark_corrupted(receiver->shared);
+        }
+    }
+
+    unsigned char buffer[PACKET_SIZE(0)];
+    packet_t *answer = (packet_t *)buffer;
+    create_packet(answer, NULL, create_header(session->conn_id, first, 0, 0, MATCH_FLAG | ACK_FLAG));
+    packet_seal(answer);
+    sendto(receiver->sock_fd, answer, sizeof(buffer), 0, (const struct sockaddr *)&session->client_addr,
+           sizeof(session->client_addr));
+}
+
+/**
+ * @brief Handles a FIN, or the sender's acknowledgment of a FIN-ACK (FIN_FLAG | ACK_FLAG).
+ *
+ * The first FIN checks the digest of the connection, answers it and moves the session to
+ * SESSION_TIME_WAIT, so a FIN repeated because the FIN-ACK was lost gets the same digest. Every
+ * FIN extends the linger to one RTO past the last FIN the sender may still send, MAX_FIN_SENT
+ * less its number RTOs later. The session ends once the sender acknowledges the FIN-ACK, or when
+ * the linger runs out. FINs of connections without a session get an answer
+ * without a digest, since their session may have ended before the FIN-ACK arrived.
+ *
+ * @param receiver The receiver.
+ * @param session The session of the connection, NULL if there is none.
+ * @param packet The packet.
+ * @param client_addr The address it came from.
+ * @param now The current time in microseconds.
+ */
+static void finish_session(struct receiver *receiver, session_t *session, const packet_t *packet,
+                           const struct sockaddr_in *client_addr, uint64_t now)
+{
+    if (IS_ACK(packet->header.flags))
+    {
+        if (session != NULL && session->state == SESSION_TIME_WAIT)
+        {
+            close_session(receiver, session, true);
+        }
+        return;
+    }
+
+    // send fin ack after every ACK still waiting in the batch
+    flush_acks(&receiver->ack_batch, receiver->sock_fd);
+    if (session == NULL)
+    {
+        send_fin_ack(receiver->sock_fd, packet->header.conn_id, client_addr, NULL);
+        return;
+    }
+    if (session->state == SESSION_ESTABLISHED)
+    {
+        session->fin_digest = check_digest(receiver, session, packet);
+        if (receiver->options->daemon)
+        {
+            fprintf(stderr, "Transfer %08x done: %" PRIu64 " bytes\n", session->conn_id, session->bytes_written);
+        }
+        session->state = SESSION_TIME_WAIT;
+        session->linger_deadline = now;
+    }
+    uint64_t rto = packet->header.ack_num > 0 ? packet->header.ack_num : DEFAULT_FIN_RTO;
+    uint32_t fin_number = packet->header.seq_num > 0 && packet->header.seq_num <= MAX_FIN_SENT
+                              ? packet->header.seq_num : 1;
+    uint64_t linger = (MAX_FIN_SENT - fin_number + 1) * rto;
+    if (linger > RECEIVE_TIMEOUT * 1000000ULL)
+    {
+        linger = RECEIVE_TIMEOUT * 1000000ULL;
+    }
+    if (now + linger > session->linger_deadline)
+    {
+        session->linger_deadline = now + linger;
+    }
+    send_fin_ack(receiver->sock_fd, packet->header.conn_id, client_addr, &session->fin_digest);
+    arm_session_timer(receiver, session);
+}
+
+/**
+ * @brief Handles one received packet: sets up, feeds or finishes the session of its connection.
+ *
+ * Every ACK carries the next sequence number expected in order (cumulative ACK) and SACK blocks
+ * describing the packets buffered beyond it. In-order packets are acknowledged every ack_every
+ * packets or after ack_delay microseconds, while out-of-order packets, gap fills and duplicates are
+ * acknowledged at once (see ackpolicy.h). Packets whose checksum does not match are dropped like
+ * lost ones. Data packets rebuilt from parity packets count as out-of-order arrivals.
+ *
+ * @param receiver The receiver.
+ * @param packet The packet.
+ * @param packet_len Length of the datagram.
+ * @param client_addr The address it came from.
+ * @param now The current time in microseconds.
+ */
+static void handle_packet(struct receiver *receiver, const packet_t *packet, size_t packet_len,
+                          const struct sockaddr_in *client_addr, uint64_t now)
+{
+    uint32_t payload_crc;
+    if (!packet_verify(packet, packet_len, &payload_crc))
+    {
+        return;
+    }
+    session_t *session = session_find(&receiver->sessions, packet->header.conn_id);
+
+    if (IS_FIN(packet->header.flags))
+    {
+        finish_session(receiver, session, packet, client_addr, now);
+        return;
+    }
+
+    // a finished session only answers FINs
+    if (session != NULL && session->state == SESSION_TIME_WAIT)
+    {
+        return;
+    }
+
+    if (IS_SYN(packet->header.flags))
+    {
+        if (session == NULL)
+        {
+            session = open_session(receiver, packet, packet_len, client_addr, now);
+            if (session == NULL)
+            {
+                return;
+            }
+        }
+        session->last_receive_time = now;
+        session->agreed.receive_window = receive_window(receiver, session, NULL);
+        send_setup_ack(receiver->sock_fd, session);
+        arm_session_timer(receiver, session);
+        return;
+    }
+
+    if (IS_RESUME(packet->header.flags) || IS_DELTA(packet->header.flags) || IS_MATCH(packet->header.flags))
+    {
+        if (session == NULL)
+        {
+            return;
+        }
+        session->last_receive_time = now;
+        if (IS_RESUME(packet->header.flags))
+        {
+            send_table_chunk(receiver->sock_fd, session, RESUME_FLAG, session->present, session->present_len,
+                             packet->header.seq_num);
+        }
+        else if (IS_DELTA(packet->header.flags))
+        {
+            send_table_chunk(receiver->sock_fd, session, DELTA_FLAG, receiver->shared->signatures,
+                             session->agreed.delta_blocks * sizeof(delta_signature_t), packet->header.seq_num);
+        }
+        else
+        {
+            receive_matches(receiver, session, packet);
+        }
+        arm_session_timer(receiver, session);
+        return;
+    }
+
+    // drop data packets of unknown connections
+    if (session == NULL)
+    {
+        return;
+    }
+    session->client_addr = *client_addr;
+    session->last_receive_time = now;
+
+    // a sender whose window stayed closed asks for it again
+    if (IS_WINDOW(packet->header.flags))
+    {
+        queue_ack(receiver, session, packet->header.seq_num, now, now);
+        ack_policy_sent(&session->ack_policy);
+        arm_session_timer(receiver, session);
+        return;
+    }
+
+    uint32_t echoed_seq = packet->header.seq_num;
+    unsigned recovered = 0;
+    if (IS_FEC(packet->header.flags))
+    {
+        if (session->agreed.fec_parity == 0)
+        {
+            return;
+        }
+        fec_decoder_add_parity(&session->fec, packet->header.seq_num, packet->header.ack_num & 0xffff,
+                               packet->header.ack_num >> 16, packet->data, packet->header.length);
+        recovered = recover_packets(receiver, session, packet->header.seq_num, &echoed_seq);
+        if (recovered > 0)
+        {
+            queue_ack(receiver, session, echoed_seq, now, now);
+            ack_policy_sent(&session->ack_policy);
+        }
+        arm_session_timer(receiver, session);
+        return;
+    }
+
+    // reordering, gap fills and duplicates are acknowledged at once
+    bool ack_immediately = packet->header.seq_num != session->expected_sequence || session->reorder.count > 0;
+    receive_data(receiver, session, packet, payload_crc);
+    if (session->agreed.fec_parity > 0)
+    {
+        recovered = recover_packets(receiver, session, packet->header.seq_num, &echoed_seq);
+    }
+
+    // send a cumulative ack for the next expected sequence number, echoing the sequence number
+    // received and selectively acking the ranges buffered beyond it
+    if (ack_policy_on_packet(&session->ack_policy, packet->header.seq_num, ack_immediately || recovered > 0, now))
+    {
+        queue_ack(receiver, session, echoed_seq, now, now);
+        ack_policy_sent(&session->ack_policy);
+    }
+    arm_session_timer(receiver, session);
+}
 
 /**
- * @brief Writes data to a file with a specified rate.
- *
- * This function writes data to the specified file pointer while maintaining a desired write rate.
- * If the write rate is set to 0, data is written as fast as possible.
+ * @brief Drains the packets waiting on the socket, one recvmmsg() per batch.
  *
- * @param data The array of characters containing the data to be written.
- * @param data_len The length of the data array.
- * @param write_rate The desired write rate in bytes per second. If set to 0, writes data as fast as possible.
- * @param total_bytes_written The total number of bytes already written to the file.
- * @param start_time The start time of the writing process.
- * @param outfile The file pointer to write the data to.
- * @return The total number of bytes successfully written to the file.
+ * @param receiver The receiver.
+ * @param now The current time in microseconds.
  */
+static void receive_packets(struct receiver *receiver, uint64_t now)
+{
+    batch_io_t *packet_batch = &receiver->packet_batch;
+    int received;
+    do
+    {
+        received = batch_recv(packet_batch, receiver->sock_fd);
+        if (received < 0)
+        {
+            fprintf(stderr, "Receive failed: %s\n", strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+
+        for (int r = 0; r < received; r++)
+        {
+            // a GRO buffer holds several datagrams of segment_size bytes, the last one possibly shorter
+            unsigned char *buffer = (unsigned char *)batch_data(packet_batch, r);
+            size_t buffer_len = batch_len(packet_batch, r);
+            size_t segment_size = batch_segment_size(packet_batch, r);
+            for (size_t offset = 0; offset < buffer_len; offset += segment_size)
+            {
+                size_t packet_len = segment_size < buffer_len - offset ? segment_size : buffer_len - offset;
+                if (packet_len >= sizeof(header_t))
+                {
+                    handle_packet(receiver, (const packet_t *)(buffer + offset), packet_len, batch_addr(packet_batch, r), now);
+                }
+            }
+        }
+
+        // the ACKs of the whole batch go out with one syscall
+        flush_acks(&receiver->ack_batch, receiver->sock_fd);
+    } while (received == BATCH_MAX);
+}
 
-size_t writeWithRate(char data[], int data_len, unsigned long long int write_rate, size_t total_bytes_written, time_t start_time, FILE *outfile)
+/**
+ * @brief Sends the delayed ACKs that are due and ends the sessions that have been idle for
+ * RECEIVE_TIMEOUT seconds, or whose linger after the FIN ran out.
+ *
+ * @param receiver The receiver.
+ * @param now The current time in microseconds.
+ */
+static void expire_sessions(struct receiver *receiver, uint64_t now)
 {
-    size_t bytes_written = 0;
-    time_t current_time;
-    time(&current_time);
+    timer_node_t *node = timer_wheel_expire(&receiver->wheel, now);
+    while (node != NULL)
+    {
+        timer_node_t *next = node->next;
+        session_t *session = session_of_timer(node);
+        if (session->state == SESSION_TIME_WAIT)
+        {
+            // the sender left without acknowledging the FIN-ACK
+            if (now >= session->linger_deadline)
+            {
+                close_session(receiver, session, true);
+            }
+            else
+            {
+                arm_session_timer(receiver, session);
+            }
+            node = next;
+            continue;
+        }
+        if (ack_policy_due(&session->ack_policy, now)
+            || (session->window_update_time != 0 && now >= session->window_update_time))
+        {
+            queue_ack(receiver, session, session->ack_policy.last_seq, session->ack_policy.last_time, now);
+            ack_policy_sent(&session->ack_policy);
+        }
+        if (now >= session->last_receive_time + RECEIVE_TIMEOUT * 1000000ULL)
+        {
+            if (receiver->options->daemon)
+            {
+                fprintf(stderr, "TIMEOUT %08x\n", session->conn_id);
+            }
+            else
+            {
+                fprintf(stderr, "TIMEOUT\n");
+            }
+            close_session(receiver, session, false);
+        }
+        else
+        {
+            arm_session_timer(receiver, session);
+        }
+        node = next;
+    }
+    flush_acks(&receiver->ack_batch, receiver->sock_fd);
+}
 
-    if (write_rate == 0)
+/**
+ * @brief Saves the checkpoint of the output file every CHECKPOINT_INTERVAL while blocks are being
+ * written. The save syncs the file, so only one receive thread makes it and the others go on.
+ *
+ * @param shared The shared receiver state.
+ * @param now The current time in microseconds.
+ */
+static void save_checkpoint(struct receiver_shared *shared, uint64_t now)
+{
+    pthread_mutex_lock(&shared->lock);
+    bool due = now >= shared->checkpoint_time + CHECKPOINT_INTERVAL;
+    if (due)
     {
-        bytes_written = fwrite(data, sizeof(char), data_len, outfile);
-        fflush(outfile);
-        return bytes_written;
+        shared->checkpoint_time = now;
     }
+    pthread_mutex_unlock(&shared->lock);
 
-    //logic to handle rate limited writing. We compute how writing the whole file would affect the write rate and sleep until the affect would not increase the rate over the maximum
-    double elapsed_seconds = difftime(current_time, start_time);
-    double write_rate_if_all_written = ((double)total_bytes_written + (double)data_len) / elapsed_seconds;
+    if (due && checkpoint_save(&shared->checkpoint, shared->single_output->fd) < 0)
+    {
+        fprintf(stderr, "Checkpoint save failed: %s\n", strerror(errno));
+    }
+}
 
-    while (write_rate_if_all_written > (double)write_rate)
+/**
+ * @brief Sets timer_fd to fire when the earliest session timer expires.
+ *
+ * @param receiver The receiver.
+ */
+static void update_timer_fd(struct receiver *receiver)
+{
+    uint64_t deadline = timer_wheel_next_expiry(&receiver->wheel);
+    if (deadline == receiver->timer_fd_deadline)
     {
-        sleep(0.25);
-        time(&current_time);
-        elapsed_seconds = difftime(current_time, start_time);
-        write_rate_if_all_written = ((double)total_bytes_written + (double)data_len) / elapsed_seconds;
+        return;
     }
 
-    for (size_t i = 0; i < data_len; i++)
+    // an all-zero value disarms the timer
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    if (deadline != TIMER_WHEEL_NO_TIMER)
     {
-        bytes_written += fprintf(outfile, "%c", data[i]);
+        spec.it_value.tv_sec = deadline / 1000000ULL;
+        spec.it_value.tv_nsec = (deadline % 1000000ULL) * 1000;
     }
-    return bytes_written;
+    if (timerfd_settime(receiver->timer_fd, TFD_TIMER_ABSTIME, &spec, NULL) < 0)
+    {
+        fprintf(stderr, "Timer update failed: %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    receiver->timer_fd_deadline = deadline;
 }
 
 /**
- * @brief Receives data packets over UDP, writes them to a file, and sends acknowledgments.
- *
- * This function acts as a receiver for UDP packets, writing received data to a specified file
- * while also sending acknowledgments back to the sender. It maintains a desired write rate if specified.
+ * @brief Sets up a receive thread: its socket on the port, its batches, sessions and timers, and
+ * its event loop.
  *
+ * @param receiver The receive thread to set up.
+ * @param shared The shared receiver state.
  * @param udp_port The UDP port to listen for incoming packets.
- * @param destination_file The file to write the received data to.
- * @param write_rate The desired write rate in bytes per second. If set to 0, writes data as fast as possible.
  */
-void rrecv(unsigned short int udp_port,
-           char *destination_file,
-           unsigned long long int write_rate)
+static void open_receiver(struct receiver *receiver, struct receiver_shared *shared, unsigned short int udp_port)
 {
+    const struct receiver_options *options = shared->options;
+    memset(receiver, 0, sizeof(*receiver));
+    receiver->shared = shared;
+    receiver->options = options;
+    receiver->timer_fd_deadline = TIMER_WHEEL_NO_TIMER;
 
-    time_t start_time;
-    time(&start_time);
-
-    FILE *outfile = fopen(destination_file, "w");
-
-    packet_t incoming_packet, outgoing_packet;
-    header_t outgoing_header;
-    PriorityQueue *packet_queue = createPriorityQueue();
+    if (batch_init(&receiver->packet_batch, PACKET_SIZE(options->max_payload)) < 0 || batch_init(&receiver->ack_batch, ACK_PACKET_SZ) < 0)
+    {
+        fprintf(stderr, "Cannot allocate packet batches\n");
+        exit(EXIT_FAILURE);
+    }
+    if (session_table_init(&receiver->sessions, SESSION_TABLE_SIZE) < 0
+        || timer_wheel_init(&receiver->wheel, TIMER_WHEEL_SLOTS, TIMER_WHEEL_TICK, now_usec()) < 0)
+    {
+        fprintf(stderr, "Cannot allocate session state\n");
+        exit(EXIT_FAILURE);
+    }
 
-    int recv_len, send_len;
-    struct sockaddr_in server_addr, client_addr;
+    struct sockaddr_in server_addr;
 
-    int sock_fd = socket(
+    receiver->sock_fd = socket(
         AF_INET,
         SOCK_DGRAM,
         0);
 
-    if (sock_fd < 0)
+    if (receiver->sock_fd < 0)
+    {
+        fprintf(stderr, "Socket creation failed: %d\n", receiver->sock_fd);
+        exit(EXIT_FAILURE);
+    }
+
+    // every receive thread binds its own socket to the port, the kernel spreads connections over them
+    int reuse = 1;
+    if (options->sockets > 1 && setsockopt(receiver->sock_fd, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse)) < 0)
     {
-        fprintf(stderr, "Socket creation failed: %d\n", sock_fd);
+        fprintf(stderr, "SO_REUSEPORT failed: %s\n", strerror(errno));
         exit(EXIT_FAILURE);
     }
 
     memset(&server_addr, 0, sizeof(server_addr));
-    memset(&client_addr, 0, sizeof(client_addr));
 
     server_addr.sin_family = AF_INET;
     server_addr.sin_addr.s_addr = INADDR_ANY;
-    server_addr.sin_port = udp_port;
+    server_addr.sin_port = htons(udp_port);
 
-    int bind_code = bind(sock_fd, (const struct sockaddr *)&server_addr, sizeof(server_addr));
+    int bind_code = bind(receiver->sock_fd, (const struct sockaddr *)&server_addr, sizeof(server_addr));
     if (bind_code < 0)
     {
         fprintf(stderr, "Socket bind failed: %d\n", bind_code);
-        close(sock_fd);
+        close(receiver->sock_fd);
         exit(EXIT_FAILURE);
     }
 
-    bool connection_open = true;
-
-    uint32_t expected_sequence = 0;
-    uint32_t ack_number;
-    size_t total_bytes_written = 0;
+    // the kernel counts about twice the bytes of each datagram against the buffer
+    int socket_buffer;
+    socklen_t socket_buffer_len = sizeof(socket_buffer);
+    receiver->socket_buffer = getsockopt(receiver->sock_fd, SOL_SOCKET, SO_RCVBUF, &socket_buffer, &socket_buffer_len) == 0
+                                  ? (uint64_t)socket_buffer / 2
+                                  : UINT64_MAX;
 
-    int len = sizeof(client_addr);
+    // let the kernel hand over runs of coalesced datagrams when it can; plain receives otherwise
+    batch_enable_gro(&receiver->packet_batch, receiver->sock_fd);
 
-    bool first_packet_received = false;
-
-    memset(&incoming_packet, 0, sizeof(incoming_packet));
-    while (!(IS_FIN(incoming_packet.header.flags)))
+    receiver->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+    receiver->epoll_fd = epoll_create1(0);
+    if (receiver->timer_fd < 0 || receiver->epoll_fd < 0)
     {
-
-        recv_len = recvfrom(sock_fd, &incoming_packet, sizeof(incoming_packet), 0, (const struct sock_addr *)&client_addr, &len);
-        if (recv_len == -1)
+        fprintf(stderr, "Event loop setup failed: %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    int watched[] = {receiver->sock_fd, receiver->timer_fd, shared->stop_fd};
+    for (size_t w = 0; w < sizeof(watched) / sizeof(watched[0]); w++)
+    {
+        struct epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.fd = watched[w];
+        if (epoll_ctl(receiver->epoll_fd, EPOLL_CTL_ADD, watched[w], &event) < 0)
         {
-            if (errno == EAGAIN) {
-                fprintf(stderr, "TIMEOUT\n");
-                break;
-            }
+            fprintf(stderr, "Event loop setup failed: %s\n", strerror(errno));
+            exit(EXIT_FAILURE);
         }
-        ack_number = incoming_packet.header.seq_num;
+    }
+}
 
-        if (!first_packet_received) {
-            first_packet_received = true;
-            struct timeval timeout;
-            timeout.tv_sec = RECEIVE_TIMEOUT;
-            timeout.tv_usec = 0;
-            setsockopt(sock_fd, SOL_SOCKET, SO_RCVTIMEO, (char*)&timeout, sizeof(timeout));
-        }
+/**
+ * @brief Releases the sessions, batches, timers and descriptors of a receive thread.
+ *
+ * @param receiver The receive thread.
+ */
+static void close_receiver(struct receiver *receiver)
+{
+    session_table_free(&receiver->sessions);
+    batch_free(&receiver->packet_batch);
+    batch_free(&receiver->ack_batch);
+    timer_wheel_free(&receiver->wheel);
 
-        if (IS_FIN(incoming_packet.header.flags))
-        {   
-            // send fin ack
-            packet_t fin_ack_packet;
-            fin_ack_packet = create_packet(NULL, 
-                create_header(0, 0, -1, FIN_FLAG | ACK_FLAG));
-            sendto(sock_fd, &fin_ack_packet, sizeof(packet_t), 0, (const struct sockaddr *)&client_addr, len);
-            
-            break;
+    close(receiver->epoll_fd);
+    close(receiver->timer_fd);
+    close(receiver->sock_fd);
+}
 
-        }
-        else
+/**
+ * @brief Event loop of a receive thread: waits for its socket, its session timers and the
+ * shared stop_fd, until stop_fd becomes readable.
+ *
+ * @param arg The receive thread.
+ * @return NULL.
+ */
+static void *receive_loop(void *arg)
+{
+    struct receiver *receiver = (struct receiver *)arg;
+    while (!receiver->stopping)
+    {
+        // wait for packets, or for the earliest delayed ACK deadline or inactivity timeout
+        update_timer_fd(receiver);
+        struct epoll_event events[3];
+        int ready = epoll_wait(receiver->epoll_fd, events, 3, -1);
+        if (ready < 0)
         {
-            if (incoming_packet.header.seq_num < expected_sequence)
-            {
-                //remove data field so if next packet received does not have a full data field no data remains. 
-                memset(&incoming_packet.data, 0, incoming_packet.header.length);
-            }
-            else if (incoming_packet.header.seq_num > expected_sequence)
+            if (errno == EINTR)
             {
-                // enqueue packet with priority seq_num to be written later
-                enqueue(packet_queue, incoming_packet.header.seq_num, incoming_packet.data, incoming_packet.header.length);
+                continue;
             }
-            else
+            fprintf(stderr, "Epoll wait failed: %s\n", strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+
+        uint64_t now = now_usec();
+        for (int e = 0; e < ready; e++)
+        {
+            if (events[e].data.fd == receiver->shared->stop_fd)
             {
-                // write packet
-                total_bytes_written += writeWithRate(incoming_packet.data, incoming_packet.header.length, write_rate, total_bytes_written, start_time, outfile);
-                expected_sequence += 1;
+                // left readable, so it wakes every thread
+                receiver->stopping = true;
             }
-            // check if ANY enqueued data can be written and write it
-            while (peak(packet_queue) <= expected_sequence && peak(packet_queue) != -1)
+            else if (events[e].data.fd == receiver->timer_fd)
             {
-                if (peak(packet_queue) < expected_sequence)
+                uint64_t expirations;
+                if (read(receiver->timer_fd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN)
                 {
-                    // ensure we never write the same packet twice
-                    QueueNode dequeued_node = dequeue(packet_queue);
-                    continue;
+                    fprintf(stderr, "Timer read failed: %s\n", strerror(errno));
+                    exit(EXIT_FAILURE);
                 }
-                QueueNode dequeued_node = dequeue(packet_queue);
-                total_bytes_written += writeWithRate(dequeued_node.data, dequeued_node.data_len, write_rate, total_bytes_written, start_time, outfile);
-                expected_sequence += 1;
+                // the timer has to be set again even if it fires for the same deadline
+                receiver->timer_fd_deadline = TIMER_WHEEL_NO_TIMER;
+            }
+            else
+            {
+                receive_packets(receiver, now);
             }
-            // send an ack with ack_number = sequence_number received
-            outgoing_header = create_header(0, ack_number, incoming_packet.header.length, ACK_FLAG);
-            outgoing_packet = create_packet(NULL, outgoing_header);
-            send_len = sendto(sock_fd, &outgoing_packet, sizeof(outgoing_packet), 0, (const struct sock_addr *)&client_addr, len);
-            if (send_len < 0)
+        }
+        expire_sessions(receiver, now);
+        if (receiver->options->resume)
+        {
+            save_checkpoint(receiver->shared, now);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Opens and signs the existing copy of the output file for -u. Without a copy there is
+ * nothing to sign, and every transfer is sent whole.
+ *
+ * @param shared The shared receiver state.
+ */
+static void sign_copy(struct receiver_shared *shared)
+{
+    struct stat st;
+    shared->copy_fd = open(shared->destination, O_RDONLY);
+    if (shared->copy_fd < 0)
+    {
+        return;
+    }
+    if (fstat(shared->copy_fd, &st) == 0)
+    {
+        shared->block_size = delta_block_size(st.st_size);
+    }
+    if (shared->block_size == 0
+        || delta_sign(shared->copy_fd, st.st_size, shared->block_size, &shared->signatures, &shared->num_signatures) < 0)
+    {
+        fprintf(stderr, "Cannot sign %s: %s\n", shared->destination, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    fprintf(stderr, "Signed %s: %" PRIu32 " blocks of %" PRIu32 " bytes\n", shared->destination,
+            shared->num_signatures, shared->block_size);
+}
+
+/**
+ * @brief Receives data packets over UDP, writes them to files, and sends acknowledgments.
+ *
+ * Every packet carries the connection ID its sender picked, and each connection has its own
+ * session: agreed parameters, reorder window, ACK state and output file (see session.h). Each
+ * receive thread runs one epoll loop that waits for its socket and for a timerfd set to the
+ * earliest session timer in a timer wheel, so delayed ACKs and inactivity timeouts cost nothing
+ * for sessions that are not due. With more than one socket, each thread binds its own socket to
+ * the port with SO_REUSEPORT and the kernel spreads the connections over them.
+ *
+ * Before sending data the sender proposes a payload size and window in a SYN packet; the receiver
+ * answers with the smaller of them and max_payload / max_window. Packets that arrive ahead of the
+ * next expected one wait in a reorder window of that many slots (see reorder.h).
+ *
+ * In positional mode every packet is written with pwrite() at offset + seq_num * payload_size as
+ * soon as it arrives, into a file preallocated to the size of the transfer, and the reorder window
+ * only tracks which packets arrived. Reordering then costs no copy and no queueing. With I/O
+ * threads those writes are made by the workers of an I/O pool (see iopool.h) rather than the
+ * receive threads. Striped transfers, whose connections each carry one byte range of the file,
+ * are always written positionally into the same file.
+ *
+ * Without -D the receiver serves the first transfer into destination and exits once all of its
+ * stripes have ended. With -D it serves any number of concurrent transfers into files named after
+ * their transfer IDs in the destination directory, always in positional mode, until SIGINT or
+ * SIGTERM. Either signal stops the receiver once the writes already queued are done.
+ *
+ * With -r the receiver keeps a checkpoint of the blocks of the output file written so far next to
+ * it, destination.ckpt (see resume.h), saved every CHECKPOINT_INTERVAL and when the receiver stops.
+ * A sender setting up the same file again only sends what the checkpoint lacks. The checkpoint is
+ * deleted once the file is complete, or if its digest does not match the sender's.
+ *
+ * With -u the receiver updates an existing copy of the file: it signs the blocks of the copy
+ * (see delta.h) and writes the transfer to destination.part, where a sender asking for a delta
+ * transfer has the blocks it found in the copy copied instead of sent. The new file replaces the
+ * copy once every stripe has finished intact, and is deleted otherwise.
+ *
+ * @param udp_port The UDP port to listen for incoming packets.
+ * @param destination The file to write the received data to, or the directory of a daemon.
+ * @param options The write rate, ACK policy, setup limits, write mode, I/O threads and sockets to use.
+ */
+void rrecv(unsigned short int udp_port,
+           char *destination,
+           const struct receiver_options *options)
+{
+    struct receiver_shared shared;
+    memset(&shared, 0, sizeof(shared));
+    shared.options = options;
+    shared.destination = destination;
+    pthread_mutex_init(&shared.lock, NULL);
+
+    shared.copy_fd = -1;
+    char part_path[PATH_MAX];
+    snprintf(part_path, sizeof(part_path), "%s.part", destination);
+    if (options->update)
+    {
+        sign_copy(&shared);
+    }
+    if (!options->daemon)
+    {
+        // a checkpointed file is kept until it is known to belong to another transfer
+        const char *path = options->update ? part_path : destination;
+        shared.single_output = output_open(path, options->write_rate, !options->resume);
+        if (shared.single_output == NULL)
+        {
+            fprintf(stderr, "Output file open failed: %s\n", path);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (options->resume)
+    {
+        char checkpoint_path[PATH_MAX];
+        snprintf(checkpoint_path, sizeof(checkpoint_path), "%s.ckpt", destination);
+        if (checkpoint_open(&shared.checkpoint, checkpoint_path) < 0)
+        {
+            fprintf(stderr, "Cannot load the checkpoint %s\n", checkpoint_path);
+            exit(EXIT_FAILURE);
+        }
+        shared.single_output->checkpoint = &shared.checkpoint;
+        shared.checkpoint_time = now_usec();
+    }
+    if (io_pool_init(&shared.io_pool, options->io_threads) < 0)
+    {
+        fprintf(stderr, "Cannot start I/O threads\n");
+        exit(EXIT_FAILURE);
+    }
+    shared.stop_fd = eventfd(0, EFD_NONBLOCK);
+    if (shared.stop_fd < 0)
+    {
+        fprintf(stderr, "Event loop setup failed: %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    struct receiver *receivers = (struct receiver *)calloc(options->sockets, sizeof(struct receiver));
+    if (receivers == NULL)
+    {
+        fprintf(stderr, "Cannot allocate receive threads\n");
+        exit(EXIT_FAILURE);
+    }
+    for (unsigned int i = 0; i < options->sockets; i++)
+    {
+        open_receiver(&receivers[i], &shared, udp_port);
+    }
+
+    // the signal handler only wakes the threads through stop_fd
+    signal_stop_fd = shared.stop_fd;
+    struct sigaction stop_action;
+    memset(&stop_action, 0, sizeof(stop_action));
+    stop_action.sa_handler = request_stop;
+    sigaction(SIGINT, &stop_action, NULL);
+    sigaction(SIGTERM, &stop_action, NULL);
+
+    if (options->sockets == 1)
+    {
+        receive_loop(&receivers[0]);
+    }
+    else
+    {
+        for (unsigned int i = 0; i < options->sockets; i++)
+        {
+            if (pthread_create(&receivers[i].thread, NULL, receive_loop, &receivers[i]) != 0)
             {
-                fprintf(stderr, "Ack send failed: %d\n", send_len);
+                fprintf(stderr, "Cannot start receive thread %u\n", i);
                 exit(EXIT_FAILURE);
             }
         }
+        for (unsigned int i = 0; i < options->sockets; i++)
+        {
+            pthread_join(receivers[i].thread, NULL);
+        }
     }
-        
-    free(packet_queue);
-    fclose(outfile);
 
-    close(sock_fd);
-    exit(EXIT_SUCCESS);
+    // writes still queued to the workers hold their file open until they are done
+    for (unsigned int i = 0; i < options->sockets; i++)
+    {
+        close_receiver(&receivers[i]);
+    }
+    while (shared.transfers != NULL)
+    {
+        struct transfer *transfer = shared.transfers;
+        shared.transfers = transfer->next;
+        output_release(transfer->output);
+        free(transfer);
+    }
+    io_pool_free(&shared.io_pool);
+    if (options->resume)
+    {
+        // every write is done; a complete or corrupted file has nothing left to resume
+        if (shared.corrupted || checkpoint_complete(&shared.checkpoint))
+        {
+            checkpoint_remove(&shared.checkpoint);
+        }
+        else if (checkpoint_save(&shared.checkpoint, shared.single_output->fd) < 0)
+        {
+            fprintf(stderr, "Checkpoint save failed: %s\n", strerror(errno));
+        }
+        checkpoint_free(&shared.checkpoint);
+    }
+    if (shared.single_output != NULL)
+    {
+        output_release(shared.single_output);
+    }
+    if (options->update)
+    {
+        // the copy is only replaced by a whole, intact new version
+        if (!shared.corrupted && shared.stripes > 0 && shared.stripes_finished == shared.stripes)
+        {
+            if (rename(part_path, destination) < 0)
+            {
+                fprintf(stderr, "Cannot replace %s: %s\n", destination, strerror(errno));
+                shared.corrupted = true;
+            }
+        }
+        else
+        {
+            unlink(part_path);
+            fprintf(stderr, "Transfer incomplete, %s left as it was\n", destination);
+        }
+        if (shared.copy_fd >= 0)
+        {
+            close(shared.copy_fd);
+        }
+        free(shared.signatures);
+    }
+    free(receivers);
+    close(shared.stop_fd);
+    pthread_mutex_destroy(&shared.lock);
+    exit(shared.corrupted ? EXIT_FAILURE : EXIT_SUCCESS);
 }
 
 int main(int argc, char **argv)
 {
 
     unsigned short int udp_port;
-    char *destination_file;
-    unsigned long long int write_rate;
+    char *destination;
+    struct receiver_options options;
+    int opt;
+
+    options.ack_every = DEFAULT_ACK_EVERY;
+    options.ack_delay = DEFAULT_ACK_DELAY;
+    options.max_payload = MAX_PAYLOAD_SZ;
+    options.max_window = DEFAULT_MAX_WINDOW;
+    options.positional = false;
+    options.io_threads = 0;
+    options.sockets = 1;
+    options.daemon = false;
+    options.resume = false;
+    options.update = false;
+
+    while ((opt = getopt(argc, argv, "a:d:p:w:ot:s:Dru")) != -1)
+    {
+        switch (opt)
+        {
+        case 'a':
+            options.ack_every = (unsigned int)atoi(optarg);
+            break;
+        case 'd':
+            options.ack_delay = (uint64_t)atoll(optarg);
+            break;
+        case 'p':
+            options.max_payload = (uint32_t)atoi(optarg);
+            if (options.max_payload == 0 || options.max_payload > MAX_PAYLOAD_SZ)
+            {
+                fprintf(stderr, "max payload must be between 1 and %d bytes\n", MAX_PAYLOAD_SZ);
+                exit(1);
+            }
+            break;
+        case 'w':
+            options.max_window = (uint32_t)atoi(optarg);
+            if (options.max_window == 0)
+            {
+                fprintf(stderr, "max window must be at least 1 packet\n");
+                exit(1);
+            }
+            break;
+        case 'o':
+            options.positional = true;
+            break;
+        case 't':
+            options.io_threads = (unsigned int)atoi(optarg);
+            break;
+        case 's':
+            options.sockets = (unsigned int)atoi(optarg);
+            if (options.sockets == 0 || options.sockets > MAX_SOCKETS)
+            {
+                fprintf(stderr, "sockets must be between 1 and %d\n", MAX_SOCKETS);
+                exit(1);
+            }
+            break;
+        case 'D':
+            options.daemon = true;
+            break;
+        case 'r':
+            options.resume = true;
+            break;
+        case 'u':
+            options.update = true;
+            break;
+        default:
+            fprintf(stderr, RECEIVER_USAGE, argv[0]);
+            exit(1);
+        }
+    }
+
+    if (options.resume && options.daemon)
+    {
+        fprintf(stderr, "-r checkpoints the output file of a single transfer and cannot be combined with -D\n");
+        exit(1);
+    }
+    if (options.update && (options.daemon || options.resume))
+    {
+        fprintf(stderr, "-u updates the output file of a single transfer and cannot be combined with -D or -r\n");
+        exit(1);
+    }
 
-    if (argc != 4)
+    if (argc - optind != 3)
     {
-        fprintf(stderr, "usage: %s UDP_port filename_to_write writerate\n\n", argv[0]);
+        fprintf(stderr, RECEIVER_USAGE, argv[0]);
         exit(1);
     }
 
-    udp_port = (unsigned short int)atoi(argv[1]);
-    destination_file = argv[2];
-    write_rate = (unsigned long long int)atoi(argv[3]);
+    udp_port = (unsigned short int)atoi(argv[optind]);
+    destination = argv[optind + 1];
+    options.write_rate = (unsigned long long int)atoll(argv[optind + 2]);
 
-    rrecv(udp_port, destination_file, write_rate);
+    rrecv(udp_port, destination, &options);
 }
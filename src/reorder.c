@@ -0,0 +1,178 @@
+/**
+ * @file reorder.c
+ * @brief Receiver reorder window: a circular buffer of packets received ahead of the next
+ * expected sequence number, indexed by seq_num % window with an occupancy bitmap.
+ * @author Connor Johst - cjohst & Aaditya Suri - AadityaSuri
+ * @bug No known bugs
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "reorder.h"
+
+#define BITMAP_WORDS(bits) (((bits) + 63) / 64) // 64-bit words needed for a bitmap of bits bits
+
+/**
+ * @brief Allocates an empty reorder window.
+ *
+ * @param reorder The reorder window to initialize.
+ * @param window Number of slots.
+ * @param slot_size Largest payload of a packet, or 0 to only track which packets arrived.
+ * @return 0 on success, -1 if the slots could not be allocated.
+ */
+
+int reorder_init(reorder_buffer_t* reorder, uint32_t window, size_t slot_size){
+    reorder->window = window;
+    reorder->slot_size = slot_size;
+    reorder->count = 0;
+    reorder->pool = NULL;
+    reorder->lengths = NULL;
+    if (slot_size > 0){
+        reorder->pool = (unsigned char*) malloc((size_t) window * slot_size);
+        reorder->lengths = (uint16_t*) calloc(window, sizeof(uint16_t));
+    }
+    reorder->occupied = (uint64_t*) calloc(BITMAP_WORDS(window), sizeof(uint64_t));
+    if ((slot_size > 0 && (reorder->pool == NULL || reorder->lengths == NULL)) || reorder->occupied == NULL){
+        reorder_free(reorder);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Frees the slots of a reorder window.
+ *
+ * @param reorder The reorder window.
+ */
+
+void reorder_free(reorder_buffer_t* reorder){
+    free(reorder->pool);
+    free(reorder->lengths);
+    free(reorder->occupied);
+    reorder->pool = NULL;
+    reorder->lengths = NULL;
+    reorder->occupied = NULL;
+    reorder->count = 0;
+}
+
+/**
+ * @brief Checks whether a slot holds a packet.
+ *
+ * @param reorder The reorder window.
+ * @param slot The slot.
+ * @return true if the slot is occupied.
+ */
+
+static bool reorder_occupied(const reorder_buffer_t* reorder, uint32_t slot){
+    return (reorder->occupied[slot / 64] >> (slot % 64)) & 1;
+}
+
+/**
+ * @brief Copies a packet received ahead of the next expected one into its slot.
+ *
+ * @param reorder The reorder window.
+ * @param expected The next sequence number expected in order.
+ * @param seq Sequence number of the packet, above expected.
+ * @param data Payload of the packet, ignored when slot_size is 0.
+ * @param len Length of the payload, at most slot_size.
+ * @return REORDER_STORED, REORDER_DUPLICATE, or REORDER_OUTSIDE if seq is not within the window.
+ */
+
+int reorder_insert(reorder_buffer_t* reorder, uint32_t expected, uint32_t seq, const unsigned char* data, size_t len){
+    if (seq < expected || seq - expected >= reorder->window || (reorder->slot_size > 0 && len > reorder->slot_size)){
+        return REORDER_OUTSIDE;
+    }
+
+    uint32_t slot = seq % reorder->window;
+    if (reorder_occupied(reorder, slot)){
+        return REORDER_DUPLICATE;
+    }
+    if (reorder->slot_size > 0){
+        memcpy(reorder->pool + (size_t) slot * reorder->slot_size, data, len);
+        reorder->lengths[slot] = len;
+    }
+    reorder->occupied[slot / 64] |= 1ULL << (slot % 64);
+    reorder->count++;
+    return REORDER_STORED;
+}
+
+/**
+ * @brief Forgets the packet with sequence number seq, if it arrived.
+ *
+ * @param reorder The reorder window.
+ * @param seq The next sequence number expected in order.
+ * @return true if seq had arrived.
+ */
+
+bool reorder_remove(reorder_buffer_t* reorder, uint32_t seq){
+    if (reorder->count == 0){
+        return false;
+    }
+    uint32_t slot = seq % reorder->window;
+    if (!reorder_occupied(reorder, slot)){
+        return false;
+    }
+    reorder->occupied[slot / 64] &= ~(1ULL << (slot % 64));
+    reorder->count--;
+    return true;
+}
+
+/**
+ * @brief Takes the packet with sequence number seq out of the window, if it is buffered.
+ *
+ * @param reorder The reorder window, with slot_size above 0.
+ * @param seq The next sequence number expected in order.
+ * @param len Set to the payload length of the packet.
+ * @return The payload, valid until the next reorder_insert(), or NULL if seq is not buffered.
+ */
+
+const unsigned char* reorder_take(reorder_buffer_t* reorder, uint32_t seq, size_t* len){
+    if (!reorder_remove(reorder, seq)){
+        return NULL;
+    }
+    uint32_t slot = seq % reorder->window;
+    *len = reorder->lengths[slot];
+    return reorder->pool + (size_t) slot * reorder->slot_size;
+}
+
+/**
+ * @brief Describes the lowest ranges of buffered packets as SACK blocks.
+ *
+ * Walks the window from expected upwards, one bitmap bit per sequence number, and stops once
+ * every buffered packet has been covered or max_blocks ranges have been found.
+ *
+ * @param reorder The reorder window.
+ * @param expected The next sequence number expected in order.
+ * @param blocks Destination array.
+ * @param max_blocks Capacity of blocks.
+ * @return The number of blocks written.
+ */
+
+size_t reorder_encode_sack(const reorder_buffer_t* reorder, uint32_t expected, sack_block_t* blocks, size_t max_blocks){
+    size_t n = 0;
+    unsigned int covered = 0;
+    bool in_range = false;
+
+    for (uint32_t offset = 1; offset < reorder->window && covered < reorder->count; offset++){
+        uint32_t seq = expected + offset;
+        if (reorder_occupied(reorder, seq % reorder->window)){
+            covered++;
+            if (!in_range){
+                if (n == max_blocks){
+                    break;
+                }
+                blocks[n].start = seq;
+                in_range = true;
+                n++;
+            }
+            blocks[n - 1].end = seq + 1;
+        } else {
+            in_range = false;
+        }
+    }
+    return n;
+}
@@ -0,0 +1,562 @@
+/**
+ * @file resume.c
+ * @brief Resuming interrupted transfers: the receiver's checkpoint of the blocks of a file it
+ * wrote, and the packets a connection still has to carry.
+ * @author Connor Johst - cjohst & Aaditya Suri - AadityaSuri
+ * @bug No known bugs
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+
+#include "resume.h"
+#include "crc32c.h"
+
+#define CHECKPOINT_MAGIC 0x54504b43 // "CKPT"
+
+/**
+ * @struct checkpoint_header
+ * @brief What precedes the bitmap in a checkpoint file.
+ */
+struct checkpoint_header {
+    uint32_t magic;         /**< CHECKPOINT_MAGIC. */
+    uint32_t block_size;    /**< RESUME_BLOCK_SZ when the file was saved. */
+    uint64_t file_size;     /**< Size of the file the blocks belong to. */
+    uint64_t file_version;  /**< Version of the file the blocks belong to. */
+    uint32_t bits_crc;      /**< CRC32C of the bitmap. */
+    uint32_t header_crc;    /**< CRC32C of the fields above. */
+};
+
+/**
+ * @brief Returns the number of bytes of a block, the last block of a file being shorter.
+ *
+ * @param checkpoint The checkpoint.
+ * @param block The block.
+ * @return Its length.
+ */
+
+static uint64_t checkpoint_block_len(const checkpoint_t* checkpoint, uint64_t block){
+    uint64_t start = block * RESUME_BLOCK_SZ;
+    return checkpoint->file_size - start < RESUME_BLOCK_SZ ? checkpoint->file_size - start : RESUME_BLOCK_SZ;
+}
+
+/**
+ * @brief Allocates the bitmap and counters of a file, all blocks not done.
+ *
+ * @param checkpoint The checkpoint, without any.
+ * @param file_size Size of the file.
+ * @param file_version Version of the file.
+ * @return 0 on success, -1 if memory runs out.
+ */
+
+static int checkpoint_alloc(checkpoint_t* checkpoint, uint64_t file_size, uint64_t file_version){
+    checkpoint->file_size = file_size;
+    checkpoint->file_version = file_version;
+    checkpoint->num_blocks = resume_blocks(0, file_size);
+    checkpoint->blocks_done = 0;
+    checkpoint->done = (uint8_t*) calloc((checkpoint->num_blocks + 7) / 8 + 1, 1);
+    checkpoint->received = (uint32_t*) calloc(checkpoint->num_blocks + 1, sizeof(uint32_t));
+    if (checkpoint->done == NULL || checkpoint->received == NULL){
+        free(checkpoint->done);
+        free(checkpoint->received);
+        checkpoint->done = NULL;
+        checkpoint->received = NULL;
+        checkpoint->file_size = 0;
+        checkpoint->num_blocks = 0;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Reads the checkpoint file, keeping its blocks if it is intact.
+ *
+ * @param checkpoint The checkpoint, without blocks; still without any if the file is missing or
+ * damaged.
+ */
+
+static void checkpoint_load(checkpoint_t* checkpoint){
+    FILE* file = fopen(checkpoint->path, "rb");
+    if (file == NULL){
+        return;
+    }
+    struct checkpoint_header header;
+    if (fread(&header, sizeof(header), 1, file) == 1 && header.magic == CHECKPOINT_MAGIC
+        && header.block_size == RESUME_BLOCK_SZ
+        && header.header_crc == crc32c(0, &header, offsetof(struct checkpoint_header, header_crc))
+        && checkpoint_alloc(checkpoint, header.file_size, header.file_version) == 0){
+        size_t bitmap_len = (checkpoint->num_blocks + 7) / 8;
+        if (fread(checkpoint->done, 1, bitmap_len, file) == bitmap_len
+            && crc32c(0, checkpoint->done, bitmap_len) == header.bits_crc){
+            for (uint64_t b = 0; b < checkpoint->num_blocks; b++){
+                checkpoint->blocks_done += (checkpoint->done[b / 8] >> (b % 8)) & 1;
+            }
+        } else {
+            free(checkpoint->done);
+            free(checkpoint->received);
+            checkpoint->done = NULL;
+            checkpoint->received = NULL;
+        }
+    }
+    fclose(file);
+}
+
+/**
+ * @brief Loads the checkpoint saved at path, or starts an empty one if there is none or it is
+ * damaged.
+ *
+ * @param checkpoint The checkpoint.
+ * @param path The checkpoint file.
+ * @return 0 on success, -1 if memory runs out.
+ */
+
+int checkpoint_open(checkpoint_t* checkpoint, const char* path){
+    memset(checkpoint, 0, sizeof(*checkpoint));
+    checkpoint->path = strdup(path);
+    if (checkpoint->path == NULL){
+        return -1;
+    }
+    pthread_mutex_init(&checkpoint->lock, NULL);
+    pthread_mutex_init(&checkpoint->save_lock, NULL);
+    checkpoint_load(checkpoint);
+    if (checkpoint->done == NULL && checkpoint_alloc(checkpoint, 0, 0) < 0){
+        checkpoint_free(checkpoint);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Checks whether the checkpoint belongs to a file.
+ *
+ * @param checkpoint The checkpoint.
+ * @param file_size Size of the file.
+ * @param file_version Version of the file.
+ * @return true if the blocks done are blocks of that file.
+ */
+
+bool checkpoint_matches(checkpoint_t* checkpoint, uint64_t file_size, uint64_t file_version){
+    pthread_mutex_lock(&checkpoint->lock);
+    bool matches = checkpoint->file_size == file_size && checkpoint->file_version == file_version;
+    pthread_mutex_unlock(&checkpoint->lock);
+    return matches;
+}
+
+/**
+ * @brief Forgets every block and starts over for a file.
+ *
+ * @param checkpoint The checkpoint.
+ * @param file_size Size of the file.
+ * @param file_version Version of the file.
+ * @return 0 on success, -1 if memory runs out.
+ */
+
+int checkpoint_reset(checkpoint_t* checkpoint, uint64_t file_size, uint64_t file_version){
+    pthread_mutex_lock(&checkpoint->lock);
+    free(checkpoint->done);
+    free(checkpoint->received);
+    int result = checkpoint_alloc(checkpoint, file_size, file_version);
+    checkpoint->dirty = true;
+    pthread_mutex_unlock(&checkpoint->lock);
+    return result;
+}
+
+/**
+ * @brief Records that bytes of the file were written. Each byte must be recorded once.
+ *
+ * @param checkpoint The checkpoint.
+ * @param offset Offset of the bytes in the file.
+ * @param len Number of bytes.
+ */
+
+void checkpoint_mark(checkpoint_t* checkpoint, uint64_t offset, uint64_t len){
+    pthread_mutex_lock(&checkpoint->lock);
+    uint64_t end = offset + len < checkpoint->file_size ? offset + len : checkpoint->file_size;
+    while (offset < end){
+        uint64_t block = offset / RESUME_BLOCK_SZ;
+        uint64_t block_end = (block + 1) * RESUME_BLOCK_SZ < end ? (block + 1) * RESUME_BLOCK_SZ : end;
+        uint8_t bit = 1 << (block % 8);
+        if (!(checkpoint->done[block / 8] & bit)){
+            checkpoint->received[block] += block_end - offset;
+            if (checkpoint->received[block] >= checkpoint_block_len(checkpoint, block)){
+                checkpoint->done[block / 8] |= bit;
+                checkpoint->blocks_done++;
+                checkpoint->dirty = true;
+            }
+        }
+        offset = block_end;
+    }
+    pthread_mutex_unlock(&checkpoint->lock);
+}
+
+/**
+ * @brief Copies the bits of the blocks covering a byte range of the file.
+ *
+ * @param checkpoint The checkpoint.
+ * @param offset Offset of the range.
+ * @param len Length of the range.
+ * @param bits Receives one bit per block from the block holding offset, (blocks + 7) / 8 bytes.
+ * @return The bytes of the range in done blocks.
+ */
+
+uint64_t checkpoint_snapshot(checkpoint_t* checkpoint, uint64_t offset, uint64_t len, uint8_t* bits){
+    uint64_t first = offset / RESUME_BLOCK_SZ;
+    uint64_t blocks = resume_blocks(offset, len);
+    uint64_t present = 0;
+    memset(bits, 0, (blocks + 7) / 8);
+
+    pthread_mutex_lock(&checkpoint->lock);
+    for (uint64_t i = 0; i < blocks && first + i < checkpoint->num_blocks; i++){
+        uint64_t block = first + i;
+        if (checkpoint->done[block / 8] & (1 << (block % 8))){
+            bits[i / 8] |= 1 << (i % 8);
+            uint64_t start = block * RESUME_BLOCK_SZ > offset ? block * RESUME_BLOCK_SZ : offset;
+            uint64_t end = block * RESUME_BLOCK_SZ + checkpoint_block_len(checkpoint, block);
+            present += (end < offset + len ? end : offset + len) - start;
+        }
+    }
+    pthread_mutex_unlock(&checkpoint->lock);
+    return present;
+}
+
+/**
+ * @brief Checks whether every block of the file is done.
+ *
+ * @param checkpoint The checkpoint.
+ * @return true if the whole file was written.
+ */
+
+bool checkpoint_complete(checkpoint_t* checkpoint){
+    pthread_mutex_lock(&checkpoint->lock);
+    bool complete = checkpoint->blocks_done == checkpoint->num_blocks;
+    pthread_mutex_unlock(&checkpoint->lock);
+    return complete;
+}
+
+/**
+ * @brief Saves the checkpoint if blocks were done since the last save: syncs the file the blocks
+ * were written to, then replaces the checkpoint file. Returns at once if another thread is saving.
+ *
+ * The bitmap is copied before the sync, so it only lists blocks whose bytes the sync made durable,
+ * and the new file is renamed over the old one, so a crash leaves one or the other.
+ *
+ * @param checkpoint The checkpoint.
+ * @param data_fd The file the blocks were written to.
+ * @return 0 on success, -1 on error.
+ */
+
+int checkpoint_save(checkpoint_t* checkpoint, int data_fd){
+    if (pthread_mutex_trylock(&checkpoint->save_lock) != 0){
+        return 0;
+    }
+
+    pthread_mutex_lock(&checkpoint->lock);
+    if (!checkpoint->dirty){
+        pthread_mutex_unlock(&checkpoint->lock);
+        pthread_mutex_unlock(&checkpoint->save_lock);
+        return 0;
+    }
+    size_t bitmap_len = (checkpoint->num_blocks + 7) / 8;
+    unsigned char* buffer = (unsigned char*) malloc(sizeof(struct checkpoint_header) + bitmap_len);
+    if (buffer == NULL){
+        pthread_mutex_unlock(&checkpoint->lock);
+        pthread_mutex_unlock(&checkpoint->save_lock);
+        return -1;
+    }
+    struct checkpoint_header header;
+    memset(&header, 0, sizeof(header));
+    header.magic = CHECKPOINT_MAGIC;
+    header.block_size = RESUME_BLOCK_SZ;
+    header.file_size = checkpoint->file_size;
+    header.file_version = checkpoint->file_version;
+    header.bits_crc = crc32c(0, checkpoint->done, bitmap_len);
+    header.header_crc = crc32c(0, &header, offsetof(struct checkpoint_header, header_crc));
+    memcpy(buffer, &header, sizeof(header));
+    memcpy(buffer + sizeof(header), checkpoint->done, bitmap_len);
+    checkpoint->dirty = false;
+    pthread_mutex_unlock(&checkpoint->lock);
+
+    char temp_path[PATH_MAX];
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", checkpoint->path);
+    size_t len = sizeof(header) + bitmap_len;
+    int result = -1;
+    if (fdatasync(data_fd) == 0){
+        int fd = open(temp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd >= 0){
+            bool written = write(fd, buffer, len) == (ssize_t) len && fdatasync(fd) == 0;
+            close(fd);
+            if (written && rename(temp_path, checkpoint->path) == 0){
+                result = 0;
+            }
+        }
+    }
+    free(buffer);
+
+    if (result < 0){
+        // try again next time
+        pthread_mutex_lock(&checkpoint->lock);
+        checkpoint->dirty = true;
+        pthread_mutex_unlock(&checkpoint->lock);
+    }
+    pthread_mutex_unlock(&checkpoint->save_lock);
+    return result;
+}
+
+/**
+ * @brief Deletes the checkpoint file, once the file is complete or not worth resuming.
+ *
+ * @param checkpoint The checkpoint.
+ */
+
+void checkpoint_remove(checkpoint_t* checkpoint){
+    unlink(checkpoint->path);
+}
+
+/**
+ * @brief Releases the memory of a checkpoint.
+ *
+ * @param checkpoint The checkpoint.
+ */
+
+void checkpoint_free(checkpoint_t* checkpoint){
+    free(checkpoint->path);
+    free(checkpoint->done);
+    free(checkpoint->received);
+    pthread_mutex_destroy(&checkpoint->lock);
+    pthread_mutex_destroy(&checkpoint->save_lock);
+    memset(checkpoint, 0, sizeof(*checkpoint));
+}
+
+/**
+ * @brief Returns the number of blocks covering a byte range of a file.
+ *
+ * @param offset Offset of the range.
+ * @param len Length of the range.
+ * @return The number of blocks, counted from the block holding offset.
+ */
+
+uint64_t resume_blocks(uint64_t offset, uint64_t len){
+    return len == 0 ? 0 : (offset + len - 1) / RESUME_BLOCK_SZ - offset / RESUME_BLOCK_SZ + 1;
+}
+
+/**
+ * @brief Appends a range to a list.
+ *
+ * @param list The list, zeroed when empty.
+ * @param start Offset of the first byte.
+ * @param end Offset one past the last byte.
+ * @return 0 on success, -1 if memory runs out.
+ */
+
+int byte_ranges_add(byte_ranges_t* list, uint64_t start, uint64_t end){
+    if (list->count == list->capacity){
+        size_t capacity = list->capacity > 0 ? list->capacity * 2 : 16;
+        byte_range_t* ranges = (byte_range_t*) realloc(list->ranges, capacity * sizeof(byte_range_t));
+        if (ranges == NULL){
+            return -1;
+        }
+        list->ranges = ranges;
+        list->capacity = capacity;
+    }
+    list->ranges[list->count].start = start;
+    list->ranges[list->count].end = end;
+    list->count++;
+    return 0;
+}
+
+/**
+ * @brief Releases the memory of a list.
+ *
+ * @param list The list.
+ */
+
+void byte_ranges_free(byte_ranges_t* list){
+    free(list->ranges);
+    list->ranges = NULL;
+    list->count = 0;
+    list->capacity = 0;
+}
+
+/**
+ * @brief Adds the bytes of a stripe in done blocks to a list of ranges.
+ *
+ * @param list The list.
+ * @param present Bits of the blocks covering the stripe (see checkpoint_snapshot()).
+ * @param offset Offset of the stripe in the file.
+ * @param total_bytes Length of the stripe.
+ * @return 0 on success, -1 if memory runs out.
+ */
+
+int resume_present_ranges(byte_ranges_t* list, const uint8_t* present, uint64_t offset, uint64_t total_bytes){
+    uint64_t first = offset / RESUME_BLOCK_SZ;
+    uint64_t blocks = resume_blocks(offset, total_bytes);
+    for (uint64_t i = 0; i < blocks; i++){
+        if (present[i / 8] & (1 << (i % 8))){
+            uint64_t start = (first + i) * RESUME_BLOCK_SZ;
+            uint64_t end = start + RESUME_BLOCK_SZ;
+            if (byte_ranges_add(list, start > offset ? start : offset,
+                                end < offset + total_bytes ? end : offset + total_bytes) < 0){
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Orders two ranges by their first byte, for qsort().
+ *
+ * @param a First range.
+ * @param b Second range.
+ * @return Negative, zero or positive as a starts before, with or after b.
+ */
+
+static int byte_range_compare(const void* a, const void* b){
+    uint64_t start_a = ((const byte_range_t*) a)->start;
+    uint64_t start_b = ((const byte_range_t*) b)->start;
+    return start_a < start_b ? -1 : start_a > start_b;
+}
+
+/**
+ * @brief Appends a run to a map, growing its arrays as needed.
+ *
+ * @param map The map.
+ * @param capacity Number of runs the arrays hold, updated.
+ * @param first First packet of the stripe of the run.
+ * @param start First packet carried of the run.
+ * @return 0 on success, -1 if memory runs out.
+ */
+
+static int resume_map_push(resume_map_t* map, size_t* capacity, uint32_t first, uint32_t start){
+    // starts keeps one more entry, the number of packets carried
+    if (map->runs + 1 >= *capacity){
+        size_t grown = *capacity * 2;
+        uint32_t* firsts = (uint32_t*) realloc(map->firsts, grown * sizeof(uint32_t));
+        if (firsts != NULL){
+            map->firsts = firsts;
+        }
+        uint32_t* starts = (uint32_t*) realloc(map->starts, grown * sizeof(uint32_t));
+        if (starts != NULL){
+            map->starts = starts;
+        }
+        if (firsts == NULL || starts == NULL){
+            return -1;
+        }
+        *capacity = grown;
+    }
+    map->firsts[map->runs] = first;
+    map->starts[map->runs] = start;
+    map->runs++;
+    return 0;
+}
+
+/**
+ * @brief Builds the map of the packets of a stripe holding bytes the receiver does not have.
+ *
+ * A packet is left out only if the ranges cover all of its bytes, so a packet straddling a range
+ * the receiver has and one it lacks is carried whole, and every byte it lacks is carried once.
+ *
+ * @param map The map.
+ * @param covered Ranges of the file the receiver has, in any order, possibly overlapping; sorted
+ * and merged in place. NULL to carry every packet.
+ * @param offset Offset of the stripe in the file.
+ * @param total_bytes Length of the stripe.
+ * @param payload_size Bytes of data per packet.
+ * @return 0 on success, -1 if memory runs out.
+ */
+
+int resume_map_build(resume_map_t* map, byte_ranges_t* covered, uint64_t offset, uint64_t total_bytes,
+                     uint32_t payload_size){
+    size_t capacity = 16;
+    memset(map, 0, sizeof(*map));
+    map->firsts = (uint32_t*) malloc(capacity * sizeof(uint32_t));
+    map->starts = (uint32_t*) malloc(capacity * sizeof(uint32_t));
+    if (map->firsts == NULL || map->starts == NULL){
+        resume_map_free(map);
+        return -1;
+    }
+
+    // sorted ranges, with the ones that overlap or touch merged
+    size_t ranges = 0;
+    if (covered != NULL && covered->count > 0){
+        qsort(covered->ranges, covered->count, sizeof(byte_range_t), byte_range_compare);
+        for (size_t r = 1; r < covered->count; r++){
+            if (covered->ranges[r].start <= covered->ranges[ranges].end){
+                if (covered->ranges[r].end > covered->ranges[ranges].end){
+                    covered->ranges[ranges].end = covered->ranges[r].end;
+                }
+            } else {
+                covered->ranges[++ranges] = covered->ranges[r];
+            }
+        }
+        covered->count = ranges + 1;
+    }
+
+    uint64_t packets = (total_bytes + payload_size - 1) / payload_size;
+    uint32_t carried = 0;
+    bool carrying = false;
+    size_t r = 0;
+    for (uint64_t i = 0; i < packets; i++){
+        uint64_t start = offset + i * payload_size;
+        uint64_t end = start + payload_size < offset + total_bytes ? start + payload_size : offset + total_bytes;
+        while (covered != NULL && r < covered->count && covered->ranges[r].end <= start){
+            r++;
+        }
+        bool missing = covered == NULL || r == covered->count
+                       || covered->ranges[r].start > start || covered->ranges[r].end < end;
+        if (missing){
+            if (!carrying && resume_map_push(map, &capacity, i, carried) < 0){
+                resume_map_free(map);
+                return -1;
+            }
+            carried++;
+            map->bytes += end - start;
+        }
+        carrying = missing;
+    }
+    map->starts[map->runs] = carried;
+    return 0;
+}
+
+/**
+ * @brief Returns the packet of the stripe a packet carried holds.
+ *
+ * @param map The map.
+ * @param seq Number of the packet carried.
+ * @return Number of the packet of the stripe.
+ */
+
+uint32_t resume_map_packet(const resume_map_t* map, uint32_t seq){
+    // the last run whose first packet carried is not beyond seq
+    size_t low = 0;
+    size_t high = map->runs;
+    while (high - low > 1){
+        size_t mid = (low + high) / 2;
+        if (map->starts[mid] <= seq){
+            low = mid;
+        } else {
+            high = mid;
+        }
+    }
+    return map->firsts[low] + (seq - map->starts[low]);
+}
+
+/**
+ * @brief Releases the memory of a map. A zeroed map may be freed too.
+ *
+ * @param map The map.
+ */
+
+void resume_map_free(resume_map_t* map){
+    free(map->firsts);
+    free(map->starts);
+    map->firsts = NULL;
+    map->starts = NULL;
+    map->runs = 0;
+}
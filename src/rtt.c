@@ -0,0 +1,83 @@
+/**
+ * @file rtt.c
+ * @brief Round trip time estimation and retransmission timeout calculation (RFC 6298).
+ * @author Connor Johst - cjohst & Aaditya Suri - AadityaSuri
+ * @bug No known bugs
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "rtt.h"
+
+#define clamp(v, lo, hi) ((v) < (lo) ? (lo) : ((v) > (hi) ? (hi) : (v)))
+
+/**
+ * @brief Computes the un-backed-off RTO from the smoothed RTT and variance.
+ *
+ * @param rtt The estimator.
+ * @return The RTO in microseconds, clamped to [RTO_MIN_US, RTO_MAX_US]. It covers the peer's
+ * max_ack_delay, since the last packet of a flight may only be acknowledged once that expires.
+ */
+
+static uint64_t rtt_base_rto(const rtt_estimator_t* rtt){
+    uint64_t variance_term = 4 * rtt->rttvar;
+    if (variance_term < RTO_GRANULARITY_US){
+        variance_term = RTO_GRANULARITY_US;
+    }
+    return clamp(rtt->srtt + variance_term + rtt->max_ack_delay, RTO_MIN_US, RTO_MAX_US);
+}
+
+/**
+ * @brief Initializes an RTT estimator with the initial RTO.
+ *
+ * @param rtt The estimator to initialize.
+ */
+
+void rtt_init(rtt_estimator_t* rtt){
+    rtt->srtt = 0;
+    rtt->rttvar = 0;
+    rtt->min_rtt = 0;
+    rtt->rto = RTO_INITIAL_US;
+    rtt->backoff = 0;
+    rtt->has_sample = false;
+    rtt->max_ack_delay = 0;
+}
+
+/**
+ * @brief Feeds a new RTT measurement into the estimator and recomputes the RTO.
+ *
+ * @param rtt The estimator.
+ * @param sample_us The measured round trip time in microseconds.
+ */
+
+void rtt_sample(rtt_estimator_t* rtt, uint64_t sample_us){
+    if (!rtt->has_sample || sample_us < rtt->min_rtt){
+        rtt->min_rtt = sample_us;
+    }
+
+    if (!rtt->has_sample){
+        rtt->srtt = sample_us;
+        rtt->rttvar = sample_us / 2;
+        rtt->has_sample = true;
+    } else {
+        uint64_t delta = rtt->srtt > sample_us ? rtt->srtt - sample_us : sample_us - rtt->srtt;
+        // rttvar = 3/4 rttvar + 1/4 |srtt - R|, srtt = 7/8 srtt + 1/8 R
+        rtt->rttvar = (3 * rtt->rttvar + delta) / 4;
+        rtt->srtt = (7 * rtt->srtt + sample_us) / 8;
+    }
+
+    rtt->backoff = 0;
+    rtt->rto = rtt_base_rto(rtt);
+}
+
+/**
+ * @brief Doubles the RTO after a retransmission timeout, up to RTO_MAX_US.
+ *
+ * @param rtt The estimator.
+ */
+
+void rtt_backoff(rtt_estimator_t* rtt){
+    rtt->backoff++;
+    rtt->rto = rtt->rto * 2 > RTO_MAX_US ? RTO_MAX_US : rtt->rto * 2;
+}
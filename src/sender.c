@@ -13,11 +13,14 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
 #include <stdbool.h>
 #include <inttypes.h>
+#include <limits.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
+#include <netdb.h>
 #include <fcntl.h>
 #include <time.h>
 
@@ -25,16 +28,41 @@
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/time.h>
+#include <sys/random.h>
 #include <unistd.h>
 
 #include <pthread.h>
 #include <errno.h>
 
 #include "packet.h"
+#include "rtt.h"
+#include "timeutil.h"
+#include "timerwheel.h"
+#include "congestion.h"
+#include "batchio.h"
+#include "filesource.h"
+#include "pacer.h"
+#include "crc32c.h"
+#include "fec.h"
+#include "resume.h"
+#include "delta.h"
+#include "compress.h"
 
-#define ACK_TIMEOUT 150 // Timeout for ACKs in milliseconds.
-#define FIN_ACK_WAIT 100 // Time to wait for FIN ACKs in microseconds.
-#define MAX_FIN_SENT 10 // Maximum number of times to send FIN packets before giving up.
+#define DEFAULT_WINDOW_SIZE 64 // Default number of unacknowledged packets allowed in flight.
+#define MAX_STRIPES 64 // Most stripes a file may be split into.
+#define STRIPE_ALIGN 65536 // Stripes start at multiples of this many bytes.
+#define DEFAULT_CONGESTION "cubic" // Default congestion control algorithm.
+#define DUP_THRESHOLD 3 // Packets acked above a hole before the hole is declared lost.
+#define TIMER_WHEEL_SLOTS 1024 // Number of slots in the retransmission timer wheel.
+#define TIMER_WHEEL_TICK 1000 // Resolution of the retransmission timer wheel in microseconds.
+#define MAX_SYN_SENT 10 // Maximum number of times to send the setup request before giving up.
+#define UDP_IP_OVERHEAD 28 // Bytes of IPv4 and UDP headers in front of every packet.
+#define STATS_INTERVAL 1000000 // Time between two statistics lines with -v, in microseconds.
+#define PARITY_SETS 4 // Groups whose parity packets may still be read by zerocopy sends.
+#define PROBE_MIN_INTERVAL 200000 // Shortest time between two zero-window probes, in microseconds.
+#define TABLE_WINDOW 32 // Chunks of a setup table asked for or sent before waiting for answers.
+
+#define SENDER_USAGE "usage: %s [-w window_size] [-c reno|cubic|bbr] [-g] [-b] [-p max_payload] [-k] [-v] [-s stripes] [-z] [-f data:parity] [-d] [-C] receiver_hostname receiver_port filename_to_xfer bytes_to_xfer\n\n"
 
 #define min(a, b) ((b) > (a) ? (a) : (b)) // Helper function to find the minimum of two values.
 
@@ -42,210 +70,1528 @@
  * Structure to keep track of each packet and its acknowledgment status.
  */
 struct packet_ack {
-    packet_t packet;
+    packet_t* packet; // slot of PACKET_SIZE(payload_size) bytes in sender->packet_buffers
     bool acked;
+    uint64_t sent_time; // time of the most recent transmission in microseconds
+    unsigned int transmissions; // number of times the packet has been sent
+    timer_node_t timer; // retransmission timer, armed while the packet is unacked
+    uint64_t delivered; // packets delivered when this packet was last sent, for delivery rate samples
+    uint64_t delivered_time; // time of the last delivery when this packet was last sent
+    struct packet_ack* rtx_next; // next packet in the retransmission queue
+    bool rtx_queued; // whether the packet waits in the retransmission queue
+    uint32_t zc_mark; // zerocopy sends that may still read the slot's header (see batch_zerocopy_mark())
 };
 
+#define packet_of_timer(node) ((struct packet_ack*) ((char*) (node) - offsetof(struct packet_ack, timer)))
 
 /**
- * Sends a file to a server using UDP.
- * 
- * @param hostname The hostname of the server to send the file to.
- * @param hostUDPport The UDP port number of the server.
- * @param filename The name of the file to send.
- * @param bytes_to_transfer The number of bytes of the file to send.
+ * Options controlling a transfer, set from the command line.
  */
-void rsend(char* hostname, 
-            unsigned short int hostUDPport, 
-            char* filename, 
-            unsigned long long int bytes_to_transfer) 
-{
+struct sender_options {
+    unsigned int window_size; // maximum number of unacknowledged packets in flight
+    const congestion_ops_t* congestion; // congestion control algorithm
+    bool gso; // hand runs of full packets to the kernel as one UDP GSO send
+    bool batch; // queue up to BATCH_MAX packets per sendmmsg() instead of sending each at once
+    uint32_t max_payload; // largest payload per packet proposed in the setup exchange
+    bool kernel_pacing; // pace with SO_MAX_PACING_RATE and the fq qdisc instead of in user space
+    bool verbose; // print transfer statistics every STATS_INTERVAL
+    unsigned int stripes; // number of byte ranges sent at once, each by its own thread and socket
+    bool zerocopy; // send large GSO runs with MSG_ZEROCOPY
+    uint16_t fec_data; // data packets per forward error correction group, 0 without it
+    uint16_t fec_parity; // parity packets sent after every group
+    bool delta; // only send what the receiver's copy of the file lacks
+    bool compress; // compress the bytes sent in blocks, storing the blocks that do not shrink
+};
 
+/**
+ * State of one transfer shared by the send, ACK and timeout paths.
+ */
+struct sender {
   int sock_fd;
+  uint32_t conn_id; // connection ID stamped on every packet, tells this transfer apart at the receiver
   struct sockaddr_in server_addr;
-  FILE *input_file;
+  socklen_t len;
+  batch_io_t tx; // packets queued for the next sendmmsg()
+  unsigned int batch_limit; // packets queued before tx is flushed, 1 unless batching
+  batch_io_t rx; // ACKs drained by one recvmmsg()
+
+  const file_source_t* source; // the file, (re)read whenever a packet is sent
+  uint64_t offset; // offset in the file of the first byte of this stripe
+  uint32_t payload_size; // bytes of data per packet, agreed on with the receiver
+  unsigned int ring_size; // number of slots in packets and packet_buffers, the window size
+  size_t packet_stride; // distance between two packets in packet_buffers
+  unsigned char* packet_buffers; // the packets being sent, one per slot; only their headers if the file is mapped
+  struct packet_ack* packets; // ring of the packets in the window, packet i lives in slot i % ring_size
+  resume_map_t map; // packets of the stripe the connection carries, all of them unless resuming
+  unsigned long long int bytes_to_transfer; // bytes the connection carries, ULLONG_MAX until a compressed stream ends
+  unsigned long long int bytes_queued; // bytes of the file, or of its compressed stream, already put into packets
+  crc32c_digest_t digest; // CRC32C of the bytes sent so far, carried by the FIN
+
+  compressor_t compressor; // compresses what the connection carries, if agreed on (see compress.h)
+  uint32_t compress_block; // bytes per block compressed, 0 if the connection is not compressed
+  unsigned char* raw_block; // the bytes of the block being compressed
+  unsigned char* stream; // the compressed stream not put into packets yet, from stream_start
+  size_t stream_start;
+  size_t stream_len;
+  uint64_t raw_packed; // bytes of the packets of the stripe compressed so far
+  bool stream_ended; // whether the stream is complete, its length known
+
+  fec_code_t fec; // forward error correction code agreed on, no parity packets if fec.parity is 0
+  unsigned char* parity_buffers; // PARITY_SETS sets of fec.parity parity packets, used by groups in turn
+  size_t parity_stride; // distance between two parity packets in parity_buffers
+  uint32_t parity_marks[PARITY_SETS]; // zerocopy sends that may still read each set
+  uint16_t group_len; // longest data packet of the group being encoded
+  long long int base_index; // oldest packet that has not been acked yet
+  long long int packet_index; // next packet to be read from the file
+  unsigned int in_flight; // packets sent and neither acked nor declared lost
+  long long int rwnd_edge; // first packet beyond the receive window the receiver advertised
+  uint32_t rwnd_ack; // cumulative ACK the window was advertised with
+  uint32_t rwnd; // the window, in packets from rwnd_ack
+  uint64_t probe_time; // time a zero-window probe is due, 0 unless the window is closed with nothing in flight
+  uint64_t probe_interval; // time between two zero-window probes, doubled after each one
+
+  rtt_estimator_t rtt;
+  timer_wheel_t wheel;
+  congestion_t cc;
+  uint64_t last_backoff_time;
+
+  uint64_t delivered; // total packets acked
+  uint64_t delivered_time; // time of the most recent ACK that acked new packets
+
+  long long int highest_acked; // highest packet index acked so far, -1 if none
+  uint64_t rack_xmit_time; // send time of the most recently sent packet that has been acked
+  long long int recovery_point; // packet_index when the current loss recovery episode started
+  bool in_recovery; // whether the congestion controller already reacted to this episode
+
+  pacer_t pacer;
+  struct packet_ack* rtx_head; // packets declared lost, sent before any new packet, oldest first
+  struct packet_ack* rtx_tail;
+
+  uint64_t start_time; // statistics
+  uint64_t last_stats_time;
+  unsigned long long int bytes_acked;
+  uint64_t packets_sent;
+  uint64_t retransmissions;
+  uint64_t parity_sent;
+  uint64_t window_probes;
+};
+
+/**
+ * One byte range of the file, sent by its own thread over its own socket.
+ */
+struct stripe {
+  pthread_t thread;
+  uint32_t conn_id; // connection ID of the stripe
+  struct sockaddr_in server_addr; // address of the receiver, resolved once for every stripe
+  const file_source_t* source; // the file, shared by all stripes
+  setup_t setup; // what the stripe proposes in the setup exchange: limits, place in the file, transfer
+  const struct sender_options* options;
+};
+
+/**
+ * Returns the ring slot tracking a packet of the window.
+ *
+ * @param sender The transfer state.
+ * @param index Index of the packet, between base_index and packet_index.
+ * @return The packet's slot.
+ */
+static struct packet_ack* tracked_packet(struct sender* sender, long long int index)
+{
+  return &sender->packets[index % sender->ring_size];
+}
+
+/**
+ * Sends every packet queued in the transmit batch.
+ *
+ * @param sender The transfer state.
+ */
+static void flush_packets(struct sender* sender)
+{
+  if (sender->tx.count > 0 && batch_flush(&sender->tx, sender->sock_fd) < 0) {
+    fprintf(stderr, "Send failed: %s\n", strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+}
+
+/**
+ * Sends the transmit batch once it holds batch_limit packets. Unless batching, that is every
+ * packet as soon as it is queued.
+ *
+ * @param sender The transfer state.
+ */
+static void flush_full_batch(struct sender* sender)
+{
+  if (sender->tx.count >= sender->batch_limit) {
+    flush_packets(sender);
+  }
+}
+
+/**
+ * Returns the set of parity packets of the group a data packet belongs to.
+ *
+ * @param sender The transfer state.
+ * @param seq Sequence number of the data packet.
+ * @return The index of the set.
+ */
+static unsigned parity_set(const struct sender* sender, uint32_t seq)
+{
+  return (seq / sender->fec.data) % PARITY_SETS;
+}
+
+/**
+ * Returns a parity packet of a set.
+ *
+ * @param sender The transfer state.
+ * @param set The index of the set.
+ * @param index Position of the parity packet in its group.
+ * @return The packet.
+ */
+static packet_t* parity_packet(const struct sender* sender, unsigned set, unsigned index)
+{
+  return (packet_t*) (sender->parity_buffers + (set * sender->fec.parity + index) * sender->parity_stride);
+}
+
+/**
+ * Adds the first transmission of a data packet into the parity packets of its group.
+ *
+ * @param sender The transfer state.
+ * @param header The header of the data packet.
+ * @param payload Its payload.
+ */
+static void encode_packet(struct sender* sender, const header_t* header, const unsigned char* payload)
+{
+  unsigned set = parity_set(sender, header->seq_num);
+  unsigned index = header->seq_num % sender->fec.data;
+  if (index == 0) {
+    for (unsigned j = 0; j < sender->fec.parity; j++) {
+      memset(parity_packet(sender, set, j)->data, 0, sender->payload_size);
+    }
+    sender->group_len = 0;
+  }
+  fec_encode(&sender->fec, index, payload, header->length, parity_packet(sender, set, 0)->data, sender->parity_stride);
+  if (header->length > sender->group_len) {
+    sender->group_len = header->length;
+  }
+}
+
+/**
+ * Sends the parity packets of the group a data packet completes, right behind it. Parity packets
+ * are paced like data but neither tracked nor retransmitted.
+ *
+ * @param sender The transfer state.
+ * @param seq Sequence number of the last data packet of the group.
+ */
+static void send_parity(struct sender* sender, uint32_t seq)
+{
+  unsigned set = parity_set(sender, seq);
+  uint32_t first_seq = seq - seq % sender->fec.data;
+  for (unsigned j = 0; j < sender->fec.parity; j++) {
+    packet_t* parity = parity_packet(sender, set, j);
+    parity->header = create_header(sender->conn_id, first_seq, j | (seq - first_seq + 1) << 16, sender->group_len, FEC_FLAG);
+    packet_seal(parity);
+    batch_queue(&sender->tx, parity, PACKET_SIZE(sender->group_len), &sender->server_addr);
+    flush_full_batch(sender);
+    pacer_on_send(&sender->pacer, PACKET_SIZE(sender->group_len), now_nsec());
+  }
+  // the set is reused PARITY_SETS groups later, once the kernel no longer reads it
+  sender->parity_marks[set] = batch_zerocopy_mark(&sender->tx);
+  flush_packets(sender);
+  sender->parity_sent += sender->fec.parity;
+}
+
+/**
+ * Queues a tracked packet for (re)transmission and arms its retransmission timer. The packet goes
+ * out with the next flush of the transmit batch, gathered from its header in the slot and its
+ * payload in the mapped file, so the payload is never copied in user space. Files that cannot be
+ * mapped are read again into the slot instead, and the compressed stream is copied into it once,
+ * by next_packet(). The first transmission checksums the packet and
+ * adds its payload to the digest of the connection and to the parity packets of its group, which
+ * follow the last packet of the group.
+ *
+ * @param sender The transfer state.
+ * @param tracked The packet to send.
+ */
+static void transmit_packet(struct sender* sender, struct packet_ack* tracked)
+{
+  header_t* header = &tracked->packet->header;
+  const unsigned char* payload = NULL;
+  if (sender->compress_block == 0) {
+    uint64_t offset = sender->offset + (uint64_t) resume_map_packet(&sender->map, header->seq_num) * sender->payload_size;
+    payload = file_source_slice(sender->source, offset);
+    if (payload == NULL && file_source_read(sender->source, offset, tracked->packet->data, header->length) < 0) {
+      fprintf(stderr, "Input file read failed\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+  bool first_transmission = tracked->transmissions == 0;
+  if (first_transmission) {
+    const unsigned char* data = payload != NULL ? payload : tracked->packet->data;
+    uint32_t payload_crc = crc32c(0, data, header->length);
+    header->checksum = packet_checksum(header, payload_crc);
+    crc32c_digest_add(&sender->digest, payload_crc, (uint64_t) header->seq_num * sender->payload_size, header->length);
+    if (sender->fec.parity > 0) {
+      encode_packet(sender, header, data);
+    }
+  }
+
+  tracked->sent_time = now_usec();
+  tracked->transmissions++;
+  sender->packets_sent++;
+  tracked->delivered = sender->delivered;
+  tracked->delivered_time = sender->delivered_time ? sender->delivered_time : tracked->sent_time;
+  timer_wheel_arm(&sender->wheel, &tracked->timer, tracked->sent_time + sender->rtt.rto);
+
+  tracked->zc_mark = batch_zerocopy_mark(&sender->tx);
+  if (payload != NULL) {
+    struct iovec iov[2];
+    iov[0].iov_base = header;
+    iov[0].iov_len = sizeof(header_t);
+    iov[1].iov_base = (void*) payload;
+    iov[1].iov_len = header->length;
+    batch_queue_iov(&sender->tx, iov, 2, &sender->server_addr);
+  } else {
+    batch_queue(&sender->tx, tracked->packet, PACKET_SIZE(header->length), &sender->server_addr);
+  }
+  flush_full_batch(sender);
+
+  if (first_transmission && sender->fec.parity > 0
+      && ((header->seq_num + 1) % sender->fec.data == 0 || sender->bytes_queued == sender->bytes_to_transfer)) {
+    send_parity(sender, header->seq_num);
+  }
+}
+
+/**
+ * Queues a packet declared lost for retransmission. The queue is drained by send_packets() ahead
+ * of new data and at the pacing rate, so a burst of losses is not resent back-to-back.
+ *
+ * @param sender The transfer state.
+ * @param tracked The lost packet.
+ */
+static void queue_retransmission(struct sender* sender, struct packet_ack* tracked)
+{
+  if (tracked->rtx_queued) {
+    return;
+  }
+  tracked->rtx_queued = true;
+  tracked->rtx_next = NULL;
+  if (sender->rtx_tail != NULL) {
+    sender->rtx_tail->rtx_next = tracked;
+  } else {
+    sender->rtx_head = tracked;
+  }
+  sender->rtx_tail = tracked;
+}
+
+/**
+ * Takes the oldest packet out of the retransmission queue.
+ *
+ * @param sender The transfer state.
+ * @return The packet, or NULL if the queue is empty.
+ */
+static struct packet_ack* dequeue_retransmission(struct sender* sender)
+{
+  struct packet_ack* tracked = sender->rtx_head;
+  if (tracked != NULL) {
+    sender->rtx_head = tracked->rtx_next;
+    if (sender->rtx_head == NULL) {
+      sender->rtx_tail = NULL;
+    }
+    tracked->rtx_queued = false;
+  }
+  return tracked;
+}
+
+/**
+ * Marks one tracked packet as acknowledged, if it was not already.
+ *
+ * @param sender The transfer state.
+ * @param index Index of the packet in sender->packets.
+ * @param now The current time in microseconds.
+ * @param latest Updated to the most recently sent packet acked in this batch.
+ * @return The number of payload bytes newly acknowledged.
+ */
+static unsigned long long int ack_packet(struct sender* sender, long long int index, uint64_t now,
+    struct packet_ack** latest)
+{
+  struct packet_ack* acked_packet = tracked_packet(sender, index);
+
+  // duplicate ACKs must not be counted twice
+  if (acked_packet->acked) {
+    return 0;
+  }
+  acked_packet->acked = true;
+  timer_wheel_cancel(&sender->wheel, &acked_packet->timer);
+  sender->in_flight--;
+  sender->delivered++;
+  sender->delivered_time = now;
+
+  if (*latest == NULL || acked_packet->sent_time > (*latest)->sent_time) {
+    *latest = acked_packet;
+  }
+  if (index > sender->highest_acked) {
+    sender->highest_acked = index;
+  }
+  if (acked_packet->sent_time > sender->rack_xmit_time) {
+    sender->rack_xmit_time = acked_packet->sent_time;
+  }
+  return acked_packet->packet->header.length;
+}
+
+/**
+ * Acknowledges every packet in [start, end) that has been sent.
+ *
+ * @param sender The transfer state.
+ * @param start First sequence number of the range.
+ * @param end One past the last sequence number of the range.
+ * @param now The current time in microseconds.
+ * @param latest Updated to the most recently sent packet acked in this batch.
+ * @param acked Incremented by the number of packets newly acknowledged.
+ * @return The number of payload bytes newly acknowledged.
+ */
+static unsigned long long int ack_range(struct sender* sender, long long int start, long long int end,
+    uint64_t now, struct packet_ack** latest, uint32_t* acked)
+{
+  unsigned long long int bytes_acked = 0;
+  start = start > sender->base_index ? start : sender->base_index;
+  end = min(end, sender->packet_index);
+  for (long long int i = start; i < end; i++) {
+    if (!tracked_packet(sender, i)->acked) {
+      bytes_acked += ack_packet(sender, i, now, latest);
+      (*acked)++;
+    }
+  }
+  return bytes_acked;
+}
+
+/**
+ * Applies one ACK: acknowledges everything below its cumulative ack_num, the packet whose sequence
+ * number it echoes and every range in its SACK blocks.
+ *
+ * @param sender The transfer state.
+ * @param ack_packet The ACK.
+ * @param recv_len Length of the received datagram.
+ * @param now The current time in microseconds.
+ * @param sample Accumulates the packets acked and the RTT sample of the batch.
+ * @param latest Updated to the most recently sent packet acked in this batch.
+ * @return The number of payload bytes newly acknowledged.
+ */
+static unsigned long long int process_ack(struct sender* sender, const packet_t* ack_packet, size_t recv_len,
+    uint64_t now, cc_ack_sample_t* sample, struct packet_ack** latest)
+{
+  unsigned long long int bytes_acked = 0;
+  uint32_t echoed = ack_packet->header.seq_num;
+  const unsigned char* data = ack_packet->data;
+  size_t data_len = min((size_t) ack_packet->header.length, recv_len - sizeof(header_t));
+  uint32_t window = 0;
+  uint32_t held = 0;
+  bool has_window = IS_WINDOW(ack_packet->header.flags) && data_len >= sizeof(window) + sizeof(held);
+  if (has_window) {
+    memcpy(&window, data, sizeof(window));
+    memcpy(&held, data + sizeof(window), sizeof(held));
+    data += sizeof(window) + sizeof(held);
+    data_len -= sizeof(window) + sizeof(held);
+  }
+
+  // Karn's rule: the ACK of a retransmitted packet is ambiguous, so only sample fresh ones; the
+  // time the receiver held a delayed ACK back is not part of the round trip
+  if (echoed >= sender->base_index && echoed < sender->packet_index && !tracked_packet(sender, echoed)->acked
+      && tracked_packet(sender, echoed)->transmissions == 1) {
+    uint64_t elapsed = now - tracked_packet(sender, echoed)->sent_time;
+    sample->rtt_us = elapsed > held ? elapsed - held : 1;
+    rtt_sample(&sender->rtt, sample->rtt_us);
+  }
+
+  bytes_acked += ack_range(sender, sender->base_index, ack_packet->header.ack_num, now, latest, &sample->acked);
+  bytes_acked += ack_range(sender, echoed, (long long int) echoed + 1, now, latest, &sample->acked);
+
+  if (has_window) {
+    // an ACK overtaken by a later one carries a stale window
+    if (ack_packet->header.ack_num >= sender->rwnd_ack) {
+      sender->rwnd_ack = ack_packet->header.ack_num;
+      sender->rwnd = window;
+      sender->rwnd_edge = (long long int) sender->rwnd_ack + window;
+    }
+  }
+
+  if (IS_SACK(ack_packet->header.flags)) {
+    size_t blocks = data_len / sizeof(sack_block_t);
+    const sack_block_t* sack = (const sack_block_t*) data;
+    for (size_t b = 0; b < blocks; b++) {
+      bytes_acked += ack_range(sender, sack[b].start, sack[b].end, now, latest, &sample->acked);
+    }
+  }
+
+  return bytes_acked;
+}
+
+/**
+ * Drains every ACK waiting on the socket, BATCH_MAX at a time, updates the RTT estimate and
+ * reports the newly acked packets to the congestion controller.
+ *
+ * @param sender The transfer state.
+ * @return The number of payload bytes newly acknowledged.
+ */
+static unsigned long long int process_acks(struct sender* sender)
+{
+  unsigned long long int bytes_acked = 0;
+  cc_ack_sample_t sample;
+  memset(&sample, 0, sizeof(sample));
+  struct packet_ack* latest = NULL; // most recently sent packet acked in this batch
+
+  // completions of zerocopy sends make the socket readable too
+  if (batch_reap_zerocopy(&sender->tx, sender->sock_fd) < 0) {
+    fprintf(stderr, "Zerocopy completion read failed: %s\n", strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+
+  int received;
+  do {
+    received = batch_recv(&sender->rx, sender->sock_fd);
+    if (received < 0) {
+      fprintf(stderr, "Receive failed: %s\n", strerror(errno));
+      exit(EXIT_FAILURE);
+    }
+
+    uint64_t now = now_usec();
+    for (int r = 0; r < received; r++) {
+      const packet_t* ack_packet = (const packet_t*) batch_data(&sender->rx, r);
+      size_t recv_len = batch_len(&sender->rx, r);
+      // late answers to a retransmitted setup request or table chunk carry no acknowledgments
+      if (!packet_verify(ack_packet, recv_len, NULL) || ack_packet->header.conn_id != sender->conn_id
+          || !IS_ACK(ack_packet->header.flags) || IS_SYN(ack_packet->header.flags) || IS_RESUME(ack_packet->header.flags)
+          || IS_DELTA(ack_packet->header.flags) || IS_MATCH(ack_packet->header.flags)) {
+        continue;
+      }
+      bytes_acked += process_ack(sender, ack_packet, recv_len, now, &sample, &latest);
+    }
+  } while (received == BATCH_MAX);
+
+  if (sample.acked == 0) {
+    return 0;
+  }
+
+  // slide the window past every packet that has been acked, freeing their slots
+  while (sender->base_index < sender->packet_index && tracked_packet(sender, sender->base_index)->acked) {
+    sender->base_index++;
+  }
+
+  sample.now = now_usec();
+  sample.in_flight = sender->in_flight;
+  sample.srtt_us = sender->rtt.srtt;
+  uint64_t interval = sample.now - latest->delivered_time;
+  if (interval > 0) {
+    sample.delivery_rate = (double) (sender->delivered - latest->delivered) * 1e6 / (double) interval;
+  }
+  sender->cc.ops->on_ack(&sender->cc, &sample);
+
+  return bytes_acked;
+}
+
+/**
+ * Queues for retransmission the packets that ACKs for later packets show to be lost, without
+ * waiting for their retransmission timer.
+ *
+ * A packet is lost if at least DUP_THRESHOLD packets above it have been acked (only for a first
+ * transmission, where the sequence order matches the send order), or, like RACK, if a packet sent
+ * more than a reordering window after it has been acked. The reordering window is a quarter of
+ * the min RTT. The congestion controller is told about the loss once per recovery episode, which
+ * lasts until every packet sent before the first loss has been acked.
+ *
+ * @param sender The transfer state.
+ */
+static void detect_losses(struct sender* sender)
+{
+  if (sender->in_recovery && sender->base_index >= sender->recovery_point) {
+    sender->in_recovery = false;
+  }
+
+  uint64_t reordering_window = sender->rtt.min_rtt / 4;
+  for (long long int i = sender->base_index; i < sender->highest_acked; i++) {
+    struct packet_ack* tracked = tracked_packet(sender, i);
+    if (tracked->acked || tracked->rtx_queued) {
+      continue;
+    }
+
+    bool dup_threshold_lost = tracked->transmissions == 1 && i + DUP_THRESHOLD <= sender->highest_acked;
+    bool rack_lost = tracked->sent_time + reordering_window < sender->rack_xmit_time;
+    if (!dup_threshold_lost && !rack_lost) {
+      continue;
+    }
+
+    if (!sender->in_recovery) {
+      sender->cc.ops->on_loss(&sender->cc, now_usec());
+      sender->in_recovery = true;
+      sender->recovery_point = sender->packet_index;
+    }
+    queue_retransmission(sender, tracked);
+  }
+}
+
+/**
+ * Queues for retransmission the packets whose retransmission timer has expired.
+ *
+ * Timers of a burst of lost packets fire on neighbouring ticks, so the RTO is backed off and the
+ * congestion controller told about the timeout at most once per RTO rather than once per timer.
+ *
+ * @param sender The transfer state.
+ */
+static void process_timeouts(struct sender* sender)
+{
+  uint64_t now = now_usec();
+  timer_node_t* expired = timer_wheel_expire(&sender->wheel, now);
+  if (expired != NULL && now >= sender->last_backoff_time + sender->rtt.rto) {
+    rtt_backoff(&sender->rtt);
+    sender->cc.ops->on_timeout(&sender->cc, now);
+    sender->last_backoff_time = now;
+  }
+
+  while (expired != NULL) {
+    timer_node_t* next = expired->next;
+    queue_retransmission(sender, packet_of_timer(expired));
+    expired = next;
+  }
+}
+
+/**
+ * Checks whether a new packet may be sent: there is data left, the window has room, fewer
+ * than the congestion window are in flight and no zerocopy send still reads the slot it would
+ * take, nor the parity packets a new group would reuse.
+ *
+ * @param sender The transfer state.
+ * @return true if a new packet may be sent.
+ */
+static bool can_send_new_packet(struct sender* sender)
+{
+  if (sender->fec.parity > 0 && sender->packet_index % sender->fec.data == 0
+      && !batch_zerocopy_released(&sender->tx, sender->parity_marks[parity_set(sender, sender->packet_index)])) {
+    return false;
+  }
+  return sender->bytes_queued < sender->bytes_to_transfer
+      && sender->packet_index - sender->base_index < sender->ring_size
+      && sender->packet_index < sender->rwnd_edge
+      && sender->in_flight < sender->cc.ops->cwnd(&sender->cc)
+      && batch_zerocopy_released(&sender->tx, tracked_packet(sender, sender->packet_index)->zc_mark);
+}
+
+/**
+ * Runs the persist timer: while the receive window is closed and nothing is in flight, only the
+ * receiver's window update reopens it, and that may be lost. A probe, a WINDOW_FLAG packet without
+ * data that the receiver answers with an ACK, is then sent after an RTO, at least
+ * PROBE_MIN_INTERVAL, then after twice as long each time, up to RTO_MAX_US.
+ *
+ * @param sender The transfer state.
+ * @param now The current time in microseconds.
+ */
+static void check_window(struct sender* sender, uint64_t now)
+{
+  if (sender->packet_index < sender->rwnd_edge) {
+    sender->probe_time = 0;
+    sender->probe_interval = 0;
+    return;
+  }
+  if (sender->in_flight > 0 || sender->bytes_queued >= sender->bytes_to_transfer) {
+    sender->probe_time = 0;
+    return;
+  }
+  if (sender->probe_time == 0) {
+    sender->probe_interval = sender->probe_interval > 0 ? min(2 * sender->probe_interval, RTO_MAX_US)
+        : sender->rtt.rto > PROBE_MIN_INTERVAL ? sender->rtt.rto : PROBE_MIN_INTERVAL;
+    sender->probe_time = now + sender->probe_interval;
+  }
+  else if (now >= sender->probe_time) {
+    unsigned char probe_buffer[PACKET_SIZE(0)];
+    packet_t* probe = (packet_t*) probe_buffer;
+    create_packet(probe, NULL, create_header(sender->conn_id, sender->packet_index, 0, 0, WINDOW_FLAG));
+    packet_seal(probe);
+    sendto(sender->sock_fd, probe, sizeof(probe_buffer), 0, (const struct sockaddr*) &sender->server_addr, sender->len);
+    sender->probe_time = 0;
+    sender->window_probes++;
+  }
+}
+
+/**
+ * Reads bytes of the packets of the stripe the connection carries, as if they followed each other.
+ *
+ * @param sender The transfer state.
+ * @param pos Position of the bytes among those the connection carries.
+ * @param buffer Receives the bytes.
+ * @param len Number of bytes.
+ */
+static void read_carried(struct sender* sender, uint64_t pos, unsigned char* buffer, size_t len)
+{
+  uint32_t payload_size = sender->payload_size;
+  while (len > 0) {
+    uint64_t offset = sender->offset + (uint64_t) resume_map_packet(&sender->map, pos / payload_size) * payload_size
+        + pos % payload_size;
+    // packets next to each other in the file are read at once
+    size_t run = min(len, payload_size - pos % payload_size);
+    while (run < len && sender->offset + (uint64_t) resume_map_packet(&sender->map, (pos + run) / payload_size)
+        * payload_size == offset + run) {
+      run += min(len - run, payload_size);
+    }
+    const unsigned char* data = file_source_slice(sender->source, offset);
+    if (data != NULL) {
+      memcpy(buffer, data, run);
+    } else if (file_source_read(sender->source, offset, buffer, run) < 0) {
+      fprintf(stderr, "Input file read failed\n");
+      exit(EXIT_FAILURE);
+    }
+    pos += run;
+    buffer += run;
+    len -= run;
+  }
+}
+
+/**
+ * Compresses blocks of what the connection carries until the compressed stream holds a whole
+ * packet, or ends. The stream ends with an empty block, padded up to a whole packet if parity
+ * packets are sent, and its length becomes the bytes the connection carries.
+ *
+ * @param sender The transfer state.
+ */
+static void fill_stream(struct sender* sender)
+{
+  if (sender->compress_block == 0 || sender->stream_ended || sender->stream_len >= sender->payload_size) {
+    return;
+  }
+  memmove(sender->stream, sender->stream + sender->stream_start, sender->stream_len);
+  sender->stream_start = 0;
+  while (sender->stream_len < sender->payload_size && !sender->stream_ended) {
+    uint32_t raw_len = min((uint64_t) sender->compress_block, sender->map.bytes - sender->raw_packed);
+    read_carried(sender, sender->raw_packed, sender->raw_block, raw_len);
+    sender->stream_len += compressor_pack(&sender->compressor, sender->raw_block, raw_len,
+        sender->stream + sender->stream_len);
+    sender->raw_packed += raw_len;
+    if (raw_len == 0) {
+      // packets rebuilt from parity packets are taken to be whole (see fec.h)
+      if (sender->fec.parity > 0) {
+        size_t padding = (sender->payload_size - (sender->bytes_queued + sender->stream_len) % sender->payload_size)
+            % sender->payload_size;
+        memset(sender->stream + sender->stream_len, 0, padding);
+        sender->stream_len += padding;
+      }
+      sender->bytes_to_transfer = sender->bytes_queued + sender->stream_len;
+      sender->stream_ended = true;
+    }
+  }
+}
+
+/**
+ * Puts the next chunk of the file, or of its compressed stream, into a recycled slot of the window.
+ *
+ * @param sender The transfer state.
+ * @return The new packet.
+ */
+static struct packet_ack* next_packet(struct sender* sender)
+{
+  struct packet_ack* tracked = tracked_packet(sender, sender->packet_index);
+  tracked->packet = (packet_t*) (sender->packet_buffers
+      + (sender->packet_index % sender->ring_size) * sender->packet_stride);
+
+  // the next chunk of the file; transmit_packet() reads it into the packet
+  size_t chunk_len = min((unsigned long long int) sender->payload_size, sender->bytes_to_transfer - sender->bytes_queued);
+  sender->bytes_queued += chunk_len;
+
+  // reset the recycled slot
+  create_packet(tracked->packet, NULL, create_header(sender->conn_id, sender->packet_index, 0, chunk_len, 0));
+  if (sender->compress_block > 0) {
+    memcpy(tracked->packet->data, sender->stream + sender->stream_start, chunk_len);
+    sender->stream_start += chunk_len;
+    sender->stream_len -= chunk_len;
+    fill_stream(sender);
+  }
+  tracked->acked = false;
+  tracked->transmissions = 0;
+  sender->packet_index++;
+  sender->in_flight++;
+  return tracked;
+}
+
+/**
+ * Sends as many packets as the pacer allows: retransmissions first, then new packets while the
+ * window and the congestion window have room.
+ *
+ * @param sender The transfer state.
+ */
+static void send_packets(struct sender* sender)
+{
+  uint64_t now = now_nsec();
+  while (pacer_ready(&sender->pacer, now)) {
+    struct packet_ack* tracked;
+    if (sender->rtx_head != NULL) {
+      tracked = dequeue_retransmission(sender);
+      // an ACK may have arrived since the packet was declared lost
+      if (tracked->acked) {
+        continue;
+      }
+      sender->retransmissions++;
+    } else if (can_send_new_packet(sender)) {
+      tracked = next_packet(sender);
+    } else {
+      break;
+    }
+    pacer_on_send(&sender->pacer, PACKET_SIZE(tracked->packet->header.length), now);
+    transmit_packet(sender, tracked);
+  }
+  flush_packets(sender);
+}
+
+/**
+ * Prints a line of transfer statistics to stderr.
+ *
+ * @param sender The transfer state.
+ * @param now The current time in microseconds.
+ * @param label "stats" for periodic lines, "total" for the summary at the end.
+ */
+static void print_stats(struct sender* sender, uint64_t now, const char* label)
+{
+  double seconds = (double) (now - sender->start_time) / 1e6;
+  double goodput = seconds > 0 ? (double) sender->bytes_acked * 8 / seconds / 1e6 : 0;
+  fprintf(stderr, "%s: %.3fs acked %llu bytes (%.2f Mbit/s) sent %" PRIu64 " packets, %" PRIu64
+      " retransmitted, %" PRIu64 " parity, cwnd %.1f, rwnd %" PRIu32 " (%" PRIu64 " probes), srtt %" PRIu64 "us, rto %"
+      PRIu64 "us, pacing %.2f Mbit/s%s\n",
+      label, seconds, sender->bytes_acked, goodput, sender->packets_sent, sender->retransmissions, sender->parity_sent,
+      sender->cc.ops->cwnd(&sender->cc), sender->rwnd, sender->window_probes, sender->rtt.srtt, sender->rtt.rto,
+      sender->cc.ops->pacing_rate(&sender->cc) * 8 / 1e6, sender->pacer.kernel ? " (kernel)" : "");
+}
+
+/**
+ * Finds the largest payload that fits in one datagram on the route to the receiver, from the
+ * route MTU the kernel reports for the connected socket.
+ *
+ * @param sender The transfer state.
+ * @return The payload size, or DEFAULT_PAYLOAD_SZ if the MTU cannot be determined.
+ */
+static uint32_t path_payload_size(struct sender* sender)
+{
+  int mtu;
+  socklen_t mtu_len = sizeof(mtu);
+  if (connect(sender->sock_fd, (const struct sockaddr*) &sender->server_addr, sender->len) < 0
+      || getsockopt(sender->sock_fd, IPPROTO_IP, IP_MTU, &mtu, &mtu_len) < 0
+      || mtu <= (int) PACKET_SIZE(UDP_IP_OVERHEAD)) {
+    return DEFAULT_PAYLOAD_SZ;
+  }
+  return min((uint32_t) (mtu - UDP_IP_OVERHEAD - sizeof(header_t)), MAX_PAYLOAD_SZ);
+}
+
+/**
+ * Agrees on the payload size and window with the receiver before any data is sent. The sender
+ * proposes the smaller of the path payload size and the payload the user allows, and its window,
+ * in a SYN packet along with the size and place of the stripe, and the receiver answers with the
+ * values both use (see setup_t). The request is retransmitted after an RTO, and the exchange gives
+ * the first RTT sample.
+ *
+ * @param sender The transfer state.
+ * @param proposed The largest payload the user allows, the window the user asked for and the
+ * stripe being sent.
+ * @param agreed Set to the agreed parameters.
+ * @return 0 on success, -1 if the receiver never answered.
+ */
+static int negotiate_setup(struct sender* sender, setup_t proposed, setup_t* agreed)
+{
+  unsigned char request_buffer[PACKET_SIZE(sizeof(setup_t))];
+  unsigned char reply_buffer[ACK_PACKET_SZ];
+  packet_t* request = (packet_t*) request_buffer;
+  const packet_t* reply = (const packet_t*) reply_buffer;
+
+  proposed.payload_size = min(path_payload_size(sender), proposed.payload_size);
+  create_packet(request, (const unsigned char*) &proposed,
+      create_header(sender->conn_id, 0, 0, sizeof(setup_t), SYN_FLAG));
+  packet_seal(request);
+
+  for (int syn_sent = 1; syn_sent <= MAX_SYN_SENT; syn_sent++) {
+    uint64_t sent_time = now_usec();
+    sendto(sender->sock_fd, request, sizeof(request_buffer), 0,
+        (const struct sockaddr*) &sender->server_addr, sender->len);
+
+    uint64_t now = sent_time;
+    while (now < sent_time + sender->rtt.rto) {
+      fd_set readfds;
+      FD_ZERO(&readfds);
+      FD_SET(sender->sock_fd, &readfds);
+      struct timeval tv = usec_to_timeval(sent_time + sender->rtt.rto - now);
+      if (select(sender->sock_fd + 1, &readfds, NULL, NULL, &tv) > 0) {
+        ssize_t recv_len = recv(sender->sock_fd, reply_buffer, sizeof(reply_buffer), 0);
+        if (recv_len >= (ssize_t) PACKET_SIZE(sizeof(setup_t)) && packet_verify(reply, recv_len, NULL)
+            && reply->header.conn_id == sender->conn_id
+            && IS_SYN(reply->header.flags) && IS_ACK(reply->header.flags)) {
+          memcpy(agreed, reply->data, sizeof(setup_t));
+          if (agreed->payload_size > 0 && agreed->payload_size <= proposed.payload_size
+              && agreed->window_size > 0 && agreed->window_size <= proposed.window_size) {
+            // Karn's rule: an answer to a retransmitted request is ambiguous
+            if (syn_sent == 1) {
+              rtt_sample(&sender->rtt, now_usec() - sent_time);
+            }
+            return 0;
+          }
+        }
+      }
+      now = now_usec();
+    }
+    rtt_backoff(&sender->rtt);
+  }
+  return -1;
+}
+
+/**
+ * Closes the connection once every byte is acknowledged. The FIN carries the digest of the
+ * connection, its own number and the sender's RTO, and is retransmitted every RTO, without backoff
+ * so the receiver knows how long to linger, until the FIN-ACK arrives. The FIN-ACK is acknowledged
+ * in turn, which ends the receiver's linger (see setup_t), so both ends are done about one RTT
+ * after the last ACK.
+ *
+ * @param sender The transfer state.
+ * @param digest The CRC32C of the bytes of the connection.
+ * @param received_digest Set to the receiver's CRC32C of the bytes it got, if its FIN-ACK has one.
+ * @return 1 if the FIN-ACK carried a digest, 0 if it did not, -1 if the receiver never answered.
+ */
+static int finish_connection(struct sender* sender, uint32_t digest, uint32_t* received_digest)
+{
+  unsigned char fin_buffer[PACKET_SIZE(sizeof(digest))];
+  unsigned char reply_buffer[ACK_PACKET_SZ];
+  packet_t* fin = (packet_t*) fin_buffer;
+  const packet_t* reply = (const packet_t*) reply_buffer;
+  uint64_t rto = sender->rtt.rto;
+
+  for (int fin_sent = 1; fin_sent <= MAX_FIN_SENT; fin_sent++) {
+    create_packet(fin, (const unsigned char*) &digest,
+        create_header(sender->conn_id, fin_sent, (uint32_t) rto, sizeof(digest), FIN_FLAG));
+    packet_seal(fin);
+    uint64_t sent_time = now_usec();
+    sendto(sender->sock_fd, fin, sizeof(fin_buffer), 0, (const struct sockaddr*) &sender->server_addr, sender->len);
+
+    // ACKs still on their way are read and dropped
+    uint64_t now = sent_time;
+    while (now < sent_time + rto) {
+      fd_set readfds;
+      FD_ZERO(&readfds);
+      FD_SET(sender->sock_fd, &readfds);
+      struct timeval tv = usec_to_timeval(sent_time + rto - now);
+      if (select(sender->sock_fd + 1, &readfds, NULL, NULL, &tv) > 0) {
+        ssize_t recv_len = recv(sender->sock_fd, reply_buffer, sizeof(reply_buffer), 0);
+        if (recv_len > 0 && packet_verify(reply, recv_len, NULL) && reply->header.conn_id == sender->conn_id
+            && IS_FIN(reply->header.flags) && IS_ACK(reply->header.flags)) {
+          unsigned char close_buffer[PACKET_SIZE(0)];
+          packet_t* close_ack = (packet_t*) close_buffer;
+          create_packet(close_ack, NULL, create_header(sender->conn_id, 0, 0, 0, FIN_FLAG | ACK_FLAG));
+          packet_seal(close_ack);
+          sendto(sender->sock_fd, close_ack, sizeof(close_buffer), 0,
+              (const struct sockaddr*) &sender->server_addr, sender->len);
+
+          // a FIN-ACK resent after the receiver closed the connection carries no digest
+          if (reply->header.length < sizeof(*received_digest)) {
+            return 0;
+          }
+          memcpy(received_digest, reply->data, sizeof(*received_digest));
+          return 1;
+        }
+      }
+      now = now_usec();
+    }
+  }
+  return -1;
+}
+
+/**
+ * Exchanges a table with the receiver before sending data, chunk by chunk (see setup_t): fetches
+ * the bitmap of the blocks it already has or the signatures of its copy, or pushes the matches
+ * found in that copy. Up to TABLE_WINDOW chunks are asked for or sent at once, and those left
+ * unanswered after an RTO are sent again, like the setup request.
+ *
+ * @param sender The transfer state.
+ * @param flag RESUME_FLAG or DELTA_FLAG to fetch a table, MATCH_FLAG to push one.
+ * @param table The table, filled in when it is fetched.
+ * @param len Bytes of the table.
+ * @return 0 on success, -1 if the receiver stopped answering or memory runs out.
+ */
+static int exchange_table(struct sender* sender, uint16_t flag, unsigned char* table, size_t len)
+{
+  unsigned char request_buffer[PACKET_SIZE(MAX_TABLE_CHUNK)];
+  unsigned char reply_buffer[PACKET_SIZE(MAX_TABLE_CHUNK)];
+  packet_t* request = (packet_t*) request_buffer;
+  const packet_t* reply = (const packet_t*) reply_buffer;
+
+  bool push = flag == MATCH_FLAG;
+  size_t chunk = min(sender->payload_size, MAX_TABLE_CHUNK);
+  size_t chunks = (len + chunk - 1) / chunk;
+  bool* answered = (bool*) calloc(chunks + 1, sizeof(bool));
+  if (answered == NULL) {
+    return -1;
+  }
+
+  size_t first = 0; // first chunk not answered yet
+  int rounds_failed = 0;
+  while (first < chunks) {
+    if (rounds_failed == MAX_SYN_SENT) {
+      free(answered);
+      return -1;
+    }
+    size_t last = min(first + TABLE_WINDOW, chunks);
+    size_t pending = 0;
+    for (size_t c = first; c < last; c++) {
+      if (!answered[c]) {
+        uint16_t length = push ? min(chunk, len - c * chunk) : 0;
+        create_packet(request, push ? table + c * chunk : NULL,
+            create_header(sender->conn_id, c * chunk, push ? len : 0, length, flag));
+        packet_seal(request);
+        sendto(sender->sock_fd, request, PACKET_SIZE(length), 0,
+            (const struct sockaddr*) &sender->server_addr, sender->len);
+        pending++;
+      }
+    }
+
+    bool progress = false;
+    uint64_t sent_time = now_usec();
+    uint64_t now = sent_time;
+    while (pending > 0 && now < sent_time + sender->rtt.rto) {
+      fd_set readfds;
+      FD_ZERO(&readfds);
+      FD_SET(sender->sock_fd, &readfds);
+      struct timeval tv = usec_to_timeval(sent_time + sender->rtt.rto - now);
+      if (select(sender->sock_fd + 1, &readfds, NULL, NULL, &tv) > 0) {
+        ssize_t recv_len = recv(sender->sock_fd, reply_buffer, sizeof(reply_buffer), 0);
+        // duplicate answers and late setup answers are left out
+        size_t c = recv_len > 0 ? reply->header.seq_num / chunk : chunks;
+        if (recv_len > 0 && packet_verify(reply, recv_len, NULL) && reply->header.conn_id == sender->conn_id
+            && (reply->header.flags & flag) && IS_ACK(reply->header.flags)
+            && reply->header.seq_num % chunk == 0 && c < chunks && !answered[c]
+            && reply->header.length == (push ? 0 : min(chunk, len - c * chunk))) {
+          if (!push) {
+            memcpy(table + c * chunk, reply->data, reply->header.length);
+          }
+          answered[c] = true;
+          progress = true;
+          if (c >= first && c < last) {
+            pending--;
+          }
+        }
+      }
+      now = now_usec();
+    }
+    while (first < chunks && answered[first]) {
+      first++;
+    }
+    if (progress) {
+      rounds_failed = 0;
+    } else {
+      rounds_failed++;
+      rtt_backoff(&sender->rtt);
+    }
+  }
+  free(answered);
+  return 0;
+}
+
+/**
+ * Finds the blocks of the receiver's copy of the file in the stripe (see delta.h) and tells the
+ * receiver to copy them, so only the bytes around them are sent. The stripe is searched in the
+ * mapped file; a file that cannot be mapped is sent whole.
+ *
+ * @param sender The transfer state.
+ * @param agreed The setup of the stripe agreed on.
+ * @param covered Receives the bytes of the stripe the receiver copies.
+ * @return 0 on success, -1 if the receiver stopped answering or memory runs out.
+ */
+static int send_delta(struct sender* sender, const setup_t* agreed, byte_ranges_t* covered)
+{
+  const unsigned char* data = file_source_slice(sender->source, agreed->offset);
+  if (data == NULL) {
+    fprintf(stderr, "Delta transfers search the mapped file, sending every byte\n");
+    return 0;
+  }
+
+  size_t signatures_len = (size_t) agreed->delta_blocks * sizeof(delta_signature_t);
+  delta_signature_t* signatures = (delta_signature_t*) malloc(signatures_len);
+  if (signatures == NULL || exchange_table(sender, DELTA_FLAG, (unsigned char*) signatures, signatures_len) < 0) {
+    free(signatures);
+    return -1;
+  }
+
+  delta_index_t index;
+  delta_match_t* matches = NULL;
+  size_t count = 0;
+  if (delta_index_init(&index, signatures, agreed->delta_blocks, agreed->delta_block_size) < 0
+      || delta_find_matches(&index, data, agreed->total_bytes, agreed->offset, &matches, &count) < 0) {
+    delta_index_free(&index);
+    free(signatures);
+    return -1;
+  }
+  delta_index_free(&index);
+  free(signatures);
+
+  // the offsets in the table are sequence numbers, so it has to stay below 4 GB
+  count = min(count, UINT32_MAX / sizeof(delta_match_t));
+  if (count > 0 && exchange_table(sender, MATCH_FLAG, (unsigned char*) matches, count * sizeof(delta_match_t)) < 0) {
+    free(matches);
+    return -1;
+  }
+  for (size_t m = 0; m < count; m++) {
+    if (byte_ranges_add(covered, matches[m].offset, matches[m].offset + agreed->delta_block_size) < 0) {
+      free(matches);
+      return -1;
+    }
+  }
+  fprintf(stderr, "Delta %08x: %zu blocks of %" PRIu32 " bytes found in the receiver's copy\n", sender->conn_id,
+      count, agreed->delta_block_size);
+  free(matches);
+  return 0;
+}
+
+/**
+ * Sends one stripe of a file to a server using UDP, over its own socket.
+ *
+ * New packets are sent as long as fewer than the congestion window are in flight and the window
+ * spans fewer than the window agreed with the receiver. Every outstanding packet has its own retransmission timer
+ * in a timer wheel, and only the packets whose timer expired are retransmitted. The timeout is
+ * derived from RTTs measured on the ACKs (see rtt.h) and the congestion window comes from the
+ * selected congestion controller (see congestion.h). The payload size of the packets and the window
+ * are agreed on with the receiver before the transfer starts.
+ *
+ * Lost packets are queued for retransmission and, like new packets, released at the congestion
+ * controller's pacing rate (see pacer.h), retransmissions first.
+ *
+ * If the receiver kept blocks of the stripe from an earlier transfer of the file (see resume.h),
+ * or can copy bytes of it from an older copy of the file (see delta.h), only the packets with bytes
+ * it lacks are sent, numbered from 0 as if they were the whole stripe.
+ *
+ * A compressed connection (see compress.h) carries the compressed stream of those packets instead;
+ * the stream is compressed a block at a time as packets are sent, so its length is only known once
+ * the last block is.
+ * 
+ * @param stripe The byte range to send, where to and how.
+ */
+static void send_stripe(const struct stripe* stripe)
+{
+  const struct sender_options* options = stripe->options;
+  unsigned long long int bytes_to_transfer = stripe->setup.total_bytes;
+
+  struct sender sender;
   fd_set readfds;
   struct timeval tv;
   int select_retval;
 
-  
+  memset(&sender, 0, sizeof(sender));
+  sender.conn_id = stripe->conn_id;
+  sender.source = stripe->source;
+  sender.offset = stripe->setup.offset;
+  sender.highest_acked = -1;
+  rtt_init(&sender.rtt);
+  if (timer_wheel_init(&sender.wheel, TIMER_WHEEL_SLOTS, TIMER_WHEEL_TICK, now_usec()) < 0) {
+    fprintf(stderr, "Cannot allocate retransmission timers\n");
+    exit(EXIT_FAILURE);
+  }
+  if (batch_init(&sender.tx, 0) < 0 || batch_init(&sender.rx, ACK_PACKET_SZ) < 0) {
+    fprintf(stderr, "Cannot allocate packet batches\n");
+    exit(EXIT_FAILURE);
+  }
 
   // open the socket for reading 
-  if ((sock_fd = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
-    fprintf(stderr, "Socket creation failed: %d\n", sock_fd);
+  if ((sender.sock_fd = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
+    fprintf(stderr, "Socket creation failed: %d\n", sender.sock_fd);
     exit(EXIT_FAILURE);
   }
 
   // set socket to non-blocking
-  fcntl(sock_fd, F_SETFL, O_NONBLOCK);
-
-  // create a server address structure and set the port number
-  memset(&server_addr, 0, sizeof(server_addr));
-  server_addr.sin_family = AF_INET;
-  server_addr.sin_port = hostUDPport;
-  server_addr.sin_addr.s_addr = INADDR_ANY;
+  fcntl(sender.sock_fd, F_SETFL, O_NONBLOCK);
 
+  sender.server_addr = stripe->server_addr;
+  sender.len = sizeof(sender.server_addr);
 
-  // open the file for reading
-  if ((input_file = fopen(filename, "r")) == NULL) {
-    fprintf(stderr, "Input file open failed: %d\n");
+  // agree on the payload size and window before sizing anything by them
+  setup_t agreed;
+  if (negotiate_setup(&sender, stripe->setup, &agreed) < 0) {
+    fprintf(stderr, "Receiver did not answer the setup request\n");
     exit(EXIT_FAILURE);
   }
+  sender.payload_size = agreed.payload_size;
+  crc32c_digest_init(&sender.digest, sender.payload_size);
 
-  
-  uint32_t seq_num = 0;
-  header_t header;
-  packet_t packet;
-  
-  unsigned long long int total_bytes_acked = 0;
-
-  // get the total number of bytes in the file
-  unsigned long long int file_total_bytes = 0;
-  struct stat file_stat;
+  // leave out what the receiver kept from an earlier transfer of the file, and what it can copy
+  // from its older copy of the file
+  byte_ranges_t covered;
+  memset(&covered, 0, sizeof(covered));
+  if (agreed.present_bytes > 0) {
+    size_t bitmap_len = (resume_blocks(sender.offset, bytes_to_transfer) + 7) / 8;
+    uint8_t* present = (uint8_t*) calloc(bitmap_len + 1, 1);
+    if (present == NULL || exchange_table(&sender, RESUME_FLAG, present, bitmap_len) < 0
+        || resume_present_ranges(&covered, present, sender.offset, bytes_to_transfer) < 0) {
+      fprintf(stderr, "Receiver did not send the blocks it already has\n");
+      exit(EXIT_FAILURE);
+    }
+    free(present);
+    fprintf(stderr, "Resuming %08x: %" PRIu64 " of %llu bytes already received\n", sender.conn_id,
+        agreed.present_bytes, bytes_to_transfer);
+  }
+  if (agreed.delta_blocks > 0 && send_delta(&sender, &agreed, &covered) < 0) {
+    fprintf(stderr, "Receiver did not take part in the delta transfer\n");
+    exit(EXIT_FAILURE);
+  }
+  if (resume_map_build(&sender.map, &covered, sender.offset, bytes_to_transfer, sender.payload_size) < 0) {
+    fprintf(stderr, "Cannot allocate the packet map\n");
+    exit(EXIT_FAILURE);
+  }
+  byte_ranges_free(&covered);
+  bytes_to_transfer = sender.map.bytes;
 
-  if (stat(filename, &file_stat) == -1) {
-    fprintf(stderr, "Cannot get file size\n");
+  if (congestion_init(&sender.cc, options->congestion, PACKET_SIZE(sender.payload_size)) < 0) {
+    fprintf(stderr, "Cannot allocate congestion control state\n");
     exit(EXIT_FAILURE);
   }
-  file_total_bytes = file_stat.st_size;
-  bytes_to_transfer = min (file_total_bytes, bytes_to_transfer);
 
-  int len = sizeof(server_addr);
+  // GSO coalesces runs within a batch, so it batches too
+  sender.batch_limit = options->batch || options->gso ? BATCH_MAX : 1;
+  if (options->gso && batch_enable_gso(&sender.tx, sender.sock_fd, PACKET_SIZE(sender.payload_size)) < 0) {
+    fprintf(stderr, "UDP GSO is not available, sending packets individually\n");
+  }
+  if (options->zerocopy && batch_enable_zerocopy(&sender.tx, sender.sock_fd) < 0) {
+    fprintf(stderr, "MSG_ZEROCOPY is not available, copying packets into the kernel\n");
+  }
+
+
+  if (pacer_init(&sender.pacer, sender.sock_fd, options->kernel_pacing) < 0) {
+    fprintf(stderr, "Kernel pacing is not available, pacing in user space\n");
+  }
 
-  // allocate memory for holding all the packets.
-  struct packet_ack* packets = (struct packet_ack*) malloc(sizeof(struct packet_ack) * ((bytes_to_transfer / PAYLOAD_SZ) + 1));
-  if (packets == NULL) {
+  // allocate one slot per packet of the window; slots are recycled once their packet is acked
+  // and rounded up so every header stays aligned. Payloads are sent straight from a mapped file,
+  // so its slots only hold headers
+  sender.ring_size = agreed.window_size;
+  sender.rtt.max_ack_delay = agreed.max_ack_delay;
+  sender.rwnd = agreed.receive_window > 0 ? min(agreed.receive_window, agreed.window_size) : agreed.window_size;
+  sender.rwnd_edge = sender.rwnd;
+  size_t slot_size = file_source_slice(sender.source, 0) != NULL && agreed.compress_block == 0
+      ? sizeof(header_t) : PACKET_SIZE(sender.payload_size);
+  sender.packet_stride = (slot_size + sizeof(uint64_t) - 1) & ~(sizeof(uint64_t) - 1);
+  sender.packets = (struct packet_ack*) calloc(sender.ring_size, sizeof(struct packet_ack));
+  sender.packet_buffers = (unsigned char*) malloc(sender.ring_size * sender.packet_stride);
+  if (sender.packets == NULL || sender.packet_buffers == NULL) {
     fprintf(stderr, "Cannot allocate memory for packet tracking\n");
     exit(EXIT_FAILURE);
   } 
-  memset(packets, 0, sizeof(packet_t) * ((bytes_to_transfer / PAYLOAD_SZ) + 1));
-  long long int packet_index = 0;
 
-  long long int total_bytes_read = 0;
+  // parity packets of the groups whose parity may still be in flight
+  if (agreed.fec_parity > 0) {
+    sender.parity_stride = (PACKET_SIZE(sender.payload_size) + sizeof(uint64_t) - 1) & ~(sizeof(uint64_t) - 1);
+    sender.parity_buffers = (unsigned char*) malloc(PARITY_SETS * agreed.fec_parity * sender.parity_stride);
+    if (sender.parity_buffers == NULL || fec_code_init(&sender.fec, agreed.fec_data, agreed.fec_parity) < 0) {
+      fprintf(stderr, "Cannot set up forward error correction\n");
+      exit(EXIT_FAILURE);
+    }
+  }
 
-  while(total_bytes_acked < bytes_to_transfer)   {
+  sender.bytes_to_transfer = bytes_to_transfer;
+  if (agreed.compress_block > 0) {
+    sender.compress_block = agreed.compress_block;
+    sender.raw_block = (unsigned char*) malloc(sender.compress_block);
+    sender.stream = (unsigned char*) malloc(2 * sender.payload_size + sizeof(compress_header_t) + sender.compress_block);
+    if (sender.raw_block == NULL || sender.stream == NULL || compressor_init(&sender.compressor) < 0) {
+      fprintf(stderr, "Cannot allocate the compression buffers\n");
+      exit(EXIT_FAILURE);
+    }
+    sender.bytes_to_transfer = ULLONG_MAX;
+    fill_stream(&sender);
+  }
+  sender.start_time = now_usec();
+  sender.last_stats_time = sender.start_time;
 
-    unsigned char buffer[PAYLOAD_SZ];
-    memset(buffer, 0, PAYLOAD_SZ);
-    if (total_bytes_read < bytes_to_transfer) {
+  while(sender.bytes_acked < sender.bytes_to_transfer)   {
 
-      // read the next chunk of data from the file
-      size_t bytes_read_from_file = fread(buffer, sizeof(unsigned char), 
-          min(PAYLOAD_SZ, bytes_to_transfer - total_bytes_read), input_file);
-      total_bytes_read += bytes_read_from_file; 
+    // send retransmissions and new packets at the pacing rate, within the receive window
+    check_window(&sender, now_usec());
+    pacer_set_rate(&sender.pacer, sender.cc.ops->pacing_rate(&sender.cc));
+    send_packets(&sender);
 
-    
-      //create a packet with the data and header
-      packet_t packet = create_packet(buffer, 
-          create_header(seq_num, 0, bytes_read_from_file, 0));
-
-      // add the packet to the array of packets
-      packets[packet_index].packet = packet;
-      packets[packet_index].acked = false;
-      
-      // send the packet and check for errors
-      int send_len = sendto(sock_fd, &packet, sizeof(packet.header) + bytes_read_from_file,
-            0, (const struct sockaddr*) &server_addr,  len);
-      if (send_len < 0) {
-        fprintf(stderr, "Send failed: %d\n", send_len);
-        exit(EXIT_FAILURE);
-      }
-        
-      seq_num++;
-      packet_index++;
+    // wait until the next retransmission timer fires, or until the pacer releases the next packet
+    uint64_t now = now_usec();
+    uint64_t deadline = timer_wheel_next_expiry(&sender.wheel);
+    if (deadline == TIMER_WHEEL_NO_TIMER) {
+      deadline = now + sender.rtt.rto;
     }
-
+    uint64_t release_time = pacer_release_time(&sender.pacer);
+    if (release_time != PACER_NO_WAIT && (sender.rtx_head != NULL || can_send_new_packet(&sender))) {
+      deadline = min(deadline, (release_time + 999) / 1000);
+    }
+    if (sender.probe_time != 0) {
+      deadline = min(deadline, sender.probe_time);
+    }
+    tv = usec_to_timeval(deadline > now ? deadline - now : 0);
 
     FD_ZERO(&readfds);
-    FD_SET(sock_fd, &readfds);
-    tv.tv_sec = 0;
-    tv.tv_usec = ACK_TIMEOUT * 1000;
+    FD_SET(sender.sock_fd, &readfds);
 
     // monitor the socket for incoming packets 
-    select_retval = select(sock_fd + 1, &readfds, NULL, NULL, &tv);
+    select_retval = select(sender.sock_fd + 1, &readfds, NULL, NULL, &tv);
     
     if (select_retval == -1) {
       fprintf(stderr, "Select failed: %d\n", select_retval);
       exit(EXIT_FAILURE);
 
     } else if (select_retval) {
+      sender.bytes_acked += process_acks(&sender);
+      detect_losses(&sender);
+    }
 
-      // if the select call returned, check if any packets have been acked and increment the total bytes acked
-      packet_t ack_packet;
-      recvfrom(sock_fd, &ack_packet, sizeof(packet_t), 
-          0, (const struct sockaddr*) &server_addr, &len);
+    process_timeouts(&sender);
 
-      packets[ack_packet.header.ack_num].acked = true;
-      total_bytes_acked += ack_packet.header.length;
- 
-    } else {
-
-      // if the select call timed out, loop through all packets and retransmit any packets that have not been acked
-      for (unsigned long long int i = 0 ; i < packet_index; i++) {
-        if (!packets[i].acked) {
-          packet_t retransmit_packet = packets[i].packet;
-          int send_len = sendto(sock_fd, &retransmit_packet, sizeof(packet_t), 0, (const struct sockaddr*) &server_addr,  len);
-          if (send_len < 0) {
-            fprintf(stderr, "Send failed: %d\n", send_len);
-            exit(EXIT_FAILURE);
-          }
-        }
-      }
+    now = now_usec();
+    if (options->verbose && now >= sender.last_stats_time + STATS_INTERVAL) {
+      print_stats(&sender, now, "stats");
+      sender.last_stats_time = now;
     }
-  
   }
 
+  if (options->verbose) {
+    print_stats(&sender, now_usec(), "total");
+  }
 
-  packet_t fin_packet, fin_ack_packet;
-  bool fin_ack_flag = false;
 
-  int fin_sent = 0;
-  while (!fin_ack_flag && fin_sent < MAX_FIN_SENT) {
+  if (sender.compress_block > 0) {
+    fprintf(stderr, "Compressed %08x: %" PRIu64 " bytes sent as %llu\n", sender.conn_id, sender.compressor.raw_bytes,
+        sender.bytes_to_transfer);
+  }
 
-    // send FIN packet
-    fin_packet = create_packet(NULL, 
-        create_header(0,0,-1, FIN_FLAG));
-    sendto(sock_fd, &fin_packet, sizeof(packet_t), 0,
-      (const struct sockaddr*) &server_addr,  len);
+  // the FIN carries the digest of the connection, the FIN-ACK the receiver's
+  uint32_t digest = crc32c_digest_final(&sender.digest, sender.bytes_to_transfer);
+  uint32_t received_digest;
+  int answer = finish_connection(&sender, digest, &received_digest);
+  if (answer < 0) {
+    fprintf(stderr, "Transfer %08x: no FIN-ACK from the receiver, its copy is not verified\n", sender.conn_id);
+    exit(EXIT_FAILURE);
+  }
+  else if (answer > 0 && received_digest != digest) {
+    fprintf(stderr, "Transfer %08x corrupted: receiver's CRC32C %08x, sent %08x\n", sender.conn_id, received_digest, digest);
+    exit(EXIT_FAILURE);
+  }
 
-    usleep(FIN_ACK_WAIT);
-    
-    // listen for FIN ACK
-    if (recvfrom(sock_fd, &fin_ack_packet, sizeof(packet_t), 
-        0, (const struct sockaddr*) &server_addr, &len) < 0) {
-    }
+  congestion_free(&sender.cc);
+  batch_free(&sender.tx);
+  batch_free(&sender.rx);
+  timer_wheel_free(&sender.wheel);
+  free(sender.packets);
+  free(sender.packet_buffers);
+  free(sender.parity_buffers);
+  fec_code_free(&sender.fec);
+  resume_map_free(&sender.map);
+  compressor_free(&sender.compressor);
+  free(sender.raw_block);
+  free(sender.stream);
+
+  //close socket
+  close(sender.sock_fd);
+
+}
 
-    fin_ack_flag = IS_FIN(fin_ack_packet.header.flags) && IS_ACK(fin_ack_packet.header.flags);
-    fin_sent++;
+/**
+ * Body of the thread sending one stripe.
+ *
+ * @param arg The stripe.
+ * @return NULL.
+ */
+static void* stripe_thread(void* arg)
+{
+  send_stripe((const struct stripe*) arg);
+  return NULL;
+}
+
+/**
+ * Sends a file to a server using UDP.
+ *
+ * With more than one stripe the file is split into that many byte ranges, each sent at once by
+ * its own thread over its own socket, as a connection of its own with its own congestion control.
+ * The receiver writes every stripe at its offset in the same file (see setup_t), so the transfer
+ * is not limited to what one core can send.
+ *
+ * @param hostname The hostname of the server to send the file to.
+ * @param hostUDPport The UDP port number of the server.
+ * @param filename The name of the file to send.
+ * @param bytes_to_transfer The number of bytes of the file to send.
+ * @param options The window size, congestion control algorithm, payload size limit, pacing mode,
+ * verbosity and number of stripes to use.
+ */
+void rsend(char* hostname, 
+            unsigned short int hostUDPport, 
+            char* filename, 
+            unsigned long long int bytes_to_transfer,
+            const struct sender_options* options) 
+{
+  // open the file for reading
+  file_source_t source;
+  if (file_source_open(&source, filename) < 0) {
+    fprintf(stderr, "Input file open failed: %s\n", filename);
+    exit(EXIT_FAILURE);
   }
+  bytes_to_transfer = min (source.size, bytes_to_transfer);
 
-  free(packets);
+  // resolve the receiver before any stripe probes the MTU of the route to it
+  struct addrinfo hints;
+  struct addrinfo* resolved;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_DGRAM;
+  int gai_error = getaddrinfo(hostname, NULL, &hints, &resolved);
+  if (gai_error != 0) {
+    fprintf(stderr, "Cannot resolve %s: %s\n", hostname, gai_strerror(gai_error));
+    exit(EXIT_FAILURE);
+  }
+  struct sockaddr_in server_addr;
+  memcpy(&server_addr, resolved->ai_addr, sizeof(server_addr));
+  server_addr.sin_port = htons(hostUDPport);
+  freeaddrinfo(resolved);
 
-  //close socket
-  close(sock_fd);
+  struct stripe* stripes = (struct stripe*) calloc(options->stripes, sizeof(struct stripe));
+  if (stripes == NULL) {
+    fprintf(stderr, "Cannot allocate stripes\n");
+    exit(EXIT_FAILURE);
+  }
+
+  // consecutive random connection IDs keep concurrent transfers to one receiver apart
+  uint32_t first_conn_id;
+  if (getrandom(&first_conn_id, sizeof(first_conn_id), 0) != sizeof(first_conn_id)) {
+    first_conn_id = (uint32_t) getpid() ^ (uint32_t) now_usec();
+  }
+
+  // split the file into stripes of whole STRIPE_ALIGN blocks, the last one taking the rest
+  unsigned long long int stripe_bytes = (bytes_to_transfer + options->stripes - 1) / options->stripes;
+  stripe_bytes = (stripe_bytes + STRIPE_ALIGN - 1) / STRIPE_ALIGN * STRIPE_ALIGN;
+  for (unsigned int i = 0; i < options->stripes; i++) {
+    struct stripe* stripe = &stripes[i];
+    unsigned long long int offset = min((unsigned long long int) i * stripe_bytes, bytes_to_transfer);
+    stripe->conn_id = first_conn_id + i;
+    stripe->server_addr = server_addr;
+    stripe->source = &source;
+    stripe->options = options;
+    stripe->setup.payload_size = options->max_payload;
+    stripe->setup.window_size = options->window_size;
+    stripe->setup.offset = offset;
+    stripe->setup.total_bytes = min(offset + stripe_bytes, bytes_to_transfer) - offset;
+    stripe->setup.file_size = bytes_to_transfer;
+    stripe->setup.file_version = source.version;
+    stripe->setup.transfer_id = first_conn_id;
+    stripe->setup.stripes = options->stripes;
+    stripe->setup.fec_data = options->fec_data;
+    stripe->setup.fec_parity = options->fec_parity;
+    stripe->setup.delta_block_size = options->delta ? DELTA_ANY_BLOCK : 0;
+    stripe->setup.compress_block = options->compress ? COMPRESS_BLOCK_SZ : 0;
+  }
+
+  if (options->stripes == 1) {
+    send_stripe(&stripes[0]);
+  } else {
+    for (unsigned int i = 0; i < options->stripes; i++) {
+      if (pthread_create(&stripes[i].thread, NULL, stripe_thread, &stripes[i]) != 0) {
+        fprintf(stderr, "Cannot start the thread of stripe %u\n", i);
+        exit(EXIT_FAILURE);
+      }
+    }
+    for (unsigned int i = 0; i < options->stripes; i++) {
+      pthread_join(stripes[i].thread, NULL);
+    }
+  }
 
+  free(stripes);
+  file_source_close(&source);
 }
 
 int main(int argc, char** argv) {
-    // This is a skeleton of a main function.
-    // You should implement this function more completely
-    // so that one can invoke the file transfer from the
-    // command line.
 
-    
     int host_udp_port;
     unsigned long long int bytes_to_transfer;
     char* hostname = NULL;
+    struct sender_options options;
+    int opt;
+
+    options.window_size = DEFAULT_WINDOW_SIZE;
+    options.congestion = congestion_find(DEFAULT_CONGESTION);
+    options.gso = false;
+    options.batch = false;
+    options.max_payload = MAX_PAYLOAD_SZ;
+    options.kernel_pacing = false;
+    options.verbose = false;
+    options.stripes = 1;
+    options.zerocopy = false;
+    options.fec_data = 0;
+    options.fec_parity = 0;
+    options.delta = false;
+    options.compress = false;
+
+    while ((opt = getopt(argc, argv, "w:c:gbp:kvs:zf:dC")) != -1) {
+        switch (opt) {
+        case 'w':
+            options.window_size = (unsigned int) atoi(optarg);
+            if (options.window_size == 0) {
+                fprintf(stderr, "window size must be at least 1 packet\n");
+                exit(1);
+            }
+            break;
+        case 'c':
+            options.congestion = congestion_find(optarg);
+            if (options.congestion == NULL) {
+                fprintf(stderr, "unknown congestion control algorithm: %s\n", optarg);
+                exit(1);
+            }
+            break;
+        case 'g':
+            options.gso = true;
+            break;
+        case 'b':
+            options.batch = true;
+            break;
+        case 'k':
+            options.kernel_pacing = true;
+            break;
+        case 'z':
+            options.zerocopy = true;
+            break;
+        case 'f': {
+            unsigned int data, parity;
+            if (sscanf(optarg, "%u:%u", &data, &parity) != 2 || data == 0 || parity == 0
+                || parity > FEC_MAX_PARITY || data + parity > FEC_MAX_SYMBOLS) {
+                fprintf(stderr, "forward error correction must be data:parity with 1 to %d parity packets and at most %d packets per group\n",
+                    FEC_MAX_PARITY, FEC_MAX_SYMBOLS);
+                exit(1);
+            }
+            options.fec_data = data;
+            options.fec_parity = parity;
+            break;
+        }
+        case 'v':
+            options.verbose = true;
+            break;
+        case 'd':
+            options.delta = true;
+            break;
+        case 'C':
+            options.compress = true;
+            break;
+        case 's':
+            options.stripes = (unsigned int) atoi(optarg);
+            if (options.stripes == 0 || options.stripes > MAX_STRIPES) {
+                fprintf(stderr, "stripes must be between 1 and %d\n", MAX_STRIPES);
+                exit(1);
+            }
+            break;
+        case 'p':
+            options.max_payload = (uint32_t) atoi(optarg);
+            if (options.max_payload == 0 || options.max_payload > MAX_PAYLOAD_SZ) {
+                fprintf(stderr, "max payload must be between 1 and %d bytes\n", MAX_PAYLOAD_SZ);
+                exit(1);
+            }
+            break;
+        default:
+            fprintf(stderr, SENDER_USAGE, argv[0]);
+            exit(1);
+        }
+    }
 
-    if (argc != 5) {
-        fprintf(stderr, "usage: %s receiver_hostname receiver_port filename_to_xfer bytes_to_xfer\n\n", argv[0]);
+    if (argc - optind != 4) {
+        fprintf(stderr, SENDER_USAGE, argv[0]);
         exit(1);
     }
-    host_udp_port = (unsigned short int) atoi(argv[2]);
-    hostname = argv[1];
-    bytes_to_transfer = atoll(argv[4]);
+    host_udp_port = (unsigned short int) atoi(argv[optind + 1]);
+    hostname = argv[optind];
+    bytes_to_transfer = atoll(argv[optind + 3]);
 
-    rsend(hostname, host_udp_port, argv[3], bytes_to_transfer);
+    rsend(hostname, host_udp_port, argv[optind + 2], bytes_to_transfer, &options);
 
     return (EXIT_SUCCESS);
 }
@@ -0,0 +1,160 @@
+/**
+ * @file session.c
+ * @brief Per-transfer state of the receiver and the table finding it by connection ID.
+ * @author Connor Johst - cjohst & Aaditya Suri - AadityaSuri
+ * @bug No known bugs
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+#include "session.h"
+
+/**
+ * @brief Returns the bucket of a connection ID.
+ *
+ * @param conn_id The connection ID.
+ * @param num_buckets Number of buckets, a power of two.
+ * @return The bucket index.
+ */
+
+static size_t session_bucket(uint32_t conn_id, size_t num_buckets){
+    // Fibonacci hashing: the high bits of the product depend on every bit of the ID
+    return (size_t) (((uint64_t) conn_id * 0x9E3779B97F4A7C15ULL) >> 32) & (num_buckets - 1);
+}
+
+/**
+ * @brief Initializes an empty session table.
+ *
+ * @param table The table to initialize.
+ * @param num_buckets Initial number of buckets, rounded up to a power of two.
+ * @return 0 on success, -1 if the buckets could not be allocated.
+ */
+
+int session_table_init(session_table_t* table, size_t num_buckets){
+    size_t buckets = 1;
+    while (buckets < num_buckets){
+        buckets <<= 1;
+    }
+    table->buckets = (session_t**) calloc(buckets, sizeof(session_t*));
+    table->num_buckets = buckets;
+    table->count = 0;
+    return table->buckets == NULL ? -1 : 0;
+}
+
+/**
+ * @brief Destroys every session left in the table and releases its buckets.
+ *
+ * @param table The table.
+ */
+
+void session_table_free(session_table_t* table){
+    for (size_t b = 0; b < table->num_buckets; b++){
+        while (table->buckets[b] != NULL){
+            session_destroy(table, table->buckets[b]);
+        }
+    }
+    free(table->buckets);
+    table->buckets = NULL;
+    table->num_buckets = 0;
+}
+
+/**
+ * @brief Doubles the number of buckets. The table keeps working, only slower, if that fails.
+ *
+ * @param table The table.
+ */
+
+static void session_table_grow(session_table_t* table){
+    size_t num_buckets = table->num_buckets * 2;
+    session_t** buckets = (session_t**) calloc(num_buckets, sizeof(session_t*));
+    if (buckets == NULL){
+        return;
+    }
+    for (size_t b = 0; b < table->num_buckets; b++){
+        session_t* session = table->buckets[b];
+        while (session != NULL){
+            session_t* next = session->next;
+            size_t bucket = session_bucket(session->conn_id, num_buckets);
+            session->next = buckets[bucket];
+            buckets[bucket] = session;
+            session = next;
+        }
+    }
+    free(table->buckets);
+    table->buckets = buckets;
+    table->num_buckets = num_buckets;
+}
+
+/**
+ * @brief Finds the session of a connection.
+ *
+ * @param table The table.
+ * @param conn_id The connection ID.
+ * @return The session, or NULL if there is none.
+ */
+
+session_t* session_find(const session_table_t* table, uint32_t conn_id){
+    session_t* session = table->buckets[session_bucket(conn_id, table->num_buckets)];
+    while (session != NULL && session->conn_id != conn_id){
+        session = session->next;
+    }
+    return session;
+}
+
+/**
+ * @brief Adds a zeroed session for a connection to the table.
+ *
+ * @param table The table.
+ * @param conn_id The connection ID, not yet in the table.
+ * @return The session, or NULL if it could not be allocated.
+ */
+
+session_t* session_create(session_table_t* table, uint32_t conn_id){
+    session_t* session = (session_t*) calloc(1, sizeof(session_t));
+    if (session == NULL){
+        return NULL;
+    }
+    session->conn_id = conn_id;
+
+    if (table->count >= table->num_buckets){
+        session_table_grow(table);
+    }
+    size_t bucket = session_bucket(conn_id, table->num_buckets);
+    session->next = table->buckets[bucket];
+    table->buckets[bucket] = session;
+    table->count++;
+    return session;
+}
+
+/**
+ * @brief Removes a session from the table, releasing its reorder window, its maps, its decompressor
+ * and its reference to the output file. Its timer must not be armed.
+ *
+ * @param table The table.
+ * @param session The session.
+ */
+
+void session_destroy(session_table_t* table, session_t* session){
+    session_t** link = &table->buckets[session_bucket(session->conn_id, table->num_buckets)];
+    while (*link != NULL && *link != session){
+        link = &(*link)->next;
+    }
+    if (*link == session){
+        *link = session->next;
+        table->count--;
+    }
+
+    reorder_free(&session->reorder);
+    fec_decoder_free(&session->fec);
+    resume_map_free(&session->map);
+    decompressor_free(&session->decompressor);
+    free(session->present);
+    free(session->match_table);
+    free(session->match_chunks);
+    if (session->output != NULL){
+        output_release(session->output);
+    }
+    free(session);
+}
@@ -0,0 +1,207 @@
+/**
+ * @file timerwheel.c
+ * @brief Hashed timer wheel holding the retransmission timers of outstanding packets.
+ * @author Connor Johst - cjohst & Aaditya Suri - AadityaSuri
+ * @bug No known bugs
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "timerwheel.h"
+
+/**
+ * @brief Initializes a timer wheel.
+ *
+ * @param wheel The wheel to initialize.
+ * @param num_slots The number of slots, rounded up to a power of two, at most TIMER_WHEEL_MAX_SLOTS.
+ * @param tick_us The resolution of the wheel in microseconds.
+ * @param now The current time in microseconds.
+ * @return 0 on success, -1 if there are too many slots or they could not be allocated.
+ */
+
+int timer_wheel_init(timer_wheel_t* wheel, size_t num_slots, uint64_t tick_us, uint64_t now){
+    size_t slots = 1;
+    while (slots < num_slots){
+        slots <<= 1;
+    }
+    if (slots > TIMER_WHEEL_MAX_SLOTS){
+        return -1;
+    }
+
+    wheel->slots = (timer_node_t*) malloc(sizeof(timer_node_t) * slots);
+    if (wheel->slots == NULL){
+        return -1;
+    }
+
+    for (size_t i = 0; i < slots; i++){
+        wheel->slots[i].next = &wheel->slots[i];
+        wheel->slots[i].prev = &wheel->slots[i];
+    }
+
+    wheel->num_slots = slots;
+    wheel->tick_us = tick_us;
+    wheel->current_tick = now / tick_us;
+    wheel->armed_count = 0;
+    memset(wheel->occupied, 0, sizeof(wheel->occupied));
+    wheel->occupied_words = 0;
+    return 0;
+}
+
+/**
+ * @brief Releases the slots of a timer wheel. Armed nodes are simply forgotten.
+ *
+ * @param wheel The wheel to free.
+ */
+
+void timer_wheel_free(timer_wheel_t* wheel){
+    free(wheel->slots);
+    wheel->slots = NULL;
+    wheel->armed_count = 0;
+}
+
+/**
+ * @brief Finds the first occupied slot at or after a slot, without wrapping around.
+ *
+ * @param wheel The wheel.
+ * @param slot The slot to start from.
+ * @return The index of the slot, or -1 if no slot from there to the end of the wheel holds a timer.
+ */
+
+static long timer_wheel_occupied_from(const timer_wheel_t* wheel, size_t slot){
+    size_t word = slot / 64;
+    uint64_t bits = wheel->occupied[word] & (~0ULL << (slot % 64));
+    if (bits != 0){
+        return word * 64 + __builtin_ctzll(bits);
+    }
+    uint64_t words = word + 1 < 64 ? wheel->occupied_words & (~0ULL << (word + 1)) : 0;
+    if (words != 0){
+        word = __builtin_ctzll(words);
+        return word * 64 + __builtin_ctzll(wheel->occupied[word]);
+    }
+    return -1;
+}
+
+/**
+ * @brief Cancels a timer. Cancelling a timer that is not armed does nothing.
+ *
+ * @param wheel The wheel.
+ * @param node The timer to cancel.
+ */
+
+void timer_wheel_cancel(timer_wheel_t* wheel, timer_node_t* node){
+    if (!node->armed){
+        return;
+    }
+    node->prev->next = node->next;
+    node->next->prev = node->prev;
+    size_t slot = node->tick & (wheel->num_slots - 1);
+    if (wheel->slots[slot].next == &wheel->slots[slot]){
+        wheel->occupied[slot / 64] &= ~(1ULL << (slot % 64));
+        if (wheel->occupied[slot / 64] == 0){
+            wheel->occupied_words &= ~(1ULL << (slot / 64));
+        }
+    }
+    node->next = NULL;
+    node->prev = NULL;
+    node->armed = false;
+    wheel->armed_count--;
+}
+
+/**
+ * @brief Arms a timer to fire at the given deadline, re-arming it if it is already armed.
+ *
+ * @param wheel The wheel.
+ * @param node The timer to arm.
+ * @param deadline The absolute expiry time in microseconds.
+ */
+
+void timer_wheel_arm(timer_wheel_t* wheel, timer_node_t* node, uint64_t deadline){
+    timer_wheel_cancel(wheel, node);
+
+    // round up so that a timer never fires before its deadline
+    uint64_t tick = (deadline + wheel->tick_us - 1) / wheel->tick_us;
+    if (tick <= wheel->current_tick){
+        tick = wheel->current_tick + 1;
+    }
+
+    size_t slot = tick & (wheel->num_slots - 1);
+    timer_node_t* head = &wheel->slots[slot];
+    wheel->occupied[slot / 64] |= 1ULL << (slot % 64);
+    wheel->occupied_words |= 1ULL << (slot / 64);
+    node->deadline = deadline;
+    node->tick = tick;
+    node->next = head;
+    node->prev = head->prev;
+    head->prev->next = node;
+    head->prev = node;
+    node->armed = true;
+    wheel->armed_count++;
+}
+
+/**
+ * @brief Removes every timer whose deadline has passed.
+ *
+ * @param wheel The wheel.
+ * @param now The current time in microseconds.
+ * @return The first expired timer, or NULL if none expired.
+ */
+
+timer_node_t* timer_wheel_expire(timer_wheel_t* wheel, uint64_t now){
+    uint64_t now_tick = now / wheel->tick_us;
+    timer_node_t* expired = NULL;
+
+    if (now_tick <= wheel->current_tick){
+        return NULL;
+    }
+
+    // every slot only needs to be visited once, however long we have been away
+    uint64_t ticks_to_visit = now_tick - wheel->current_tick;
+    if (ticks_to_visit > wheel->num_slots){
+        ticks_to_visit = wheel->num_slots;
+    }
+
+    for (uint64_t t = 1; t <= ticks_to_visit && wheel->armed_count > 0; t++){
+        timer_node_t* head = &wheel->slots[(wheel->current_tick + t) & (wheel->num_slots - 1)];
+        timer_node_t* node = head->next;
+        while (node != head){
+            timer_node_t* next = node->next;
+            // timers from a later rotation of the wheel share the slot and stay armed
+            if (node->tick <= now_tick){
+                timer_wheel_cancel(wheel, node);
+                node->next = expired;
+                expired = node;
+            }
+            node = next;
+        }
+    }
+
+    wheel->current_tick = now_tick;
+    return expired;
+}
+
+/**
+ * @brief Returns a time at or before which the next armed timer fires: the tick of the next
+ * occupied slot, which is early only if that slot holds nothing but timers of a later rotation.
+ *
+ * @param wheel The wheel.
+ * @return The time in microseconds, or TIMER_WHEEL_NO_TIMER if nothing is armed.
+ */
+
+uint64_t timer_wheel_next_expiry(const timer_wheel_t* wheel){
+    if (wheel->armed_count == 0){
+        return TIMER_WHEEL_NO_TIMER;
+    }
+
+    size_t first = (wheel->current_tick + 1) & (wheel->num_slots - 1);
+    long slot = timer_wheel_occupied_from(wheel, first);
+    if (slot < 0){
+        // the next occupied slot comes after the wheel wraps around
+        slot = timer_wheel_occupied_from(wheel, 0);
+    }
+    uint64_t distance = ((size_t) slot - first) & (wheel->num_slots - 1);
+    return (wheel->current_tick + 1 + distance) * wheel->tick_us;
+}
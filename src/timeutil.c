@@ -0,0 +1,50 @@
+/**
+ * @file timeutil.c
+ * @brief Monotonic clock helpers shared by the sender and receiver.
+ * @author Connor Johst - cjohst & Aaditya Suri - AadityaSuri
+ * @bug No known bugs
+ */
+
+#include <stdint.h>
+#include <time.h>
+#include <sys/time.h>
+
+#include "timeutil.h"
+
+/**
+ * @brief Returns the current CLOCK_MONOTONIC time in microseconds.
+ *
+ * @return Microseconds since an arbitrary, fixed point in the past.
+ */
+
+uint64_t now_usec(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000ULL + (uint64_t) ts.tv_nsec / 1000ULL;
+}
+
+/**
+ * @brief Returns the current CLOCK_MONOTONIC time in nanoseconds.
+ *
+ * @return Nanoseconds since an arbitrary, fixed point in the past.
+ */
+
+uint64_t now_nsec(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+/**
+ * @brief Converts a duration in microseconds to a timeval suitable for select().
+ *
+ * @param usec The duration in microseconds.
+ * @return The equivalent timeval.
+ */
+
+struct timeval usec_to_timeval(uint64_t usec){
+    struct timeval tv;
+    tv.tv_sec = usec / 1000000ULL;
+    tv.tv_usec = usec % 1000000ULL;
+    return tv;
+}